@@ -23,10 +23,22 @@ struct string_literal;
 union literal_value;
 struct literal;
 struct condition_expr;
+struct loop_expr;
 struct block_statement;
 struct function_literal;
 struct identifier;
 struct function_def_stmt;
+struct obj_t;
+struct scope;
+struct function_proto;
+struct entry;
+
+/**
+ * specialized handler of an infix node for one pair of operand types,
+ * installed by the tree walker once the node has seen the same types a few
+ * times (see evaluate_infix_quickened in evaluator.c)
+ */
+typedef struct obj_t *(*infix_quick_fn)(struct obj_t *, struct obj_t *);
 
 /**
  *NOTE: at the time of initializing a string literal
@@ -58,6 +70,7 @@ struct literal {
   enum LITERAL_TYPE literal_type;
   struct token *token;
   union literal_value value;
+  struct obj_t *object; // immortal value, see literal_object_of in object_t.h
 };
 
 /**
@@ -80,6 +93,22 @@ struct conditional_expr {
   struct block_statement *alternative;
 };
 
+/**
+ * loops follow one of the following formats
+ * while (<condition>) { <body> }
+ * for (<init>; <condition>; <update>) { <body> }
+ * init and update are NULL for while loops and when a for loop leaves them
+ * out, so is the condition of a for loop that leaves it out (it is true).
+ * the body does not open a scope
+ */
+struct loop_expr {
+  struct token *token; // WHILE or FOR
+  struct statement *init;
+  struct expression *condition;
+  struct expression *update;
+  struct block_statement *body;
+};
+
 /**
  * statements that appear inside of the block { <statements> }
  */
@@ -96,6 +125,20 @@ struct function_literal {
   size_t param_count;
   size_t param_capacity;
   struct block_statement *body;
+  struct scope *scope; // names bound by the body, set by the resolver
+  struct function_proto *proto; // shared by its closures (object_t.h)
+};
+
+/**
+ * shapes the fuse pass (fuse.h) recognizes, the tree walker evaluates a
+ * fused node and its identifier/literal children in a single step
+ */
+enum FUSED_SHAPE {
+  FUSED_NONE,
+  FUSED_NAME_LITERAL, // a + 1, infix of an identifier and a literal
+  FUSED_NAME_NAME,    // a + b, infix of two identifiers
+  FUSED_RETURN_NAME,  // return a;
+  FUSED_CALL_NAMES,   // f(a, b), call of an identifier with identifiers
 };
 
 enum EXPRESSION_TYPE {
@@ -108,16 +151,23 @@ enum EXPRESSION_TYPE {
   EXPR_CONDITIONAL,   // if-else expression
   EXPR_FUNCTION,      // fn -> functions
   EXPR_FUNCTION_CALL, // fn -> function call
+  EXPR_LOOP,          // while and for loops
 };
 
 struct expression {
   enum EXPRESSION_TYPE type;
+  enum FUSED_SHAPE fused;
   union {
     struct literal literal;
 
     struct {
       struct token *token;
       char *identifier;
+      // set by the resolver, the name is in slot of the environment `depth`
+      // functions up. scope is NULL for names that are looked up by name
+      const struct scope *scope;
+      size_t depth;
+      size_t slot;
     } identifier_expr;
 
     struct {
@@ -131,6 +181,10 @@ struct expression {
       struct token *op;
       char *op_str;
       struct expression *right;
+      infix_quick_fn quick; // NULL while the node is generic
+      unsigned char quick_type;   // operand type the handler expects
+      unsigned char quick_hits;   // generic runs with quick_type operands
+      unsigned char quick_misses; // de-specializations so far
     } infix_expr;
 
     struct {
@@ -141,6 +195,8 @@ struct expression {
 
     struct conditional_expr conditional;
 
+    struct loop_expr loop;
+
     struct function_literal function;
 
     struct {
@@ -152,6 +208,10 @@ struct expression {
       struct expression **arguments;
       size_t arg_count;
       size_t arg_size;
+      // inline cache of a callee looked up by name, the entry binding it
+      // while env_shape is cached_shape (see evaluate_callee_name)
+      struct entry *cached_entry;
+      size_t cached_shape;
     } function_call;
   };
 };
@@ -165,6 +225,7 @@ enum STATEMENT_TYPE {
 
 struct statement {
   enum STATEMENT_TYPE type;
+  enum FUSED_SHAPE fused;
   union {
     struct {
       struct token *token;
@@ -172,6 +233,8 @@ struct statement {
       char *ident;
       struct token *assign;
       struct expression *value;
+      const struct scope *scope; // function the let binds in, see resolver.h
+      size_t slot;
     } let_stmt;
 
     struct {
@@ -0,0 +1,116 @@
+#ifndef CNODE_H
+#define CNODE_H
+
+/**
+ * cnode is the closure compiled form of the ast: every statement and
+ * expression is converted once into a node that holds a pointer to the c
+ * function evaluating it. the function is picked for the shape of the node
+ * (e.g. "int add of an identifier and a constant" or "call an identifier"),
+ * so evaluating the tree does not dispatch on the node or operator type
+ */
+
+#include "ast.h"
+#include "environment.h"
+#include "object_t.h"
+#include "token.h"
+#include <stddef.h>
+
+struct cnode;
+
+typedef struct obj_t *(*cnode_eval_fn)(struct cnode *, struct environment *);
+
+/**
+ * layout of a node, only needed to walk the tree (e.g. to free it)
+ */
+enum CNODE_KIND {
+  CNODE_LEAF, // literal, identifier, ++/-- or nothing
+  CNODE_BINARY,
+  CNODE_UNARY,
+  CNODE_CONDITIONAL,
+  CNODE_LOOP,
+  CNODE_BLOCK,
+  CNODE_LET,
+  CNODE_FUNCTION,
+  CNODE_CALL,
+};
+
+struct cnode {
+  cnode_eval_fn eval;
+  enum CNODE_KIND kind;
+  struct token *token; // used for errors
+  union {
+    struct literal *literal;
+
+    char *name;
+
+    struct {
+      struct cnode *left;
+      struct cnode *right;
+      char *left_name;
+      char *right_name;
+      int right_int;
+    } binary;
+
+    struct {
+      struct cnode *operand;
+    } unary;
+
+    struct expression *expr; // ++ and -- work on the ast directly
+
+    struct {
+      struct cnode *condition;
+      struct cnode *consequence;
+      struct cnode *alternative;
+    } conditional;
+
+    struct {
+      struct cnode *init; // NULL for while loops
+      struct cnode *condition;
+      struct cnode *update;
+      struct cnode *body;
+    } loop;
+
+    struct {
+      struct cnode **statements;
+      size_t count;
+    } block;
+
+    struct {
+      char *name;
+      struct cnode *value;
+    } let;
+
+    struct {
+      struct function_literal *literal;
+      struct cnode *body; // compiled once, shared by the function objects
+    } function;
+
+    struct {
+      struct cnode *callee;
+      char *callee_name; // set when the callee is an identifier
+      struct cnode **arguments;
+      size_t arg_count;
+    } call;
+  };
+};
+
+/**
+ * compile and run a program, top level names are defined in env.
+ * returns NULL if the program could not be compiled, in that case the
+ * caller is expected to fall back to the tree walker
+ */
+struct obj_t *cnode_run_program(struct environment *env,
+                                struct program *program);
+
+/**
+ * compile the body of a function, returns NULL on allocation failure
+ */
+struct cnode *cnode_compile_block(struct block_statement *block);
+
+/**
+ * free a node tree, compiled function bodies are kept alive the same way
+ * as nested chunks (see chunk_free in compiler.c)
+ */
+void cnode_free(struct cnode *node);
+
+#endif // !CNODE_H
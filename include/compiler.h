@@ -0,0 +1,148 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/**
+ * compiler lowers a parsed program into bytecode for the stack vm (vm.h)
+ */
+
+#include "ast.h"
+#include "object_t.h"
+#include "token.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * upper bound on the number of local slots a function can have, functions
+ * that need more keep their variables in a heap environment instead
+ */
+#define CHUNK_MAX_SLOTS 255
+
+// clang-format off
+
+/**
+ * operands are stored inline after the opcode, u8 operands take a single
+ * byte and u16 operands two bytes (little endian)
+ */
+enum OPCODE {
+  OP_CONSTANT,       // [idx:u16]                       push constants[idx]
+  OP_SENTINEL,       //                                 push the sentinel value
+  OP_TRUE,           //                                 push true
+  OP_FALSE,          //                                 push false
+  OP_POP,            //                                 discard the top of the stack
+  OP_DUP,            //                                 duplicate the top of the stack
+
+  OP_GET_NAME,       // [name:u16][token:u16]           look up a name in the frame environment
+  OP_DEFINE_NAME,    // [name:u16]                      bind a name in the frame environment (peeks)
+  OP_SET_NAME,       // [name:u16]                      rebind a name where it was defined (peeks)
+  OP_GET_LOCAL,      // [slot:u8][name:u16][token:u16]  push a local slot, unset slots fall back to the name
+  OP_SET_LOCAL,      // [slot:u8]                       store the top of the stack in a local slot (peeks)
+
+  OP_ADD,            // [token:u16]                     binary operators, operands are popped
+  OP_SUB,            // [token:u16]                     and the result is pushed
+  OP_MUL,            // [token:u16]
+  OP_LT,             // [token:u16]
+  OP_GT,             // [token:u16]
+  OP_LT_EQ,          // [token:u16]
+  OP_GT_EQ,          // [token:u16]
+  OP_EQ_EQ,          // [token:u16]
+  OP_NOT_EQ,         // [token:u16]
+  OP_INFIX,          // [token:u16]                     any other binary operator
+
+  OP_NOT,            // [token:u16]                     prefix !
+  OP_NEGATE,         // [token:u16]                     prefix -
+  OP_INC,            // [token:u16]                     replace a number with number + 1
+  OP_DEC,            // [token:u16]                     replace a number with number - 1
+  OP_RAISE,          // [token:u16][err:u8]             raise one of the RAISE_KIND errors
+
+  OP_JUMP,           // [offset:u16]                    jump forward
+  OP_JUMP_IF_FALSE,  // [offset:u16]                    pop the condition, jump forward if falsy
+  OP_LOOP,           // [offset:u16]                    jump backward
+
+  OP_CLOSURE,        // [function:u16]                  push a new function object for functions[idx]
+  OP_CALL,           // [argc:u8][token:u16]            call the function below the arguments
+  OP_RETURN,         //                                 return the top of the stack to the caller
+};
+
+/**
+ * errors that the compiler can already tell will be raised at runtime
+ */
+enum RAISE_KIND {
+  RAISE_UNKNOWN_PREFIX,   // prefix operator is not one of !, -, ++, --
+  RAISE_NON_IDENTIFIER,   // ++ or -- applied to something other than a variable
+};
+
+// clang-format on
+
+/**
+ * chunk holds the bytecode of a single function (or the top level program)
+ * together with everything that the instructions refer to by index
+ */
+struct chunk {
+  uint8_t *code;
+  size_t count;
+  size_t capacity;
+
+  struct obj_t **constants; // literal values, immortal (not gc'd)
+  size_t constant_count;
+  size_t constant_capacity;
+
+  char **names; // identifiers used by the name instructions, owned
+  size_t name_count;
+  size_t name_capacity;
+
+  struct token **tokens; // tokens used for error reporting, borrowed
+  size_t token_count;
+  size_t token_capacity;
+
+  struct chunk **functions; // nested function literals
+  size_t function_count;
+  size_t function_capacity;
+
+  /**
+   * source of the function this chunk was compiled from, NULL for the top
+   * level program. used to build function objects for OP_CLOSURE
+   */
+  struct identifier **parameters;
+  size_t param_count;
+  size_t param_capacity;
+  struct block_statement *body;
+  struct function_proto *proto; // of the closures of the chunk, built lazily
+
+  /**
+   * when uses_env is set, parameters and let bindings live in a fresh
+   * environment per call (the scope can be captured by a nested fn),
+   * otherwise they live in stack slots [0, slot_count)
+   */
+  bool uses_env;
+  size_t slot_count;
+  size_t max_stack; // upper bound of the operand stack used by the chunk
+};
+
+/**
+ * compile the top level statements of a program, names are resolved
+ * against the environment the chunk is executed in
+ */
+struct chunk *compiler_compile_program(struct program *program);
+
+/**
+ * compile the body of a function literal
+ */
+struct chunk *compiler_compile_function(struct identifier **parameters,
+                                        size_t param_count,
+                                        size_t param_capacity,
+                                        struct block_statement *body);
+
+/**
+ * check if a block contains a fn literal (which could capture the scope the
+ * block runs in), nested blocks and expressions are searched as well
+ */
+bool compiler_block_creates_function(struct block_statement *block);
+
+/**
+ * free a chunk, nested function chunks are not freed since function objects
+ * created from them can outlive the chunk that created them
+ */
+void chunk_free(struct chunk *chunk);
+
+#endif // !COMPILER_H
@@ -6,15 +6,39 @@
  */
 
 #include "kv.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 #define MAX_ROOTS 1024
+#define ENV_FRAME_CHUNK_SIZE (64 * 1024)
 
 typedef struct environment environment;
 
+/**
+ * changes whenever a name is added to or removed from the hash table of an
+ * environment, rebinding a name does not change it. a lookup that found an
+ * entry (env_look_up_entry) finds the same one while env_shape is the same
+ */
+extern size_t env_shape;
+
+/**
+ * names bound by a function (the parameters first, then its lets), built by
+ * the resolver (resolver.h). an environment of a call of the function keeps
+ * these names in a flat array of slots instead of the hash table
+ */
+struct scope {
+  char **names;
+  size_t count;
+  size_t capacity;
+  bool captured; // functions nested in the body refer to these names
+};
+
 struct environment {
   struct environment *parent; // for global environment, set this to NULL
   struct hash_table *symbols; // k-v store for storing variables and data
+  const struct scope *scope;  // NULL for environments without slots
+  struct obj_t **slots;       // one per name of the scope, NULL while unbound
+  size_t remembered; // 1 + index in the remembered set of the gc, 0 if not
 };
 
 /**
@@ -22,6 +46,38 @@ struct environment {
  */
 environment *env_init();
 
+/**
+ * initialize an environment that stores the names of scope in slots, the
+ * hash table is only created once a name outside of the scope is defined
+ */
+environment *env_init_scope(const struct scope *scope);
+
+/**
+ * push the environment of a call that cannot be captured on the frame stack,
+ * the environment and its slots live in one contiguous chunk so a call
+ * allocates nothing once the stack has grown to the depth of the program
+ */
+environment *env_push_frame(const struct scope *scope);
+
+/**
+ * pop the frame pushed last, frames are released in the reverse order they
+ * were pushed in
+ */
+void env_pop_frame(environment *env);
+
+/**
+ * environment of a call of a function whose body binds the names of scope
+ * (NULL when the resolver did not see the function). it is a frame unless
+ * captured is set, then the closures created by the body keep it
+ */
+environment *env_push_call(const struct scope *scope, bool captured);
+
+/**
+ * give back the environment of a call once it returned, captured is what
+ * it was pushed with. captured environments are left to their closures
+ */
+void env_release_call(environment *env, bool captured);
+
 /**
  * define a variable in the environment
  */
@@ -41,6 +97,18 @@ void env_set(environment *env, const char *name, void *value);
  */
 struct obj_t *env_look_up(environment *env, char *key);
 
+/**
+ * look up key like env_look_up, returns the hash table entry binding it or
+ * NULL if it is not bound or bound in a slot
+ */
+struct entry *env_look_up_entry(environment *env, char *key);
+
+/**
+ * remove all the variables of the environment so that it can be reused,
+ * the parent and the scope are kept
+ */
+void env_clear(environment *env);
+
 /**
  * free the environment, release the resources
  */
@@ -4,9 +4,57 @@
 #include "ast.h"
 #include "environment.h"
 #include "object_t.h"
+#include "token.h"
+#include <stdbool.h>
+
+#define CALL_INLINE_ARGS 4  // arguments of a call kept in its c frame
+#define ARG_STACK_SIZE 4096 // arguments of wider calls, see evaluator.c
+
+/**
+ * engines that can run a program behind evaluate_program
+ */
+enum EVAL_ENGINE {
+  ENGINE_TREE_WALKER, // recursive ast walker
+  ENGINE_BYTECODE_VM, // bytecode compiler + stack vm (vm.h)
+  ENGINE_REGISTER_VM, // three-address compiler + register vm (reg_vm.h)
+  ENGINE_CLOSURE,     // ast compiled to c function pointer nodes (cnode.h)
+  ENGINE_STACK,       // non-recursive ast walker on a heap stack (stack_eval.h)
+};
+
+/**
+ * select the engine used by evaluate_program, the tree walker is the default
+ */
+void evaluator_set_engine(enum EVAL_ENGINE engine);
+enum EVAL_ENGINE evaluator_get_engine();
+
+/**
+ * look up an engine by its command line name (e.g. "tree" or "vm"),
+ * returns false if no engine has that name
+ */
+bool evaluator_engine_from_name(const char *name, enum EVAL_ENGINE *engine);
 
 struct obj_t *evaluate_program(struct environment *env, struct program *);
 struct obj_t *evaluate_statement(struct environment *env, struct statement *);
 struct obj_t *evaluate_expression(struct environment *env, struct expression *);
 
+// clang-format off
+
+/**
+ * operator semantics shared by all the engines
+ */
+struct obj_t *evaluate_infix_expr(struct token *, struct obj_t *, struct obj_t *);
+struct obj_t *evaluate_prefix_bang_operator_expr(struct token*, struct obj_t *);
+struct obj_t *evaluate_prefix_minus_operator_expr(struct token*, struct obj_t *);
+struct obj_t *evaluate_prefix_expr(struct environment *, struct token *, struct expression *);
+struct obj_t *evaluate_postfix_expr(struct environment *, struct token *, struct expression *);
+struct obj_t *evaluate_identifier_expr(struct environment *, char *, struct token *);
+
+struct obj_t *evaluate_literal_expr(struct expression *);
+struct obj_t *evaluate_fn_expression(struct environment *, struct expression *);
+
+bool is_truthy(struct obj_t*);
+bool has_error(struct obj_t *);
+
+// clang-format on
+
 #endif // !EVALUATOR_H
@@ -0,0 +1,25 @@
+#ifndef FUSE_H
+#define FUSE_H
+
+/**
+ * post parse pass marking the expression shapes that dominate the profiles
+ * of arc programs (see enum FUSED_SHAPE in ast.h). the nodes keep their type
+ * and children, so the compilers of the other engines and the jit read the
+ * ast as before, only the tree walker looks at the shape
+ */
+
+#include "ast.h"
+
+/**
+ * maximum number of arguments of a fused call, the arguments are kept in a
+ * stack buffer of this size
+ */
+#define FUSED_CALL_MAX_ARGS 8
+
+/**
+ * mark the fused shapes of every statement of the program, including the
+ * bodies of fn literals. running the pass again is a no-op
+ */
+void fuse_program(struct program *);
+
+#endif // !FUSE_H
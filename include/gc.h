@@ -2,12 +2,42 @@
 #define GC_H
 
 /**
- * mark and sweep garbage collector
+ * generational garbage collector. objects are bump allocated in the nursery,
+ * a minor collection copies the ones that are still referenced out of it
+ * into the old generation, which is collected by mark and sweep. the only
+ * mutable containers of objects are environments, an environment that is
+ * given a young object is remembered by the write barrier so that a minor
+ * collection finds the young objects without walking the old generation.
+ *
+ * the old generation is marked incrementally with three colors: white
+ * objects are unmarked, gray ones are marked and wait on the gray stack for
+ * their references to be marked, black ones are done. gc_alloc marks a few
+ * gray objects every GC_STEP_INTERVAL allocations, the write barrier makes
+ * an object stored in an environment during marking gray so that no black
+ * object ever refers to a white one. the collection after the one that
+ * started marking finishes it. the mark bits are kept in the bitmaps of the
+ * chunks of the object slab (slab.h) and the sweep is lazy, a chunk is
+ * swept when it is allocated from again, so a pause does not touch the
+ * dead objects.
+ *
+ * collections run between two inputs and at the safe points of the engines
+ * (statements, loop iterations and calls) once gc_alloc has filled the
+ * nursery. objects an engine holds outside of environments while it can
+ * reach a safe point (c locals, the stacks of the vms) are registered on
+ * the shadow root stack, a minor collection updates them to the copies
  */
 
 #include "environment.h"
 #include "object_t.h"
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define GC_NURSERY_SIZE 4096 // objects, allocated in the old generation when full
+#define GC_MAJOR_MIN 1024    // old objects before the first major collection
+#define GC_STEP_BUDGET 256   // gray objects an increment of marking handles
+#define GC_STEP_INTERVAL 128 // allocations between two increments
 
 typedef struct root_set_t {
   struct obj_t **roots;
@@ -15,10 +45,227 @@ typedef struct root_set_t {
   size_t capacity;
 } root_set_t;
 
+/**
+ * what the collector did so far, pauses are the time spent in a collection
+ * or an increment of marking
+ */
+struct gc_stats {
+  size_t allocated; // objects made by gc_alloc, immortal ones not counted
+  size_t minor_collections;
+  size_t major_collections;
+  size_t increments;
+  uint64_t total_pause_ns;
+  uint64_t max_pause_ns;
+};
+
+// bounds of the nursery, see gc_is_young
+extern struct obj_t *gc_nursery_start;
+extern struct obj_t *gc_nursery_end;
+
+// true while a major collection is marking, see gc_write_barrier
+extern bool gc_marking;
+
+// set once the nursery is full, the next gc_safe_point collects
+extern bool gc_requested;
+
+/**
+ * visits the roots of an engine with gc_visit and gc_visit_environment,
+ * data is what was given to gc_push_root_visitor
+ */
+typedef void (*gc_root_visitor)(void *data);
+
+/**
+ * entry of the shadow root stack: count objects starting at objects, an
+ * environment, or a visitor that knows the roots of an engine
+ */
+struct gc_root {
+  enum { GC_ROOT_OBJECTS, GC_ROOT_ENVIRONMENT, GC_ROOT_VISITOR } kind;
+  union {
+    struct {
+      struct obj_t **values;
+      size_t count;
+    } objects;
+    struct environment *env;
+    struct {
+      gc_root_visitor visit;
+      void *data;
+    } visitor;
+  };
+};
+
+/**
+ * roots are pushed and popped in lifo order. lost counts the pushes on top
+ * of the stack that found no memory, no collection runs while it is not 0
+ */
+struct gc_root_stack {
+  struct gc_root *roots;
+  size_t count;
+  size_t capacity;
+  size_t lost;
+};
+
+extern struct gc_root_stack gc_root_stack;
+
+/**
+ * a new object of type, for bools and the sentinel the shared value. ints,
+ * chars and doubles are made by the functions below
+ */
 struct obj_t *gc_alloc(enum OBJECT_TYPE type);
 
+/**
+ * double object holding value, allocated only when value has no immediate
+ * form (object_t_immediate_double)
+ */
+struct obj_t *gc_alloc_double(double value);
+
+// ints and chars are immediates (object_t.h), they allocate nothing
+static inline struct obj_t *gc_int(int value) {
+  return object_t_from_int(value);
+}
+
+static inline struct obj_t *gc_char(char value) {
+  return object_t_from_char(value);
+}
+
+static inline struct obj_t *gc_double(double value) {
+  struct obj_t *obj = object_t_immediate_double(value);
+  return obj ? obj : gc_alloc_double(value);
+}
+
+/**
+ * run a minor collection with env and the shadow root stack as the roots of
+ * the program (env can be NULL). a major collection starts marking once the
+ * old generation has doubled since the last one and is finished by the
+ * next gc_collect, the sweep left from the last one is done first
+ */
 void gc_collect(struct environment *env);
+
+/**
+ * collect if gc_alloc asked for it, engines call this where everything they
+ * hold is in an environment or on the shadow root stack
+ */
+static inline void gc_safe_point() {
+  if (gc_requested) {
+    gc_collect(NULL);
+  }
+}
+
+// grow the shadow root stack, false when there is no memory
+bool gc_grow_root_stack();
+
+static inline struct gc_root *gc_push_root_entry() {
+  if (gc_root_stack.lost ||
+      (gc_root_stack.count == gc_root_stack.capacity &&
+       !gc_grow_root_stack())) {
+    gc_root_stack.lost++;
+    return NULL;
+  }
+  return &gc_root_stack.roots[gc_root_stack.count++];
+}
+
+/**
+ * keep the count objects at values alive and up to date until they are
+ * popped, NULL entries are skipped
+ */
+static inline void gc_push_roots(struct obj_t **values, size_t count) {
+  struct gc_root *root = gc_push_root_entry();
+  if (root) {
+    root->kind = GC_ROOT_OBJECTS;
+    root->objects.values = values;
+    root->objects.count = count;
+  }
+}
+
+static inline void gc_push_root(struct obj_t **value) {
+  gc_push_roots(value, 1);
+}
+
+/**
+ * keep what env (and the environments enclosing it) refer to alive, for
+ * environments of calls that nothing else refers to
+ */
+static inline void gc_push_env_root(struct environment *env) {
+  struct gc_root *root = gc_push_root_entry();
+  if (root) {
+    root->kind = GC_ROOT_ENVIRONMENT;
+    root->env = env;
+  }
+}
+
+static inline void gc_push_root_visitor(gc_root_visitor visit, void *data) {
+  struct gc_root *root = gc_push_root_entry();
+  if (root) {
+    root->kind = GC_ROOT_VISITOR;
+    root->visitor.visit = visit;
+    root->visitor.data = data;
+  }
+}
+
+// pop the count roots pushed last
+static inline void gc_pop_roots(size_t count) {
+  if (gc_root_stack.lost >= count) {
+    gc_root_stack.lost -= count;
+  } else {
+    gc_root_stack.count -= count - gc_root_stack.lost;
+    gc_root_stack.lost = 0;
+  }
+}
+
+/**
+ * called by a gc_root_visitor for each object it holds (the object can be
+ * moved, *value is updated) and for each environment
+ */
+void gc_visit(struct obj_t **value);
+void gc_visit_environment(struct environment *env);
 // mark the roots - called before sweeping
 void gc_mark_environment(struct environment *env);
 
-#endif // !GC_H
\ No newline at end of file
+/**
+ * gray objects marked by an increment, 0 marks the whole old generation in
+ * the pause of the collection that starts the major collection
+ */
+void gc_set_step_budget(size_t budget);
+
+const struct gc_stats *gc_get_stats();
+
+/**
+ * print the collections made so far and the longest pause
+ */
+void gc_print_stats(FILE *out);
+
+/**
+ * make obj gray if it is white, use gc_write_barrier instead
+ */
+void gc_shade(struct obj_t *obj);
+
+/**
+ * add env to the remembered set, use gc_write_barrier instead
+ */
+void gc_remember_environment(struct environment *env);
+
+/**
+ * remove env from the remembered set, called before env is released
+ */
+void gc_forget_environment(struct environment *env);
+
+static inline bool gc_is_young(const struct obj_t *obj) {
+  return !object_t_is_immediate(obj) &&
+         (uintptr_t)obj - (uintptr_t)gc_nursery_start <
+             (uintptr_t)gc_nursery_end - (uintptr_t)gc_nursery_start;
+}
+
+/**
+ * call when value is stored in env (in its hash table or one of its slots)
+ */
+static inline void gc_write_barrier(struct environment *env,
+                                    struct obj_t *value) {
+  if (gc_is_young(value)) {
+    if (!env->remembered) {
+      gc_remember_environment(env);
+    }
+  } else if (gc_marking) {
+    gc_shade(value);
+  }
+}
+
+#endif // !GC_H
@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H
+
+/**
+ * baseline x86-64 jit for hot functions. every call of a function object
+ * is counted, once a function reaches JIT_HOT_CALLS calls its body is
+ * compiled to machine code specialized for the int/double/bool types of the
+ * arguments of that call. the types are checked again on every entry, and
+ * the native code bails out to the interpreter when a guard fails (e.g. a
+ * division by zero), numeric bodies have no side effects so the call is
+ * simply evaluated again by the interpreter.
+ *
+ * only self contained numeric functions are compiled: parameters, lets,
+ * arithmetic, comparisons, if-else, return and calls of the function to
+ * itself. everything else keeps running on the interpreter. a self call in
+ * tail position jumps back to the start of the native body, the others
+ * nest native calls until they use a fixed amount of the c stack, then the
+ * whole call is left to the interpreter, which keeps the next calls for a
+ * while so that deep recursion is as deep as the engine allows
+ */
+
+#include "object_t.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JIT_HOT_CALLS 64
+
+struct jit_function;
+
+/**
+ * the jit is on by default on x86-64, it is a no-op on other targets
+ */
+void jit_set_enabled(bool enabled);
+bool jit_is_enabled();
+
+/**
+ * count a call of function with the evaluated arguments and run it as
+ * native code once it is hot. returns true and sets result if the native
+ * code ran, false if the caller has to interpret the call
+ */
+bool jit_try_call(struct obj_t *function, struct obj_t **args,
+                  size_t arg_count, struct obj_t **result);
+
+#endif // !JIT_H
@@ -35,8 +35,10 @@ hash_table *hash_table_init();
 void hash_table_free(hash_table *table);
 void hash_table_insert(hash_table *table, const char *key, void *value);
 struct obj_t *hash_table_get(hash_table *table, const char *key);
+entry *hash_table_get_entry(hash_table *table, const char *key); // stays put until the key is removed
 bool hash_table_remove(hash_table *table, const char *key);
 bool hash_table_has(hash_table *table, const char *key);
+void hash_table_clear(hash_table *table); // remove all entries, keeps the buckets
 
 // iterator interface
 hash_table_iterator hash_table_iterate(hash_table *table);
@@ -6,8 +6,15 @@
 #include "string_t.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 struct obj_t;
+struct chunk;
+struct reg_chunk;
+struct cnode;
+struct jit_function;
+struct slab_class;
 
 enum OBJECT_TYPE {
   OBJECT_ERROR,
@@ -23,15 +30,35 @@ enum OBJECT_TYPE {
   OBJECT_RETURN,
 };
 
+/**
+ * ints, bools, chars and most doubles are immediate: the struct obj_t
+ * pointer is the value, tagged in its low bits (objects are 8 byte aligned,
+ * the low bits of their pointers are 0). immediates are not allocated and
+ * not tracked by the gc, they must not be dereferenced, use object_t_type
+ * and the accessors below. doubles outside of the range of the immediate
+ * ones (see object_t_immediate_double) are objects of type OBJECT_DOUBLE
+ *
+ *   int      value in the high 32 bits                          ...1
+ *   double   bits 63..61 of the double rotated to the bottom     ..10
+ *   bool     value in bit 8                                   0 0100
+ *   char     value in bits 8..15                              0 1100
+ */
+#define OBJECT_TAG_INT 0x1
+#define OBJECT_TAG_DOUBLE 0x2
+#define OBJECT_TAG_OTHER 0x4
+#define OBJECT_TAG_CHAR 0x8
+#define OBJECT_TAG_MASK 0x7
+#define OBJECT_FALSE ((struct obj_t *)OBJECT_TAG_OTHER)
+#define OBJECT_TRUE ((struct obj_t *)(0x100 | OBJECT_TAG_OTHER))
+#define OBJECT_ZERO_DOUBLE ((struct obj_t *)0x8000000000000002)
+
 struct obj_t {
-  struct obj_t *gc_next;
-  bool marked;
+  struct obj_t *gc_next; // the copy of a young object that was forwarded
+  bool forwarded;
+  bool immortal; // never freed and never changed, e.g. the value of a literal
   enum OBJECT_TYPE type;
   union {
-    int int_value;
-    double double_value;
-    bool bool_value;
-    char rune_value;
+    double double_value; // a double without an immediate form
 
     struct {
       char *data;
@@ -49,16 +76,169 @@ struct obj_t {
     struct error_t *err_value;
 
     struct {
-      struct environment *env;
-      struct identifier **parameters;
-      size_t param_count;
-      size_t param_capacity;
-      struct block_statement *blk_stmts;
+      struct environment *env; // shared with the other closures created in it
+      struct function_proto *proto;
     } function_value;
   };
 };
 
+/**
+ * what the closures of one fn literal have in common, built once per
+ * literal and never freed (like the ast of function bodies). the code the
+ * engines compile the body to is cached here, so it is compiled once per
+ * literal rather than once per closure
+ */
+struct function_proto {
+  struct identifier **parameters;
+  size_t param_count;
+  size_t param_capacity;
+  struct block_statement *body;
+  const struct scope *scope; // slots of the call environments (resolver.h)
+  size_t local_count;        // slots of a call environment
+  bool captured; // closures created by the body keep its call environments
+  struct chunk *chunk; // bytecode of the body, compiled by the vm
+  struct reg_chunk *reg_chunk; // same for the register vm
+  struct cnode *cnode; // closure compiled body (cnode.h)
+  size_t call_count;   // calls until the function is hot (jit.h)
+  struct jit_function *jit;
+  // function compiled ahead of time to c, called with the environment of
+  // the closure and the arguments (runtime.h)
+  struct obj_t *(*native)(struct environment *, struct obj_t **);
+};
+
+/**
+ * objects are allocated from the slots of this class (slab.h), it is swept
+ * by the gc. the values of literals come from a class of their own
+ */
+extern struct slab_class object_slab;
+
 struct obj_t *object_t_init(enum OBJECT_TYPE t);
 void object_t_free(struct obj_t *v);
 
+static inline bool object_t_is_immediate(const struct obj_t *obj) {
+  return (uintptr_t)obj & OBJECT_TAG_MASK;
+}
+
+/**
+ * type of an immediate or of an object, a bool is OBJECT_BOOL (the true
+ * and false types only name the value asked from gc_alloc)
+ */
+static inline enum OBJECT_TYPE object_t_type(const struct obj_t *obj) {
+  uintptr_t bits = (uintptr_t)obj;
+  if (bits & OBJECT_TAG_INT) {
+    return OBJECT_INT;
+  } else if (bits & OBJECT_TAG_DOUBLE) {
+    return OBJECT_DOUBLE;
+  } else if (bits & OBJECT_TAG_OTHER) {
+    return bits & OBJECT_TAG_CHAR ? OBJECT_CHAR : OBJECT_BOOL;
+  }
+  return obj->type;
+}
+
+static inline bool object_t_is_int(const struct obj_t *obj) {
+  return (uintptr_t)obj & OBJECT_TAG_INT;
+}
+
+static inline struct obj_t *object_t_from_int(int value) {
+  return (struct obj_t *)(((uintptr_t)(uint32_t)value << 32) |
+                          OBJECT_TAG_INT);
+}
+
+static inline int object_t_int(const struct obj_t *obj) {
+  return (int32_t)(uint32_t)((uintptr_t)obj >> 32);
+}
+
+static inline struct obj_t *object_t_from_bool(bool value) {
+  return value ? OBJECT_TRUE : OBJECT_FALSE;
+}
+
+static inline bool object_t_bool(const struct obj_t *obj) {
+  return obj == OBJECT_TRUE;
+}
+
+static inline struct obj_t *object_t_from_char(char value) {
+  return (struct obj_t *)(((uintptr_t)(unsigned char)value << 8) |
+                          OBJECT_TAG_CHAR | OBJECT_TAG_OTHER);
+}
+
+static inline char object_t_char(const struct obj_t *obj) {
+  return (char)((uintptr_t)obj >> 8);
+}
+
+/**
+ * the immediate holding value, NULL when value has no immediate form. for
+ * the doubles whose exponent starts with 011 or 100 (magnitudes from about
+ * 1e-77 to 1e77) the first two of those bits follow from the third, the
+ * double is rotated by 3 so that they are where the tag goes and the sign
+ * is above it. +0.0 has an encoding of its own
+ */
+static inline struct obj_t *object_t_immediate_double(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  unsigned top = (bits >> 60) & 0x7;
+  if ((top == 3 || top == 4) && bits != 0x3000000000000000) {
+    uint64_t rotated = (bits << 3) | (bits >> 61);
+    return (struct obj_t *)(uintptr_t)((rotated & ~(uint64_t)0x1) |
+                                       OBJECT_TAG_DOUBLE);
+  } else if (bits == 0) {
+    return OBJECT_ZERO_DOUBLE;
+  }
+  return NULL;
+}
+
+static inline double object_t_double(const struct obj_t *obj) {
+  uint64_t word = (uintptr_t)obj;
+  if (!(word & OBJECT_TAG_DOUBLE)) {
+    return obj->double_value;
+  } else if (obj == OBJECT_ZERO_DOUBLE) {
+    return 0.0;
+  }
+  // the third bit of the exponent was rotated to the top, it gives back
+  // the two bits the tag took
+  uint64_t bits = (2 - (word >> 63)) | (word & ~(uint64_t)0x3);
+  bits = (bits >> 3) | (bits << 61);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * memory for one object, uninitialized. it is released by object_t_free
+ */
+struct obj_t *object_t_alloc();
+
+/**
+ * initialize an object of type t in memory owned by the caller (e.g. the
+ * nursery of the gc), returns false for types that have no objects
+ */
+bool object_t_init_in(struct obj_t *v, enum OBJECT_TYPE t);
+
+/**
+ * free what the object owns (the data of a string, an error) but not the
+ * object itself
+ */
+void object_t_free_fields(struct obj_t *v);
+
+/**
+ * value of a literal, an immediate or built the first time it is asked for
+ * and shared by every evaluation of the literal in every engine. it is
+ * immortal, so it is not tracked by the gc
+ */
+struct obj_t *literal_object_of(struct literal *literal);
+
+/**
+ * prototype of a function with the given parameters and body, scope is NULL
+ * for functions the resolver did not see
+ */
+struct function_proto *function_proto_init(struct identifier **parameters,
+                                           size_t param_count,
+                                           size_t param_capacity,
+                                           struct block_statement *body,
+                                           const struct scope *scope);
+
+/**
+ * prototype of a fn literal, built the first time it is asked for
+ */
+struct function_proto *function_proto_of(struct function_literal *literal);
+
 #endif // !OBJECT_T_H
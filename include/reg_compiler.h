@@ -0,0 +1,141 @@
+#ifndef REG_COMPILER_H
+#define REG_COMPILER_H
+
+/**
+ * reg_compiler lowers a parsed program into three-address instructions for
+ * the register vm (reg_vm.h). every function gets a register file per call,
+ * parameters and locals live in fixed registers and temporaries are
+ * allocated above them
+ */
+
+#include "ast.h"
+#include "object_t.h"
+#include "token.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * operands b and c of arithmetic and comparison instructions are "rk"
+ * operands: with REG_RK_CONSTANT set they index the constant pool,
+ * otherwise a register. constants past REG_RK_MAX are loaded with LOADK
+ */
+#define REG_RK_CONSTANT 0x80
+#define REG_RK_MAX 0x7f
+
+/**
+ * upper bound on the registers of a single frame
+ */
+#define REG_MAX_REGISTERS 255
+
+// clang-format off
+
+enum REG_OPCODE {
+  ROP_MOVE,      // a b     R(a) := R(b)
+  ROP_LOADK,     // a bx    R(a) := K(bx)
+  ROP_LOADNULL,  // a       R(a) := sentinel
+  ROP_LOADBOOL,  // a b     R(a) := b ? true : false
+
+  ROP_GETNAME,   // a bx    R(a) := look up N(bx) in the frame environment
+  ROP_DEFNAME,   // a bx    bind N(bx) := R(a) in the frame environment
+  ROP_SETNAME,   // a bx    rebind N(bx) := R(a) where it was defined
+  ROP_GETLOCAL,  // a b c   R(a) := R(b), or look up N(c) if R(b) is unset
+
+  ROP_ADD,       // a b c   R(a) := RK(b) + RK(c)
+  ROP_SUB,       // a b c   R(a) := RK(b) - RK(c)
+  ROP_MUL,       // a b c   R(a) := RK(b) * RK(c)
+  ROP_LT,        // a b c   R(a) := RK(b) < RK(c)
+  ROP_GT,        // a b c   R(a) := RK(b) > RK(c)
+  ROP_LT_EQ,     // a b c   R(a) := RK(b) <= RK(c)
+  ROP_GT_EQ,     // a b c   R(a) := RK(b) >= RK(c)
+  ROP_EQ_EQ,     // a b c   R(a) := RK(b) == RK(c)
+  ROP_NOT_EQ,    // a b c   R(a) := RK(b) != RK(c)
+  ROP_INFIX,     // a b c   R(a) := RK(b) <op> RK(c), any other operator
+
+  ROP_NOT,       // a b     R(a) := !R(b)
+  ROP_NEGATE,    // a b     R(a) := -R(b)
+  ROP_INC,       // a b     R(a) := R(b) + 1
+  ROP_DEC,       // a b     R(a) := R(b) - 1
+  ROP_RAISE,     // a       raise the RAISE_KIND error a
+
+  ROP_JMP,       // bx      pc += bx
+  ROP_JMPF,      // a bx    if R(a) is falsy then pc += bx
+  ROP_LOOP,      // bx      pc -= bx
+
+  ROP_CLOSURE,   // a bx    R(a) := new function object for F(bx)
+  ROP_CALL,      // a b     R(a) := R(a)(R(a + 1), ..., R(a + b))
+  ROP_RETURN,    // a       return R(a) to the caller
+};
+
+// clang-format on
+
+/**
+ * instructions are 4 bytes, either a b c or a bx
+ */
+struct reg_instr {
+  uint8_t op;
+  uint8_t a;
+  union {
+    struct {
+      uint8_t b;
+      uint8_t c;
+    };
+    uint16_t bx;
+  };
+};
+
+/**
+ * reg_chunk is the compiled form of a single function (or the top level)
+ */
+struct reg_chunk {
+  struct reg_instr *code;
+  struct token **tokens; // token of each instruction, used for errors
+  size_t count;
+  size_t capacity;
+
+  struct obj_t **constants; // immortal, see chunk_free in compiler.c
+  size_t constant_count;
+  size_t constant_capacity;
+
+  char **names; // owned
+  size_t name_count;
+  size_t name_capacity;
+
+  struct reg_chunk **functions; // nested function literals
+  size_t function_count;
+  size_t function_capacity;
+
+  struct identifier **parameters;
+  size_t param_count;
+  size_t param_capacity;
+  struct block_statement *body;
+  struct function_proto *proto; // of the closures of the chunk, built lazily
+
+  /**
+   * when uses_env is set, parameters and lets live in a per call
+   * environment, otherwise in registers [0, local_count)
+   */
+  bool uses_env;
+  size_t local_count;
+  size_t register_count; // size of the register file of a frame
+};
+
+/**
+ * compile the top level statements of a program
+ */
+struct reg_chunk *reg_compiler_compile_program(struct program *program);
+
+/**
+ * compile the body of a function literal
+ */
+struct reg_chunk *reg_compiler_compile_function(struct identifier **parameters,
+                                                size_t param_count,
+                                                size_t param_capacity,
+                                                struct block_statement *body);
+
+/**
+ * free a chunk, nested chunks are kept alive (see chunk_free in compiler.c)
+ */
+void reg_chunk_free(struct reg_chunk *chunk);
+
+#endif // !REG_COMPILER_H
@@ -0,0 +1,21 @@
+#ifndef REG_VM_H
+#define REG_VM_H
+
+/**
+ * register based virtual machine that runs the three-address code produced
+ * by reg_compiler.h
+ */
+
+#include "ast.h"
+#include "environment.h"
+#include "object_t.h"
+
+/**
+ * compile and run a program, top level names are defined in env.
+ * returns NULL if the program could not be compiled, in that case the
+ * caller is expected to fall back to the tree walker
+ */
+struct obj_t *reg_vm_run_program(struct environment *env,
+                                 struct program *program);
+
+#endif // !REG_VM_H
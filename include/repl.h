@@ -1,7 +1,15 @@
 #ifndef REPL_H
 #define REPL_H
 
+#include <stdbool.h>
+
 void repl();
 void shutdown();
 
+/**
+ * evaluate a whole source file and print the value of the program,
+ * returns false if the file could not be read
+ */
+bool run_file(const char *filename);
+
 #endif // !REPL_H
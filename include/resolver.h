@@ -0,0 +1,27 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+/**
+ * post parse pass giving the variables of functions a fixed place. the
+ * parameters and lets of a fn literal become the slots of its scope (struct
+ * scope in environment.h), identifiers referring to them are tagged with the
+ * number of functions between the use and the binding and with the slot, so
+ * the tree walker reads them with a few pointer loads instead of hashing the
+ * name at every level of the environment chain. names of the top level
+ * program stay in the hash table of the global environment
+ *
+ * a let only binds once it ran (blocks do not open a scope), so a slot can
+ * still be empty at runtime, the name is then looked up as before
+ */
+
+#include "ast.h"
+
+#define SCOPE_INITIAL_CAPACITY 4
+
+/**
+ * resolve the identifiers and lets inside of every fn literal of the
+ * program. fn literals that were resolved before are skipped
+ */
+void resolve_program(struct program *);
+
+#endif // !RESOLVER_H
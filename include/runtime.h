@@ -0,0 +1,253 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+/**
+ * runtime support for the c code emitted by the transpiler (transpiler.h).
+ * the emitted code keeps the semantics of the tree walker: values are gc
+ * objects and errors are error objects that are returned up to the top
+ * level. the names the resolver bound are slots, of the array of the c
+ * function or of an environment when closures refer to them, the others
+ * are looked up in environments
+ */
+
+#include "environment.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object_t.h"
+#include "token.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// compiled function, called with the environment of the closure
+typedef struct obj_t *(*arc_native_fn)(struct environment *,
+                                       struct obj_t **args);
+
+// statements of a compiled function, t is the array of its slots followed
+// by its temporaries
+typedef struct obj_t *(*arc_body_fn)(struct environment *, struct obj_t **t);
+
+// clang-format off
+
+struct obj_t *arc_string(const char *data, size_t length);
+struct obj_t *arc_char(char value);
+struct obj_t *arc_error(struct token *, const char *message, const char *help);
+
+/**
+ * ++ (delta 1) and -- (delta -1) on the object bound to name, evaluates to
+ * the old value and updates the bound object in place
+ */
+struct obj_t *arc_step(struct environment *, char *name, struct token *, int delta);
+
+/**
+ * ++ and -- on a slot, owner is the environment holding it (NULL for a slot
+ * of the array of a c function). an unset slot is stepped by name in env
+ */
+struct obj_t *arc_step_slot(struct environment *owner, struct obj_t **slot, struct environment *env, char *name, struct token *, int delta);
+
+/**
+ * create a function object for a compiled fn literal with the given
+ * parameter names, the body is the native function. proto points at the
+ * prototype of the literal, it is built by the first call
+ */
+struct obj_t *arc_function(struct environment *, struct token *, struct function_proto **proto, const char *const *names, size_t param_count, arc_native_fn);
+
+/**
+ * call a function object with the environment of the closure, the native
+ * function binds the arguments
+ */
+struct obj_t *arc_call(struct token *, struct obj_t *function, struct obj_t **args, size_t arg_count);
+
+/**
+ * environment of a call of a function whose names closures refer to, the
+ * arguments are bound to the first slots. NULL if there is no memory
+ */
+struct environment *arc_call_env(const struct scope *, struct environment *parent, struct obj_t **args, size_t param_count);
+
+/**
+ * run a compiled program in env and print its result the way the repl
+ * does, returns false if the program evaluated to an error
+ */
+bool arc_run(arc_native_fn program, struct environment *env);
+
+// clang-format on
+
+/**
+ * the helpers below are on the hot path of every emitted expression, they
+ * are defined here so the c compiler can inline them
+ */
+
+static inline struct obj_t *arc_int(int value) { return gc_int(value); }
+
+static inline struct obj_t *arc_double(double value) {
+  return gc_double(value);
+}
+
+static inline bool arc_both_int(struct obj_t *left, struct obj_t *right) {
+  return object_t_is_int(left) && object_t_is_int(right);
+}
+
+static inline bool arc_both_double(struct obj_t *left, struct obj_t *right) {
+  return object_t_type(left) == OBJECT_DOUBLE &&
+         object_t_type(right) == OBJECT_DOUBLE;
+}
+
+static inline struct obj_t *arc_bool(bool value) {
+  return value ? gc_alloc(OBJECT_BOOL_TRUE) : gc_alloc(OBJECT_BOOL_FALSE);
+}
+
+// has_error without the call into the evaluator
+static inline bool arc_failed(struct obj_t *obj) {
+  return obj && object_t_type(obj) == OBJECT_ERROR;
+}
+
+// environment hops levels up the chain
+static inline struct environment *arc_outer(struct environment *env,
+                                            size_t hops) {
+  for (size_t i = 0; i < hops; i++) {
+    env = env->parent;
+  }
+  return env;
+}
+
+// bind value to a slot of env
+static inline void arc_bind(struct environment *env, size_t slot,
+                            struct obj_t *value) {
+  gc_write_barrier(env, value);
+  env->slots[slot] = value;
+}
+
+/**
+ * a tail call of the running function with the same closure environment,
+ * the body can jump back to its start instead of calling
+ */
+static inline bool arc_is_self(struct obj_t *function,
+                               const struct function_proto *proto,
+                               struct environment *env) {
+  return object_t_type(function) == OBJECT_FUNCTION &&
+         function->function_value.proto == proto &&
+         function->function_value.env == env;
+}
+
+/**
+ * run body with env and its count temporaries on the shadow root stack, the
+ * temporaries start out NULL. the entry of a function is a safe point like
+ * the back edges of its loops
+ */
+static inline struct obj_t *arc_enter(arc_body_fn body,
+                                      struct environment *env,
+                                      struct obj_t **temps, size_t count) {
+  gc_push_env_root(env);
+  gc_push_roots(temps, count);
+  gc_safe_point();
+  struct obj_t *result = body(env, temps);
+  gc_pop_roots(2);
+  return result;
+}
+
+/**
+ * make env the root of the running body in place of the environment
+ * arc_enter was given, for a tail call that made a new call environment.
+ * while pushes are lost no collection runs until the body returns
+ */
+static inline void arc_reenter(struct environment *env) {
+  if (!gc_root_stack.lost) {
+    // the temporaries are the root on top, the environment is below them
+    gc_root_stack.roots[gc_root_stack.count - 2].env = env;
+  }
+}
+
+// clang-format off
+
+#define ARC_ARITHMETIC(name, op)                                               \
+  static inline struct obj_t *name(struct token *token, struct obj_t *left,    \
+                                   struct obj_t *right) {                      \
+    if (arc_both_int(left, right)) {                                           \
+      return arc_int(object_t_int(left) op object_t_int(right));               \
+    }                                                                          \
+    if (arc_both_double(left, right)) {                                        \
+      return arc_double(object_t_double(left) op object_t_double(right));      \
+    }                                                                          \
+    return evaluate_infix_expr(token, left, right);                            \
+  }
+
+/**
+ * the comparison as an object, and test_name for conditions: 1 or 0 for
+ * true or false and -1 when the comparison evaluated to an error, which is
+ * stored in value
+ */
+#define ARC_COMPARISON(name, test_name, op)                                    \
+  static inline struct obj_t *name(struct token *token, struct obj_t *left,    \
+                                   struct obj_t *right) {                      \
+    if (arc_both_int(left, right)) {                                           \
+      return arc_bool(object_t_int(left) op object_t_int(right));              \
+    }                                                                          \
+    if (arc_both_double(left, right)) {                                        \
+      return arc_bool(object_t_double(left) op object_t_double(right));        \
+    }                                                                          \
+    return evaluate_infix_expr(token, left, right);                            \
+  }                                                                            \
+  static inline int test_name(struct token *token, struct obj_t *left,         \
+                              struct obj_t *right, struct obj_t **value) {     \
+    if (arc_both_int(left, right)) {                                           \
+      return object_t_int(left) op object_t_int(right);                        \
+    }                                                                          \
+    if (arc_both_double(left, right)) {                                        \
+      return object_t_double(left) op object_t_double(right);                  \
+    }                                                                          \
+    *value = evaluate_infix_expr(token, left, right);                          \
+    return arc_failed(*value) ? -1 : is_truthy(*value);                        \
+  }
+
+ARC_ARITHMETIC(arc_add, +)
+ARC_ARITHMETIC(arc_sub, -)
+ARC_ARITHMETIC(arc_mul, *)
+ARC_COMPARISON(arc_lt, arc_test_lt, <)
+ARC_COMPARISON(arc_gt, arc_test_gt, >)
+ARC_COMPARISON(arc_lt_eq, arc_test_lt_eq, <=)
+ARC_COMPARISON(arc_gt_eq, arc_test_gt_eq, >=)
+ARC_COMPARISON(arc_eq_eq, arc_test_eq_eq, ==)
+ARC_COMPARISON(arc_not_eq, arc_test_not_eq, !=)
+
+#undef ARC_ARITHMETIC
+#undef ARC_COMPARISON
+
+// clang-format on
+
+/**
+ * division and modulo by 0, and INT_MIN by -1, evaluate to the sentinel
+ * like they do in the interpreter
+ */
+static inline struct obj_t *arc_div(struct token *token, struct obj_t *left,
+                                    struct obj_t *right) {
+  if (arc_both_int(left, right)) {
+    int a = object_t_int(left);
+    int b = object_t_int(right);
+    if (b == 0 || (b == -1 && a == INT_MIN)) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+    return arc_int(a / b);
+  }
+  if (arc_both_double(left, right)) {
+    if (object_t_double(right) == 0) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+    return arc_double(object_t_double(left) / object_t_double(right));
+  }
+  return evaluate_infix_expr(token, left, right);
+}
+
+static inline struct obj_t *arc_mod(struct token *token, struct obj_t *left,
+                                    struct obj_t *right) {
+  if (arc_both_int(left, right)) {
+    int a = object_t_int(left);
+    int b = object_t_int(right);
+    if (b == 0 || (b == -1 && a == INT_MIN)) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+    return arc_int(a % b);
+  }
+  return evaluate_infix_expr(token, left, right);
+}
+
+#endif // !RUNTIME_H
@@ -0,0 +1,117 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+/**
+ * slab allocator for blocks of one size. a slab class hands out slots from
+ * chunks of SLAB_CHUNK_SIZE bytes that are aligned to their size, so the
+ * chunk of a slot is found from its address. a freed slot goes back on the
+ * free list of its chunk, the chunks of a class that have free slots are on
+ * its partial list, the chunk freed into last is the one allocated from
+ * next. a chunk that becomes empty is given back to the system unless it is
+ * the only empty chunk of its class
+ *
+ * the mark bits of a collector live in a bitmap in the header of each chunk
+ * (slab_mark), next to a bitmap of the slots in use. slab_start_sweep does
+ * not touch the chunks, each one is swept (its slots in use that are not
+ * marked are finalized and freed) the first time slab_alloc needs it
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLAB_CHUNK_SIZE 4096
+#define SLAB_MIN_SIZE 16 // bytes of the smallest slot
+#define SLAB_BITMAP_WORDS (SLAB_CHUNK_SIZE / SLAB_MIN_SIZE / 64)
+
+struct slab_class;
+
+struct slab_chunk {
+  struct slab_class *class;
+  struct slab_chunk *prev; // neighbours on the partial list of the class
+  struct slab_chunk *next;
+  struct slab_chunk *older; // neighbours on the list of all the chunks
+  struct slab_chunk *newer;
+  void *free;      // freed slots, linked through their first word
+  char *unused;    // the slots from here on were never handed out
+  size_t used;     // slots handed out and not freed
+  size_t epoch;    // sweep of the class the chunk is done with
+  uint64_t in_use[SLAB_BITMAP_WORDS];
+  uint64_t marks[SLAB_BITMAP_WORDS];
+};
+
+struct slab_class {
+  size_t size;                  // bytes of a slot, at least SLAB_MIN_SIZE
+  void (*finalize)(void *slot); // called on the slots a sweep frees
+  size_t slots;                 // slots of a chunk, set by the first chunk
+  struct slab_chunk *partial;   // chunks with free slots
+  struct slab_chunk *newest;    // all the chunks, the newest first
+  struct slab_chunk *sweep;     // next chunk to sweep, older ones are done
+  size_t epoch;                 // sweeps started so far
+  size_t chunk_count;
+  size_t empty_count; // chunks without a slot in use, at most 1
+  size_t used;        // slots in use in all the chunks
+};
+
+/**
+ * class of slots of sizeof(type) bytes, finalize can be NULL for classes
+ * that are never swept
+ */
+#define SLAB_CLASS(type, finalize)                                             \
+  {sizeof(type), finalize, 0, NULL, NULL, NULL, 0, 0, 0, 0}
+
+/**
+ * a slot of the class, uninitialized. NULL when there is no memory
+ */
+void *slab_alloc(struct slab_class *class);
+
+/**
+ * give slot back to its chunk, slot comes from slab_alloc
+ */
+void slab_free(void *slot);
+
+/**
+ * free the slots in use that are not marked, lazily: a chunk is swept when
+ * slab_alloc looks for a slot in it, or by slab_finish_sweep. the marks of
+ * a chunk are cleared by its sweep
+ */
+void slab_start_sweep(struct slab_class *class);
+
+/**
+ * sweep the chunks the last slab_start_sweep has not swept yet, call it
+ * before marking starts again
+ */
+void slab_finish_sweep(struct slab_class *class);
+
+static inline struct slab_chunk *slab_chunk_of(const void *slot) {
+  return (struct slab_chunk *)((uintptr_t)slot &
+                               ~(uintptr_t)(SLAB_CHUNK_SIZE - 1));
+}
+
+// index of slot in the bitmaps of its chunk
+static inline size_t slab_index(const struct slab_chunk *chunk,
+                                const void *slot) {
+  return ((uintptr_t)slot & (SLAB_CHUNK_SIZE - 1)) / chunk->class->size;
+}
+
+/**
+ * set the mark bit of slot, false if it was set already
+ */
+static inline bool slab_mark(const void *slot) {
+  struct slab_chunk *chunk = slab_chunk_of(slot);
+  size_t index = slab_index(chunk, slot);
+  uint64_t bit = (uint64_t)1 << (index % 64);
+  if (chunk->marks[index / 64] & bit) {
+    return false;
+  }
+  chunk->marks[index / 64] |= bit;
+  return true;
+}
+
+static inline bool slab_is_marked(const void *slot) {
+  struct slab_chunk *chunk = slab_chunk_of(slot);
+  size_t index = slab_index(chunk, slot);
+  return chunk->marks[index / 64] & ((uint64_t)1 << (index % 64));
+}
+
+#endif // !SLAB_H
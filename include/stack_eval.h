@@ -0,0 +1,53 @@
+#ifndef STACK_EVAL_H
+#define STACK_EVAL_H
+
+/**
+ * non-recursive ast evaluator. instead of recursing on the c stack every
+ * pending statement, expression and call is a frame on a heap allocated
+ * stack, the intermediate values live on a second stack next to it. both
+ * grow and shrink with the program, so the depth of recursion is limited
+ * by memory only and not by the size of the c stack
+ */
+
+#include "ast.h"
+#include "environment.h"
+#include "object_t.h"
+#include <stddef.h>
+
+#define STACK_EVAL_INITIAL_FRAMES 64
+#define STACK_EVAL_INITIAL_VALUES 64
+
+/**
+ * what a frame evaluates, the state field of the frame says how far it got
+ */
+enum FRAME_KIND {
+  FRAME_EXPRESSION,
+  FRAME_STATEMENT,
+  FRAME_BLOCK,
+  FRAME_CALL, // body of a function call is running, return unwinds to here
+};
+
+struct frame {
+  enum FRAME_KIND kind;
+  size_t state;            // resume point, e.g. index of the next child
+  size_t base;             // height of the value stack when the call started
+  struct environment *env; // environment the frame is evaluated in
+  union {
+    bool captured; // FRAME_CALL: env (of the call) is kept by closures
+    struct expression *expr;
+    struct statement *stmt;
+    struct {
+      struct statement **statements;
+      size_t count;
+    } block;
+  };
+};
+
+/**
+ * evaluate the program in env, returns NULL if the evaluator could not be
+ * set up (the caller falls back to the tree walker)
+ */
+struct obj_t *stack_eval_run_program(struct environment *env,
+                                     struct program *program);
+
+#endif // !STACK_EVAL_H
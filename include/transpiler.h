@@ -0,0 +1,28 @@
+#ifndef TRANSPILER_H
+#define TRANSPILER_H
+
+/**
+ * ahead of time compilation of arc programs to c. every fn literal becomes a
+ * c function and every expression a call into the runtime (runtime.h), the
+ * emitted file is linked against the interpreter library (make lib):
+ *
+ *   interpreter --emit-c script.arc > script.c
+ *   gcc -O2 -Iinclude script.c bin/libarc.a -o script
+ *
+ * the compiled program behaves exactly like the tree walker. the names the
+ * resolver bound (resolver.h) are slots of an array of the c function, or of
+ * an environment when nested fn literals refer to them, only the names of
+ * the top level are looked up by name. int and double operations are inlined
+ * and a function returning a call to itself jumps back to its start
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * parse filename and write the c translation to out, returns false if the
+ * file could not be read or has parser errors
+ */
+bool transpile_file(const char *filename, FILE *out);
+
+#endif // !TRANSPILER_H
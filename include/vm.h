@@ -0,0 +1,32 @@
+#ifndef VM_H
+#define VM_H
+
+/**
+ * stack based virtual machine that runs the bytecode produced by compiler.h
+ */
+
+#include "ast.h"
+#include "environment.h"
+#include "compiler.h"
+#include "object_t.h"
+#include "token.h"
+
+/**
+ * compile and run a program, top level names are defined in env.
+ * returns NULL if the program could not be compiled, in that case the
+ * caller is expected to fall back to the tree walker
+ */
+struct obj_t *vm_run_program(struct environment *env, struct program *program);
+
+// clang-format off
+
+/**
+ * runtime errors and ++/-- semantics, shared with the register vm
+ */
+struct obj_t *vm_error(struct token *, const char *message, const char *help);
+struct obj_t *vm_step(struct token *, struct obj_t *, int delta);
+struct obj_t *vm_raise(struct token *, enum RAISE_KIND);
+
+// clang-format on
+
+#endif // !VM_H
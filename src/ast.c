@@ -13,13 +13,15 @@ struct statement *ast_statement_init(enum STATEMENT_TYPE type) {
     return NULL;
   }
   s->type = type;
+  s->fused = FUSED_NONE;
   switch (s->type) {
   case STMT_LET: {
     s->let_stmt.token = NULL;
     s->let_stmt.identifier = NULL;
     s->let_stmt.ident = NULL;
     s->let_stmt.value = NULL;
-
+    s->let_stmt.scope = NULL;
+    s->let_stmt.slot = 0;
   }; break;
   case STMT_RETURN: {
     s->return_stmt.token = NULL;
@@ -81,21 +83,30 @@ struct expression *ast_expression_init(enum EXPRESSION_TYPE e) {
     return NULL;
   }
   expr->type = e;
+  expr->fused = FUSED_NONE;
   switch (expr->type) {
   case EXPR_LITERAL: {
     expr->literal.token = NULL;
     expr->literal.literal_type = LITERAL_INT;
     expr->literal.value.int_value = 0;
+    expr->literal.object = NULL;
   }; break;
   case EXPR_IDENTIFIER: {
     expr->identifier_expr.identifier = NULL;
     expr->identifier_expr.token = NULL;
+    expr->identifier_expr.scope = NULL;
+    expr->identifier_expr.depth = 0;
+    expr->identifier_expr.slot = 0;
   }; break;
   case EXPR_INFIX: {
     expr->infix_expr.left = NULL;
     expr->infix_expr.op = NULL;
     expr->infix_expr.op_str = NULL;
     expr->infix_expr.right = NULL;
+    expr->infix_expr.quick = NULL;
+    expr->infix_expr.quick_type = 0;
+    expr->infix_expr.quick_hits = 0;
+    expr->infix_expr.quick_misses = 0;
   }; break;
   case EXPR_PREFIX: {
     expr->prefix_expr.op = NULL;
@@ -113,18 +124,29 @@ struct expression *ast_expression_init(enum EXPRESSION_TYPE e) {
     expr->conditional.consequence = NULL;
     expr->conditional.alternative = NULL;
   }; break;
+  case EXPR_LOOP: {
+    expr->loop.token = NULL;
+    expr->loop.init = NULL;
+    expr->loop.condition = NULL;
+    expr->loop.update = NULL;
+    expr->loop.body = NULL;
+  }; break;
   case EXPR_FUNCTION: {
     expr->function.token = NULL;
     expr->function.parameters = NULL;
     expr->function.param_count = 0;
     expr->function.param_capacity = 0;
     expr->function.body = NULL;
+    expr->function.scope = NULL;
+    expr->function.proto = NULL;
   }; break;
   case EXPR_FUNCTION_CALL: {
     expr->function_call.token = NULL;
     expr->function_call.fn_call_token = NULL;
     expr->function_call.function = NULL;
     expr->function_call.arguments = NULL;
+    expr->function_call.cached_entry = NULL;
+    expr->function_call.cached_shape = 0;
   }; break;
   }
   return expr;
@@ -170,6 +192,12 @@ void ast_expression_free(struct expression *e) {
       ast_block_statement_free(e->conditional.consequence);
       ast_block_statement_free(e->conditional.alternative);
     }; break;
+    case EXPR_LOOP: {
+      ast_statement_free(e->loop.init);
+      ast_expression_free(e->loop.condition);
+      ast_expression_free(e->loop.update);
+      ast_block_statement_free(e->loop.body);
+    }; break;
     case EXPR_FUNCTION: {
       /**
        * NOTE: freeing the block statements and the identifiers
@@ -210,6 +238,7 @@ struct literal *ast_literal_init(enum LITERAL_TYPE type) {
     return NULL;
   }
   l->literal_type = type;
+  l->object = NULL;
   return l;
 }
 
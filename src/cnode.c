@@ -0,0 +1,827 @@
+#include "cnode.h"
+#include "ast.h"
+#include "environment.h"
+#include "error_t.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "jit.h"
+#include "object_t.h"
+#include "token.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * calls with up to this many arguments evaluate them into a buffer on the
+ * c stack instead of the heap
+ */
+#define CNODE_INLINE_ARGS 8
+
+// clang-format off
+
+static struct cnode *cnode_init(enum CNODE_KIND, cnode_eval_fn, struct token *);
+static struct cnode *compile_statement(struct statement *, bool *failed);
+static struct cnode *compile_expression(struct expression *, bool *failed);
+static struct cnode *compile_literal(struct expression *);
+static struct cnode *compile_infix(struct expression *, bool *failed);
+static struct cnode *compile_call(struct expression *, bool *failed);
+static struct cnode *compile_statements(struct statement **, size_t, struct token *, bool *failed);
+
+static struct obj_t *eval_sentinel(struct cnode *, struct environment *);
+static struct obj_t *eval_true(struct cnode *, struct environment *);
+static struct obj_t *eval_false(struct cnode *, struct environment *);
+static struct obj_t *eval_literal(struct cnode *, struct environment *);
+static struct obj_t *eval_name(struct cnode *, struct environment *);
+static struct obj_t *eval_not(struct cnode *, struct environment *);
+static struct obj_t *eval_negate(struct cnode *, struct environment *);
+static struct obj_t *eval_prefix(struct cnode *, struct environment *);
+static struct obj_t *eval_postfix(struct cnode *, struct environment *);
+static struct obj_t *eval_infix(struct cnode *, struct environment *);
+static struct obj_t *eval_if(struct cnode *, struct environment *);
+static struct obj_t *eval_loop(struct cnode *, struct environment *);
+static struct obj_t *eval_block(struct cnode *, struct environment *);
+static struct obj_t *eval_let(struct cnode *, struct environment *);
+static struct obj_t *eval_return(struct cnode *, struct environment *);
+static struct obj_t *eval_function(struct cnode *, struct environment *);
+static struct obj_t *eval_call(struct cnode *, struct environment *);
+static struct obj_t *eval_call_name(struct cnode *, struct environment *);
+static struct obj_t *call_function(struct cnode *, struct environment *, struct obj_t *);
+
+// clang-format on
+
+struct obj_t *cnode_run_program(struct environment *env,
+                                struct program *program) {
+  bool failed = false;
+  struct cnode *root = compile_statements(
+      program->statements, program->statement_count, NULL, &failed);
+  if (!root || failed) {
+    cnode_free(root);
+    return NULL;
+  }
+  struct obj_t *result = root->eval(root, env);
+  if (result && object_t_type(result) == OBJECT_RETURN) {
+    result = result->return_value.value;
+  }
+  cnode_free(root);
+  return result;
+}
+
+struct cnode *cnode_compile_block(struct block_statement *block) {
+  if (!block) {
+    return cnode_init(CNODE_LEAF, eval_sentinel, NULL);
+  }
+  bool failed = false;
+  struct cnode *node = compile_statements(
+      block->statements, block->statement_count, block->token, &failed);
+  if (failed) {
+    cnode_free(node);
+    return NULL;
+  }
+  return node;
+}
+
+void cnode_free(struct cnode *node) {
+  if (!node) {
+    return;
+  }
+  switch (node->kind) {
+  case CNODE_LEAF:
+    break;
+  case CNODE_BINARY: {
+    cnode_free(node->binary.left);
+    cnode_free(node->binary.right);
+  }; break;
+  case CNODE_UNARY: {
+    cnode_free(node->unary.operand);
+  }; break;
+  case CNODE_CONDITIONAL: {
+    cnode_free(node->conditional.condition);
+    cnode_free(node->conditional.consequence);
+    cnode_free(node->conditional.alternative);
+  }; break;
+  case CNODE_LOOP: {
+    cnode_free(node->loop.init);
+    cnode_free(node->loop.condition);
+    cnode_free(node->loop.update);
+    cnode_free(node->loop.body);
+  }; break;
+  case CNODE_BLOCK: {
+    for (size_t i = 0; i < node->block.count; i++) {
+      cnode_free(node->block.statements[i]);
+    }
+    free(node->block.statements);
+  }; break;
+  case CNODE_LET: {
+    cnode_free(node->let.value);
+  }; break;
+  case CNODE_FUNCTION: {
+    /**
+     * NOTE: function objects created from this node point at the compiled
+     * body and can outlive the tree, so the body is not released here
+     */
+  }; break;
+  case CNODE_CALL: {
+    cnode_free(node->call.callee);
+    for (size_t i = 0; i < node->call.arg_count; i++) {
+      cnode_free(node->call.arguments[i]);
+    }
+    free(node->call.arguments);
+  }; break;
+  }
+  free(node);
+}
+
+static struct cnode *cnode_init(enum CNODE_KIND kind, cnode_eval_fn eval,
+                                struct token *token) {
+  struct cnode *node = calloc(1, sizeof(struct cnode));
+  if (!node) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  node->kind = kind;
+  node->eval = eval;
+  node->token = token;
+  return node;
+}
+
+// ========================================================================
+
+/**
+ * statements of a block (or the program) become a single block node, the
+ * compilation continues after a failure so the partial tree can be freed
+ */
+static struct cnode *compile_statements(struct statement **stmts,
+                                        size_t count, struct token *token,
+                                        bool *failed) {
+  struct cnode *node = cnode_init(CNODE_BLOCK, eval_block, token);
+  if (!node) {
+    *failed = true;
+    return NULL;
+  }
+  if (count == 0) {
+    return node;
+  }
+  node->block.statements = calloc(count, sizeof(struct cnode *));
+  if (!node->block.statements) {
+    ERROR_LOG("error while allocating memory\n");
+    *failed = true;
+    return node;
+  }
+  for (size_t i = 0; i < count; i++) {
+    node->block.statements[node->block.count++] =
+        compile_statement(stmts[i], failed);
+  }
+  return node;
+}
+
+static struct cnode *compile_statement(struct statement *stmt, bool *failed) {
+  struct cnode *node = NULL;
+  if (!stmt) {
+    node = cnode_init(CNODE_LEAF, eval_sentinel, NULL);
+  } else {
+    switch (stmt->type) {
+    case STMT_LET: {
+      node = cnode_init(CNODE_LET, eval_let, stmt->let_stmt.token);
+      if (node) {
+        node->let.name = stmt->let_stmt.ident;
+        node->let.value = compile_expression(stmt->let_stmt.value, failed);
+      }
+    }; break;
+    case STMT_RETURN: {
+      node = cnode_init(CNODE_UNARY, eval_return, stmt->return_stmt.token);
+      if (node) {
+        node->unary.operand =
+            compile_expression(stmt->return_stmt.value, failed);
+      }
+    }; break;
+    case STMT_EXPRESSION: {
+      return compile_expression(stmt->expr_stmt.expr, failed);
+    };
+    case STMT_FUNCTION_DEF: {
+      node = cnode_init(CNODE_LEAF, eval_sentinel, stmt->fn_def_stmt.token);
+    }; break;
+    }
+  }
+  if (!node) {
+    *failed = true;
+  }
+  return node;
+}
+
+static struct cnode *compile_expression(struct expression *expr,
+                                        bool *failed) {
+  struct cnode *node = NULL;
+  if (!expr) {
+    node = cnode_init(CNODE_LEAF, eval_sentinel, NULL);
+  } else {
+    switch (expr->type) {
+    case EXPR_LITERAL: {
+      node = compile_literal(expr);
+    }; break;
+    case EXPR_IDENTIFIER: {
+      node = cnode_init(CNODE_LEAF, eval_name, expr->identifier_expr.token);
+      if (node) {
+        node->name = expr->identifier_expr.identifier;
+      }
+    }; break;
+    case EXPR_PREFIX: {
+      struct token *op = expr->prefix_expr.op;
+      if (op->type == BANG || op->type == MINUS) {
+        node = cnode_init(CNODE_UNARY,
+                          op->type == BANG ? eval_not : eval_negate, op);
+        if (node) {
+          node->unary.operand =
+              compile_expression(expr->prefix_expr.right, failed);
+        }
+      } else {
+        node = cnode_init(CNODE_LEAF, eval_prefix, op);
+        if (node) {
+          node->expr = expr;
+        }
+      }
+    }; break;
+    case EXPR_INFIX: {
+      node = compile_infix(expr, failed);
+    }; break;
+    case EXPR_POSTFIX: {
+      node = cnode_init(CNODE_LEAF, eval_postfix, expr->postfix_expr.op);
+      if (node) {
+        node->expr = expr;
+      }
+    }; break;
+    case EXPR_CONDITIONAL: {
+      node = cnode_init(CNODE_CONDITIONAL, eval_if, expr->conditional.token);
+      if (node) {
+        node->conditional.condition =
+            compile_expression(expr->conditional.condition, failed);
+        node->conditional.consequence =
+            cnode_compile_block(expr->conditional.consequence);
+        if (!node->conditional.consequence) {
+          *failed = true;
+        }
+        if (expr->conditional.alternative) {
+          node->conditional.alternative =
+              cnode_compile_block(expr->conditional.alternative);
+          if (!node->conditional.alternative) {
+            *failed = true;
+          }
+        }
+      }
+    }; break;
+    case EXPR_FUNCTION: {
+      node = cnode_init(CNODE_FUNCTION, eval_function, expr->function.token);
+      if (node) {
+        node->function.literal = &expr->function;
+        node->function.body = cnode_compile_block(expr->function.body);
+        if (!node->function.body) {
+          *failed = true;
+        }
+      }
+    }; break;
+    case EXPR_FUNCTION_CALL: {
+      node = compile_call(expr, failed);
+    }; break;
+    case EXPR_LOOP: {
+      node = cnode_init(CNODE_LOOP, eval_loop, expr->loop.token);
+      if (node) {
+        if (expr->loop.init) {
+          node->loop.init = compile_statement(expr->loop.init, failed);
+        }
+        if (expr->loop.condition) {
+          node->loop.condition =
+              compile_expression(expr->loop.condition, failed);
+        }
+        if (expr->loop.update) {
+          node->loop.update = compile_expression(expr->loop.update, failed);
+        }
+        node->loop.body = cnode_compile_block(expr->loop.body);
+        if (!node->loop.body) {
+          *failed = true;
+        }
+      }
+    }; break;
+    }
+  }
+  if (!node) {
+    *failed = true;
+  }
+  return node;
+}
+
+static struct cnode *compile_literal(struct expression *expr) {
+  cnode_eval_fn eval = eval_sentinel;
+  switch (expr->literal.literal_type) {
+  case LITERAL_BOOL:
+    eval = expr->literal.value.bool_value ? eval_true : eval_false;
+    break;
+  case LITERAL_INT:
+  case LITERAL_FLOAT:
+  case LITERAL_STRING:
+  case LITERAL_CHAR:
+    eval = eval_literal;
+    break;
+  }
+  struct cnode *node = cnode_init(CNODE_LEAF, eval, expr->literal.token);
+  if (node) {
+    node->literal = &expr->literal;
+  }
+  return node;
+}
+
+static struct cnode *compile_call(struct expression *expr, bool *failed) {
+  struct expression *callee = expr->function_call.function;
+  struct cnode *node = cnode_init(CNODE_CALL, eval_call,
+                                  expr->function_call.token);
+  if (!node) {
+    return NULL;
+  }
+  if (callee && callee->type == EXPR_IDENTIFIER) {
+    node->eval = eval_call_name;
+    node->call.callee_name = callee->identifier_expr.identifier;
+  } else {
+    node->call.callee = compile_expression(callee, failed);
+  }
+  size_t arg_count = expr->function_call.arg_count;
+  if (arg_count > 0) {
+    node->call.arguments = calloc(arg_count, sizeof(struct cnode *));
+    if (!node->call.arguments) {
+      ERROR_LOG("error while allocating memory\n");
+      *failed = true;
+      return node;
+    }
+  }
+  for (size_t i = 0; i < arg_count; i++) {
+    node->call.arguments[node->call.arg_count++] =
+        compile_expression(expr->function_call.arguments[i], failed);
+  }
+  return node;
+}
+
+// ========================================================================
+
+static inline struct obj_t *int_result(int value) {
+  return gc_int(value);
+}
+
+static inline struct obj_t *bool_result(bool value) {
+  return value ? gc_alloc(OBJECT_BOOL_TRUE) : gc_alloc(OBJECT_BOOL_FALSE);
+}
+
+// clang-format off
+
+/**
+ * evaluate node with *live as a root of the gc, for the left operand while
+ * the right one is evaluated
+ */
+static inline struct obj_t *eval_keeping(struct cnode *node,
+                                         struct environment *env,
+                                         struct obj_t **live) {
+  gc_push_root(live);
+  struct obj_t *value = node->eval(node, env);
+  gc_pop_roots(1);
+  return value;
+}
+
+/**
+ * operands of a binary node are either a node, an identifier that is looked
+ * up directly, or (on the right) an int literal that is used as is
+ */
+#define LEFT_NODE node->binary.left->eval(node->binary.left, env)
+#define LEFT_NAME evaluate_identifier_expr(env, node->binary.left_name, node->token)
+#define RIGHT_NODE eval_keeping(node->binary.right, env, &left)
+#define RIGHT_NAME evaluate_identifier_expr(env, node->binary.right_name, node->token)
+
+/**
+ * int (op) int is computed inline from a and b, everything else goes
+ * through the operator semantics of the tree walker
+ */
+#define DEFINE_BINARY(fn, LEFT, RIGHT, result)                                 \
+  static struct obj_t *fn(struct cnode *node, struct environment *env) {       \
+    struct obj_t *left = LEFT;                                                 \
+    if (has_error(left)) {                                                     \
+      return left;                                                             \
+    }                                                                          \
+    struct obj_t *right = RIGHT;                                               \
+    if (has_error(right)) {                                                    \
+      return right;                                                            \
+    }                                                                          \
+    if (object_t_is_int(left) && object_t_is_int(right)) {                     \
+      int a = object_t_int(left);                                              \
+      int b = object_t_int(right);                                             \
+      return (result);                                                         \
+    }                                                                          \
+    return evaluate_infix_expr(node->token, left, right);                      \
+  }
+
+#define DEFINE_BINARY_INT(fn, LEFT, result)                                    \
+  static struct obj_t *fn(struct cnode *node, struct environment *env) {       \
+    struct obj_t *left = LEFT;                                                 \
+    if (has_error(left)) {                                                     \
+      return left;                                                             \
+    }                                                                          \
+    int b = node->binary.right_int;                                            \
+    if (object_t_is_int(left)) {                                               \
+      int a = object_t_int(left);                                              \
+      return (result);                                                         \
+    }                                                                          \
+    return evaluate_infix_expr(node->token, left, int_result(b));              \
+  }
+
+/**
+ * all the operand shapes of an operator, indexed by [left][right] with
+ * left = node, name and right = node, name, int
+ */
+#define DEFINE_OPERATOR(op, result)                                            \
+  DEFINE_BINARY(eval_##op##_node_node, LEFT_NODE, RIGHT_NODE, result)          \
+  DEFINE_BINARY(eval_##op##_node_name, LEFT_NODE, RIGHT_NAME, result)          \
+  DEFINE_BINARY_INT(eval_##op##_node_int, LEFT_NODE, result)                   \
+  DEFINE_BINARY(eval_##op##_name_node, LEFT_NAME, RIGHT_NODE, result)          \
+  DEFINE_BINARY(eval_##op##_name_name, LEFT_NAME, RIGHT_NAME, result)          \
+  DEFINE_BINARY_INT(eval_##op##_name_int, LEFT_NAME, result)                   \
+  static const cnode_eval_fn op##_shapes[2][3] = {                             \
+      {eval_##op##_node_node, eval_##op##_node_name, eval_##op##_node_int},    \
+      {eval_##op##_name_node, eval_##op##_name_name, eval_##op##_name_int},    \
+  };
+
+DEFINE_OPERATOR(add, int_result(a + b))
+DEFINE_OPERATOR(sub, int_result(a - b))
+DEFINE_OPERATOR(mul, int_result(a * b))
+DEFINE_OPERATOR(lt, bool_result(a < b))
+DEFINE_OPERATOR(gt, bool_result(a > b))
+DEFINE_OPERATOR(lt_eq, bool_result(a <= b))
+DEFINE_OPERATOR(gt_eq, bool_result(a >= b))
+DEFINE_OPERATOR(eq_eq, bool_result(a == b))
+DEFINE_OPERATOR(not_eq, bool_result(a != b))
+
+// clang-format on
+
+/**
+ * pick the evaluation function from the operator and the shape of the
+ * operands, operators without a fast path evaluate both sides as nodes
+ */
+static struct cnode *compile_infix(struct expression *expr, bool *failed) {
+  struct token *op = expr->infix_expr.op;
+  const cnode_eval_fn(*shapes)[3] = NULL;
+  switch (op->type) {
+  case PLUS:
+    shapes = add_shapes;
+    break;
+  case MINUS:
+    shapes = sub_shapes;
+    break;
+  case ASTERISK:
+    shapes = mul_shapes;
+    break;
+  case LT:
+    shapes = lt_shapes;
+    break;
+  case GT:
+    shapes = gt_shapes;
+    break;
+  case LT_EQ:
+    shapes = lt_eq_shapes;
+    break;
+  case GT_EQ:
+    shapes = gt_eq_shapes;
+    break;
+  case EQ_EQ:
+    shapes = eq_eq_shapes;
+    break;
+  case NOT_EQ:
+    shapes = not_eq_shapes;
+    break;
+  default:
+    break;
+  }
+
+  struct cnode *node = cnode_init(CNODE_BINARY, eval_infix, op);
+  if (!node) {
+    return NULL;
+  }
+  struct expression *left = expr->infix_expr.left;
+  struct expression *right = expr->infix_expr.right;
+  if (!shapes) {
+    node->binary.left = compile_expression(left, failed);
+    node->binary.right = compile_expression(right, failed);
+    return node;
+  }
+
+  size_t left_shape = 0;
+  if (left && left->type == EXPR_IDENTIFIER) {
+    node->binary.left_name = left->identifier_expr.identifier;
+    left_shape = 1;
+  } else {
+    node->binary.left = compile_expression(left, failed);
+  }
+  size_t right_shape = 0;
+  if (right && right->type == EXPR_IDENTIFIER) {
+    node->binary.right_name = right->identifier_expr.identifier;
+    right_shape = 1;
+  } else if (right && right->type == EXPR_LITERAL &&
+             right->literal.literal_type == LITERAL_INT) {
+    node->binary.right_int = right->literal.value.int_value;
+    right_shape = 2;
+  } else {
+    node->binary.right = compile_expression(right, failed);
+  }
+  node->eval = shapes[left_shape][right_shape];
+  return node;
+}
+
+// ========================================================================
+
+static struct obj_t *eval_sentinel(struct cnode *node,
+                                   struct environment *env) {
+  (void)node;
+  (void)env;
+  return gc_alloc(OBJECT_SENTINEL);
+}
+
+static struct obj_t *eval_true(struct cnode *node, struct environment *env) {
+  (void)node;
+  (void)env;
+  return gc_alloc(OBJECT_BOOL_TRUE);
+}
+
+static struct obj_t *eval_false(struct cnode *node, struct environment *env) {
+  (void)node;
+  (void)env;
+  return gc_alloc(OBJECT_BOOL_FALSE);
+}
+
+/**
+ * literals evaluate to their value (literal_object_of), ++ and -- rebind a
+ * name bound to one instead of updating it in place
+ */
+static struct obj_t *eval_literal(struct cnode *node,
+                                  struct environment *env) {
+  (void)env;
+  struct obj_t *value = literal_object_of(node->literal);
+  return value ? value : gc_alloc(OBJECT_SENTINEL);
+}
+
+static struct obj_t *eval_name(struct cnode *node, struct environment *env) {
+  return evaluate_identifier_expr(env, node->name, node->token);
+}
+
+static struct obj_t *eval_not(struct cnode *node, struct environment *env) {
+  struct obj_t *right = node->unary.operand->eval(node->unary.operand, env);
+  if (has_error(right)) {
+    return right;
+  }
+  return evaluate_prefix_bang_operator_expr(node->token, right);
+}
+
+static struct obj_t *eval_negate(struct cnode *node, struct environment *env) {
+  struct obj_t *right = node->unary.operand->eval(node->unary.operand, env);
+  if (has_error(right)) {
+    return right;
+  }
+  return evaluate_prefix_minus_operator_expr(node->token, right);
+}
+
+static struct obj_t *eval_prefix(struct cnode *node, struct environment *env) {
+  return evaluate_prefix_expr(env, node->token, node->expr->prefix_expr.right);
+}
+
+static struct obj_t *eval_postfix(struct cnode *node,
+                                  struct environment *env) {
+  return evaluate_postfix_expr(env, node->token, node->expr->postfix_expr.left);
+}
+
+static struct obj_t *eval_infix(struct cnode *node, struct environment *env) {
+  struct obj_t *left = LEFT_NODE;
+  if (has_error(left)) {
+    return left;
+  }
+  struct obj_t *right = RIGHT_NODE;
+  if (has_error(right)) {
+    return right;
+  }
+  return evaluate_infix_expr(node->token, left, right);
+}
+
+static struct obj_t *eval_if(struct cnode *node, struct environment *env) {
+  struct cnode *condition = node->conditional.condition;
+  struct obj_t *value = condition->eval(condition, env);
+  if (has_error(value)) {
+    return value;
+  }
+  struct cnode *branch = is_truthy(value) ? node->conditional.consequence
+                                          : node->conditional.alternative;
+  if (!branch) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  return branch->eval(branch, env);
+}
+
+/**
+ * the body runs in env, see evaluate_loop_expression in evaluator.c
+ */
+static struct obj_t *eval_loop(struct cnode *node, struct environment *env) {
+  struct cnode *init = node->loop.init;
+  if (init) {
+    struct obj_t *value = init->eval(init, env);
+    if (value && (object_t_type(value) == OBJECT_RETURN ||
+                  object_t_type(value) == OBJECT_ERROR)) {
+      return value;
+    }
+  }
+  struct cnode *condition = node->loop.condition;
+  struct cnode *body = node->loop.body;
+  struct cnode *update = node->loop.update;
+  for (;;) {
+    gc_safe_point();
+    if (condition) {
+      struct obj_t *value = condition->eval(condition, env);
+      if (has_error(value)) {
+        return value;
+      }
+      if (!is_truthy(value)) {
+        break;
+      }
+    }
+    struct obj_t *value = body->eval(body, env);
+    if (value && (object_t_type(value) == OBJECT_RETURN ||
+                  object_t_type(value) == OBJECT_ERROR)) {
+      return value;
+    }
+    if (update) {
+      value = update->eval(update, env);
+      if (has_error(value)) {
+        return value;
+      }
+    }
+  }
+  return gc_alloc(OBJECT_SENTINEL);
+}
+
+/**
+ * a block evaluates to its last statement, a return value or an error stops
+ * it early (the return is unwrapped by the function call)
+ */
+static struct obj_t *eval_block(struct cnode *node, struct environment *env) {
+  struct obj_t *result = gc_alloc(OBJECT_SENTINEL);
+  for (size_t i = 0; i < node->block.count; i++) {
+    struct cnode *stmt = node->block.statements[i];
+    gc_safe_point();
+    result = stmt->eval(stmt, env);
+    if (result && (object_t_type(result) == OBJECT_RETURN ||
+                  object_t_type(result) == OBJECT_ERROR)) {
+      return result;
+    }
+  }
+  return result;
+}
+
+static struct obj_t *eval_let(struct cnode *node, struct environment *env) {
+  struct obj_t *value = node->let.value->eval(node->let.value, env);
+  if (has_error(value) || object_t_type(value) == OBJECT_RETURN) {
+    return value; // a return in the value does not bind the marker
+  }
+  env_define(env, node->let.name, value);
+  return value;
+}
+
+/**
+ * like in the tree walker a return evaluates to a marker holding the value,
+ * the caller takes the value out before anything else is evaluated
+ */
+static struct obj_t return_marker = {
+    .type = OBJECT_RETURN, .gc_next = NULL, .immortal = true};
+
+static struct obj_t *eval_return(struct cnode *node, struct environment *env) {
+  struct obj_t *value = node->unary.operand->eval(node->unary.operand, env);
+  if (has_error(value)) {
+    return value;
+  }
+  return_marker.return_value.value = value;
+  return &return_marker;
+}
+
+static struct obj_t *eval_function(struct cnode *node,
+                                   struct environment *env) {
+  struct function_literal *literal = node->function.literal;
+  struct obj_t *obj = gc_alloc(OBJECT_FUNCTION);
+  if (!obj) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  struct function_proto *proto = function_proto_of(literal);
+  if (!proto) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  if (!proto->cnode) {
+    proto->cnode = node->function.body;
+  }
+  obj->function_value.env = env;
+  obj->function_value.proto = proto;
+  return obj;
+}
+
+static struct obj_t *eval_call(struct cnode *node, struct environment *env) {
+  struct obj_t *function = node->call.callee->eval(node->call.callee, env);
+  if (has_error(function)) {
+    return function;
+  }
+  return call_function(node, env, function);
+}
+
+static struct obj_t *eval_call_name(struct cnode *node,
+                                    struct environment *env) {
+  struct obj_t *function =
+      evaluate_identifier_expr(env, node->call.callee_name, node->token);
+  if (has_error(function)) {
+    return function;
+  }
+  return call_function(node, env, function);
+}
+
+static struct obj_t *call_function(struct cnode *node, struct environment *env,
+                                   struct obj_t *function) {
+  if (object_t_type(function) != OBJECT_FUNCTION) {
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, node->token, "invalid function call",
+                       "only functions can be called");
+    return err;
+  }
+  struct function_proto *proto = function->function_value.proto;
+  struct cnode *body = proto->cnode;
+  if (!body) {
+    // created by another engine, compile it the first time it is called
+    body = cnode_compile_block(proto->body);
+    if (!body) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+    proto->cnode = body;
+  }
+  size_t arg_count = node->call.arg_count;
+  size_t param_count = proto->param_count;
+  if (arg_count < param_count) {
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, node->token, "invalid function call",
+                       "not enough arguments for the function parameters");
+    return err;
+  }
+
+  struct obj_t *inline_args[CNODE_INLINE_ARGS];
+  struct obj_t **args = inline_args;
+  if (arg_count > CNODE_INLINE_ARGS) {
+    args = malloc(sizeof(struct obj_t *) * arg_count);
+    if (!args) {
+      ERROR_LOG("error while allocating memory\n");
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+  }
+  for (size_t i = 0; i < arg_count; i++) {
+    args[i] = NULL;
+  }
+  // the callee and the arguments are roots until they are bound
+  gc_push_root(&function);
+  gc_push_roots(args, arg_count);
+  for (size_t i = 0; i < arg_count; i++) {
+    struct cnode *arg = node->call.arguments[i];
+    args[i] = arg->eval(arg, env);
+    if (has_error(args[i])) {
+      struct obj_t *err = args[i];
+      gc_pop_roots(2);
+      if (args != inline_args) {
+        free(args);
+      }
+      return err;
+    }
+  }
+  gc_pop_roots(2);
+
+  struct obj_t *native = NULL;
+  if (jit_try_call(function, args, arg_count, &native)) {
+    if (args != inline_args) {
+      free(args);
+    }
+    return native;
+  }
+
+  struct environment *child = env_push_call(proto->scope, proto->captured);
+  if (child) {
+    child->parent = function->function_value.env;
+    for (size_t i = 0; i < param_count; i++) {
+      env_define(child, proto->parameters[i]->id, args[i]);
+    }
+  }
+  if (args != inline_args) {
+    free(args);
+  }
+  if (!child) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+
+  gc_push_env_root(child);
+  struct obj_t *result = body->eval(body, child);
+  gc_pop_roots(1);
+  env_release_call(child, proto->captured);
+  if (result && object_t_type(result) == OBJECT_RETURN) {
+    return result->return_value.value;
+  }
+  return result;
+}
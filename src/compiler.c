@@ -0,0 +1,770 @@
+#include "compiler.h"
+#include "ast.h"
+#include "object_t.h"
+#include "token.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CHUNK_CAPACITY 16
+
+/**
+ * compiler keeps the state needed while lowering a single function body
+ */
+struct compiler {
+  struct chunk *chunk;
+  char *locals[CHUNK_MAX_SLOTS]; // names of the local slots, borrowed
+  size_t local_count;
+  size_t depth; // current depth of the operand stack
+  bool failed;  // set when the body cannot be represented in bytecode
+};
+
+// clang-format off
+
+static struct chunk *chunk_init();
+static bool grow_array(void **items, size_t *capacity, size_t count, size_t item_size);
+
+static void emit_byte(struct compiler *, uint8_t);
+static void emit_u16(struct compiler *, size_t);
+static void emit_op(struct compiler *, enum OPCODE, int stack_effect);
+static size_t emit_jump(struct compiler *, enum OPCODE);
+static void patch_jump(struct compiler *, size_t operand);
+static void emit_loop(struct compiler *, size_t start);
+
+static size_t add_constant(struct compiler *, struct obj_t *);
+static size_t add_name(struct compiler *, const char *);
+static size_t add_token(struct compiler *, struct token *);
+static size_t add_function(struct compiler *, struct chunk *);
+
+static int resolve_local(struct compiler *, const char *);
+static int add_local(struct compiler *, char *);
+
+static bool needs_environment(size_t param_count, struct block_statement *);
+static bool block_creates_function(struct block_statement *, size_t *let_count);
+static bool statement_creates_function(struct statement *, size_t *let_count);
+static bool expression_creates_function(struct expression *);
+
+static void compile_block(struct compiler *, struct block_statement *);
+static void compile_statement(struct compiler *, struct statement *);
+static void compile_expression(struct compiler *, struct expression *);
+static void compile_literal(struct compiler *, struct literal *);
+static void compile_get(struct compiler *, char *, struct token *);
+static void compile_set(struct compiler *, char *);
+static void compile_step(struct compiler *, struct token *, struct expression *);
+static void compile_infix(struct compiler *, struct expression *);
+static void compile_conditional(struct compiler *, struct expression *);
+static void compile_loop(struct compiler *, struct expression *);
+static void declare_block_locals(struct compiler *, struct block_statement *);
+static void declare_statement_locals(struct compiler *, struct statement *);
+static void declare_expression_locals(struct compiler *, struct expression *);
+static void compile_call(struct compiler *, struct expression *);
+
+// clang-format on
+
+struct chunk *compiler_compile_program(struct program *program) {
+  struct chunk *chunk = chunk_init();
+  if (!chunk) {
+    return NULL;
+  }
+  // top level names always live in the environment the program runs in
+  chunk->uses_env = true;
+
+  struct compiler c = {.chunk = chunk, .local_count = 0, .depth = 0};
+  if (program->statement_count == 0) {
+    emit_op(&c, OP_SENTINEL, 1);
+  }
+  for (size_t i = 0; i < program->statement_count; i++) {
+    if (i > 0) {
+      emit_op(&c, OP_POP, -1);
+    }
+    compile_statement(&c, program->statements[i]);
+  }
+  emit_op(&c, OP_RETURN, -1);
+
+  if (c.failed) {
+    chunk_free(chunk);
+    return NULL;
+  }
+  return chunk;
+}
+
+struct chunk *compiler_compile_function(struct identifier **parameters,
+                                        size_t param_count,
+                                        size_t param_capacity,
+                                        struct block_statement *body) {
+  struct chunk *chunk = chunk_init();
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->parameters = parameters;
+  chunk->param_count = param_count;
+  chunk->param_capacity = param_capacity;
+  chunk->body = body;
+  chunk->uses_env = needs_environment(param_count, body);
+
+  struct compiler c = {.chunk = chunk, .local_count = 0, .depth = 0};
+  if (!chunk->uses_env) {
+    // arguments are pushed in order, so parameter i lives in slot i
+    for (size_t i = 0; i < param_count; i++) {
+      c.locals[c.local_count++] = parameters[i]->id;
+    }
+  }
+  compile_block(&c, body);
+  emit_op(&c, OP_RETURN, -1);
+  chunk->slot_count = c.local_count;
+
+  if (c.failed) {
+    chunk_free(chunk);
+    return NULL;
+  }
+  return chunk;
+}
+
+void chunk_free(struct chunk *chunk) {
+  if (chunk) {
+    free(chunk->code);
+    /**
+     * NOTE: constants are pushed as is and can end up bound in the
+     * environment or returned as the value of the program, so the objects
+     * themselves are immortal and only the pool is released
+     */
+    free(chunk->constants);
+    for (size_t i = 0; i < chunk->name_count; i++) {
+      free(chunk->names[i]);
+    }
+    free(chunk->names);
+    free(chunk->tokens);
+    /**
+     * NOTE: the nested chunks are referenced by the function objects that
+     * were created from them, those can outlive this chunk (e.g. a function
+     * stored in the global environment) so they are not released here, the
+     * same way the ast of function bodies is kept alive (see ast.c)
+     */
+    free(chunk->functions);
+    free(chunk);
+  }
+  chunk = NULL;
+}
+
+static struct chunk *chunk_init() {
+  struct chunk *chunk = calloc(1, sizeof(struct chunk));
+  if (!chunk) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  return chunk;
+}
+
+/**
+ * make room for one more item in a growable array
+ */
+static bool grow_array(void **items, size_t *capacity, size_t count,
+                       size_t item_size) {
+  if (count < *capacity) {
+    return true;
+  }
+  size_t new_capacity = *capacity ? *capacity * 2 : INITIAL_CHUNK_CAPACITY;
+  void *new_items = realloc(*items, new_capacity * item_size);
+  if (!new_items) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  *items = new_items;
+  *capacity = new_capacity;
+  return true;
+}
+
+// ========================================================================
+
+static void emit_byte(struct compiler *c, uint8_t byte) {
+  struct chunk *chunk = c->chunk;
+  if (!grow_array((void **)&chunk->code, &chunk->capacity, chunk->count,
+                  sizeof(uint8_t))) {
+    c->failed = true;
+    return;
+  }
+  chunk->code[chunk->count++] = byte;
+}
+
+static void emit_u16(struct compiler *c, size_t value) {
+  if (value > UINT16_MAX) {
+    c->failed = true;
+    return;
+  }
+  emit_byte(c, value & 0xff);
+  emit_byte(c, (value >> 8) & 0xff);
+}
+
+/**
+ * emit an opcode and track how it changes the depth of the operand stack,
+ * the deepest point is what the vm reserves when entering the chunk
+ */
+static void emit_op(struct compiler *c, enum OPCODE op, int stack_effect) {
+  emit_byte(c, op);
+  c->depth += stack_effect;
+  if (c->depth > c->chunk->max_stack) {
+    c->chunk->max_stack = c->depth;
+  }
+}
+
+static size_t emit_jump(struct compiler *c, enum OPCODE op) {
+  emit_op(c, op, op == OP_JUMP_IF_FALSE ? -1 : 0);
+  emit_byte(c, 0xff);
+  emit_byte(c, 0xff);
+  return c->chunk->count - 2;
+}
+
+/**
+ * point a forward jump at the current end of the chunk
+ */
+static void patch_jump(struct compiler *c, size_t operand) {
+  if (c->failed) {
+    return;
+  }
+  size_t offset = c->chunk->count - (operand + 2);
+  if (offset > UINT16_MAX) {
+    c->failed = true;
+    return;
+  }
+  c->chunk->code[operand] = offset & 0xff;
+  c->chunk->code[operand + 1] = (offset >> 8) & 0xff;
+}
+
+/**
+ * jump back to start, the offset is counted from the end of the operand
+ */
+static void emit_loop(struct compiler *c, size_t start) {
+  emit_op(c, OP_LOOP, 0);
+  size_t offset = c->chunk->count + 2 - start;
+  if (offset > UINT16_MAX) {
+    c->failed = true;
+    return;
+  }
+  emit_u16(c, offset);
+}
+
+static size_t add_constant(struct compiler *c, struct obj_t *value) {
+  struct chunk *chunk = c->chunk;
+  if (!value || !grow_array((void **)&chunk->constants,
+                            &chunk->constant_capacity, chunk->constant_count,
+                            sizeof(struct obj_t *))) {
+    object_t_free(value);
+    c->failed = true;
+    return 0;
+  }
+  chunk->constants[chunk->constant_count] = value;
+  return chunk->constant_count++;
+}
+
+static size_t add_name(struct compiler *c, const char *name) {
+  struct chunk *chunk = c->chunk;
+  for (size_t i = 0; i < chunk->name_count; i++) {
+    if (strcmp(chunk->names[i], name) == 0) {
+      return i;
+    }
+  }
+  if (!grow_array((void **)&chunk->names, &chunk->name_capacity,
+                  chunk->name_count, sizeof(char *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->names[chunk->name_count] = strdup(name);
+  return chunk->name_count++;
+}
+
+static size_t add_token(struct compiler *c, struct token *token) {
+  struct chunk *chunk = c->chunk;
+  if (!grow_array((void **)&chunk->tokens, &chunk->token_capacity,
+                  chunk->token_count, sizeof(struct token *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->tokens[chunk->token_count] = token;
+  return chunk->token_count++;
+}
+
+static size_t add_function(struct compiler *c, struct chunk *function) {
+  struct chunk *chunk = c->chunk;
+  if (!function || !grow_array((void **)&chunk->functions,
+                               &chunk->function_capacity,
+                               chunk->function_count, sizeof(struct chunk *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->functions[chunk->function_count] = function;
+  return chunk->function_count++;
+}
+
+static int resolve_local(struct compiler *c, const char *name) {
+  if (c->chunk->uses_env) {
+    return -1;
+  }
+  for (size_t i = 0; i < c->local_count; i++) {
+    if (strcmp(c->locals[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int add_local(struct compiler *c, char *name) {
+  int slot = resolve_local(c, name);
+  if (slot >= 0) {
+    return slot;
+  }
+  if (c->local_count >= CHUNK_MAX_SLOTS) {
+    c->failed = true;
+    return 0;
+  }
+  c->locals[c->local_count] = name;
+  return c->local_count++;
+}
+
+// ========================================================================
+
+bool compiler_block_creates_function(struct block_statement *block) {
+  size_t let_count = 0;
+  return block_creates_function(block, &let_count);
+}
+
+/**
+ * a function needs a heap environment when a nested fn literal could capture
+ * its scope, or when it has more variables than there are slots
+ */
+static bool needs_environment(size_t param_count,
+                              struct block_statement *body) {
+  size_t let_count = 0;
+  if (block_creates_function(body, &let_count)) {
+    return true;
+  }
+  return param_count + let_count > CHUNK_MAX_SLOTS;
+}
+
+static bool block_creates_function(struct block_statement *block,
+                                   size_t *let_count) {
+  if (block) {
+    for (size_t i = 0; i < block->statement_count; i++) {
+      if (statement_creates_function(block->statements[i], let_count)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool statement_creates_function(struct statement *stmt,
+                                       size_t *let_count) {
+  if (!stmt) {
+    return false;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    (*let_count)++;
+    return expression_creates_function(stmt->let_stmt.value);
+  };
+  case STMT_RETURN: {
+    return expression_creates_function(stmt->return_stmt.value);
+  };
+  case STMT_EXPRESSION: {
+    return expression_creates_function(stmt->expr_stmt.expr);
+  };
+  case STMT_FUNCTION_DEF: {
+    return false;
+  };
+  }
+  return false;
+}
+
+static bool expression_creates_function(struct expression *expr) {
+  if (!expr) {
+    return false;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+    return false;
+  case EXPR_PREFIX:
+    return expression_creates_function(expr->prefix_expr.right);
+  case EXPR_INFIX:
+    return expression_creates_function(expr->infix_expr.left) ||
+           expression_creates_function(expr->infix_expr.right);
+  case EXPR_POSTFIX:
+    return expression_creates_function(expr->postfix_expr.left);
+  case EXPR_CONDITIONAL: {
+    size_t let_count = 0;
+    return expression_creates_function(expr->conditional.condition) ||
+           block_creates_function(expr->conditional.consequence,
+                                  &let_count) ||
+           block_creates_function(expr->conditional.alternative, &let_count);
+  };
+  case EXPR_LOOP: {
+    size_t let_count = 0;
+    return statement_creates_function(expr->loop.init, &let_count) ||
+           expression_creates_function(expr->loop.condition) ||
+           expression_creates_function(expr->loop.update) ||
+           block_creates_function(expr->loop.body, &let_count);
+  };
+  case EXPR_FUNCTION:
+    return true;
+  case EXPR_FUNCTION_CALL: {
+    if (expression_creates_function(expr->function_call.function)) {
+      return true;
+    }
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      if (expression_creates_function(expr->function_call.arguments[i])) {
+        return true;
+      }
+    }
+    return false;
+  };
+  }
+  return false;
+}
+
+// ========================================================================
+
+/**
+ * a block leaves the value of its last statement on the stack, an empty
+ * block evaluates to the sentinel value
+ */
+static void compile_block(struct compiler *c, struct block_statement *block) {
+  if (!block || block->statement_count == 0) {
+    emit_op(c, OP_SENTINEL, 1);
+    return;
+  }
+  for (size_t i = 0; i < block->statement_count; i++) {
+    if (i > 0) {
+      emit_op(c, OP_POP, -1);
+    }
+    compile_statement(c, block->statements[i]);
+  }
+}
+
+/**
+ * every statement leaves exactly one value on the stack
+ */
+static void compile_statement(struct compiler *c, struct statement *stmt) {
+  if (!stmt) {
+    emit_op(c, OP_SENTINEL, 1);
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    compile_expression(c, stmt->let_stmt.value);
+    if (c->chunk->uses_env) {
+      emit_op(c, OP_DEFINE_NAME, 0);
+      emit_u16(c, add_name(c, stmt->let_stmt.ident));
+    } else {
+      emit_op(c, OP_SET_LOCAL, 0);
+      emit_byte(c, add_local(c, stmt->let_stmt.ident));
+    }
+  }; break;
+  case STMT_RETURN: {
+    compile_expression(c, stmt->return_stmt.value);
+    emit_op(c, OP_RETURN, -1);
+    // keep the stack balanced for the (unreachable) statements that follow
+    emit_op(c, OP_SENTINEL, 1);
+  }; break;
+  case STMT_EXPRESSION: {
+    compile_expression(c, stmt->expr_stmt.expr);
+  }; break;
+  case STMT_FUNCTION_DEF: {
+    emit_op(c, OP_SENTINEL, 1);
+  }; break;
+  }
+}
+
+static void compile_expression(struct compiler *c, struct expression *expr) {
+  if (!expr) {
+    emit_op(c, OP_SENTINEL, 1);
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL: {
+    compile_literal(c, &expr->literal);
+  }; break;
+  case EXPR_IDENTIFIER: {
+    compile_get(c, expr->identifier_expr.identifier,
+                expr->identifier_expr.token);
+  }; break;
+  case EXPR_PREFIX: {
+    struct token *op = expr->prefix_expr.op;
+    switch (op->type) {
+    case BANG: {
+      compile_expression(c, expr->prefix_expr.right);
+      emit_op(c, OP_NOT, 0);
+      emit_u16(c, add_token(c, op));
+    }; break;
+    case MINUS: {
+      compile_expression(c, expr->prefix_expr.right);
+      emit_op(c, OP_NEGATE, 0);
+      emit_u16(c, add_token(c, op));
+    }; break;
+    case INC:
+    case DEC: {
+      compile_step(c, op, expr->prefix_expr.right);
+    }; break;
+    default: {
+      emit_op(c, OP_RAISE, 1);
+      emit_u16(c, add_token(c, op));
+      emit_byte(c, RAISE_UNKNOWN_PREFIX);
+    }; break;
+    }
+  }; break;
+  case EXPR_INFIX: {
+    compile_infix(c, expr);
+  }; break;
+  case EXPR_POSTFIX: {
+    compile_step(c, expr->postfix_expr.op, expr->postfix_expr.left);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    compile_conditional(c, expr);
+  }; break;
+  case EXPR_FUNCTION: {
+    struct chunk *function = compiler_compile_function(
+        expr->function.parameters, expr->function.param_count,
+        expr->function.param_capacity, expr->function.body);
+    emit_op(c, OP_CLOSURE, 1);
+    emit_u16(c, add_function(c, function));
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    compile_call(c, expr);
+  }; break;
+  case EXPR_LOOP: {
+    compile_loop(c, expr);
+  }; break;
+  }
+}
+
+static void compile_literal(struct compiler *c, struct literal *literal) {
+  if (literal->literal_type == LITERAL_BOOL) {
+    emit_op(c, literal->value.bool_value ? OP_TRUE : OP_FALSE, 1);
+    return;
+  }
+  emit_op(c, OP_CONSTANT, 1);
+  emit_u16(c, add_constant(c, literal_object_of(literal)));
+}
+
+static void compile_get(struct compiler *c, char *name, struct token *token) {
+  int slot = resolve_local(c, name);
+  if (slot >= 0) {
+    emit_op(c, OP_GET_LOCAL, 1);
+    emit_byte(c, slot);
+  } else {
+    emit_op(c, OP_GET_NAME, 1);
+  }
+  emit_u16(c, add_name(c, name));
+  emit_u16(c, add_token(c, token));
+}
+
+static void compile_set(struct compiler *c, char *name) {
+  int slot = resolve_local(c, name);
+  if (slot >= 0) {
+    emit_op(c, OP_SET_LOCAL, 0);
+    emit_byte(c, slot);
+  } else {
+    emit_op(c, OP_SET_NAME, 0);
+    emit_u16(c, add_name(c, name));
+  }
+}
+
+/**
+ * ++ and -- evaluate to the value the variable held before the update
+ */
+static void compile_step(struct compiler *c, struct token *op,
+                         struct expression *target) {
+  if (!target || target->type != EXPR_IDENTIFIER) {
+    emit_op(c, OP_RAISE, 1);
+    emit_u16(c, add_token(c, op));
+    emit_byte(c, RAISE_NON_IDENTIFIER);
+    return;
+  }
+  char *name = target->identifier_expr.identifier;
+  compile_get(c, name, op);
+  emit_op(c, OP_DUP, 1);
+  emit_op(c, op->type == INC ? OP_INC : OP_DEC, 0);
+  emit_u16(c, add_token(c, op));
+  compile_set(c, name);
+  emit_op(c, OP_POP, -1);
+}
+
+static void compile_infix(struct compiler *c, struct expression *expr) {
+  compile_expression(c, expr->infix_expr.left);
+  compile_expression(c, expr->infix_expr.right);
+
+  struct token *op = expr->infix_expr.op;
+  enum OPCODE opcode;
+  switch (op->type) {
+  case PLUS:
+    opcode = OP_ADD;
+    break;
+  case MINUS:
+    opcode = OP_SUB;
+    break;
+  case ASTERISK:
+    opcode = OP_MUL;
+    break;
+  case LT:
+    opcode = OP_LT;
+    break;
+  case GT:
+    opcode = OP_GT;
+    break;
+  case LT_EQ:
+    opcode = OP_LT_EQ;
+    break;
+  case GT_EQ:
+    opcode = OP_GT_EQ;
+    break;
+  case EQ_EQ:
+    opcode = OP_EQ_EQ;
+    break;
+  case NOT_EQ:
+    opcode = OP_NOT_EQ;
+    break;
+  default:
+    opcode = OP_INFIX;
+    break;
+  }
+  emit_op(c, opcode, -1);
+  emit_u16(c, add_token(c, op));
+}
+
+static void compile_conditional(struct compiler *c, struct expression *expr) {
+  compile_expression(c, expr->conditional.condition);
+  size_t else_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+  compile_block(c, expr->conditional.consequence);
+  size_t end_jump = emit_jump(c, OP_JUMP);
+  // only one of the branches leaves its value on the stack
+  c->depth--;
+  patch_jump(c, else_jump);
+  if (expr->conditional.alternative) {
+    compile_block(c, expr->conditional.alternative);
+  } else {
+    emit_op(c, OP_SENTINEL, 1);
+  }
+  patch_jump(c, end_jump);
+}
+
+/**
+ * the values of the init, the body and the update are dropped every time,
+ * the loop itself evaluates to the sentinel value
+ */
+static void compile_loop(struct compiler *c, struct expression *expr) {
+  if (expr->loop.init) {
+    compile_statement(c, expr->loop.init);
+    emit_op(c, OP_POP, -1);
+  }
+  if (!c->chunk->uses_env) {
+    // a read that comes before a let in the body sees that let from the
+    // previous iteration, so it has to resolve to the slot already
+    declare_expression_locals(c, expr->loop.condition);
+    declare_block_locals(c, expr->loop.body);
+    declare_expression_locals(c, expr->loop.update);
+  }
+  size_t start = c->chunk->count;
+  size_t exit_jump = 0;
+  if (expr->loop.condition) {
+    compile_expression(c, expr->loop.condition);
+    exit_jump = emit_jump(c, OP_JUMP_IF_FALSE);
+  }
+  compile_block(c, expr->loop.body);
+  emit_op(c, OP_POP, -1);
+  if (expr->loop.update) {
+    compile_expression(c, expr->loop.update);
+    emit_op(c, OP_POP, -1);
+  }
+  emit_loop(c, start);
+  if (expr->loop.condition) {
+    patch_jump(c, exit_jump);
+  }
+  emit_op(c, OP_SENTINEL, 1);
+}
+
+static void declare_block_locals(struct compiler *c,
+                                 struct block_statement *block) {
+  if (block) {
+    for (size_t i = 0; i < block->statement_count; i++) {
+      declare_statement_locals(c, block->statements[i]);
+    }
+  }
+}
+
+static void declare_statement_locals(struct compiler *c,
+                                     struct statement *stmt) {
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    declare_expression_locals(c, stmt->let_stmt.value);
+    add_local(c, stmt->let_stmt.ident);
+  }; break;
+  case STMT_RETURN: {
+    declare_expression_locals(c, stmt->return_stmt.value);
+  }; break;
+  case STMT_EXPRESSION: {
+    declare_expression_locals(c, stmt->expr_stmt.expr);
+  }; break;
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+}
+
+static void declare_expression_locals(struct compiler *c,
+                                      struct expression *expr) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+  case EXPR_FUNCTION:
+    break;
+  case EXPR_PREFIX: {
+    declare_expression_locals(c, expr->prefix_expr.right);
+  }; break;
+  case EXPR_INFIX: {
+    declare_expression_locals(c, expr->infix_expr.left);
+    declare_expression_locals(c, expr->infix_expr.right);
+  }; break;
+  case EXPR_POSTFIX: {
+    declare_expression_locals(c, expr->postfix_expr.left);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    declare_expression_locals(c, expr->conditional.condition);
+    declare_block_locals(c, expr->conditional.consequence);
+    declare_block_locals(c, expr->conditional.alternative);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    declare_expression_locals(c, expr->function_call.function);
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      declare_expression_locals(c, expr->function_call.arguments[i]);
+    }
+  }; break;
+  case EXPR_LOOP: {
+    declare_statement_locals(c, expr->loop.init);
+    declare_expression_locals(c, expr->loop.condition);
+    declare_block_locals(c, expr->loop.body);
+    declare_expression_locals(c, expr->loop.update);
+  }; break;
+  }
+}
+
+static void compile_call(struct compiler *c, struct expression *expr) {
+  size_t arg_count = expr->function_call.arg_count;
+  if (arg_count > UINT8_MAX) {
+    c->failed = true;
+    return;
+  }
+  compile_expression(c, expr->function_call.function);
+  for (size_t i = 0; i < arg_count; i++) {
+    compile_expression(c, expr->function_call.arguments[i]);
+  }
+  emit_op(c, OP_CALL, -(int)arg_count);
+  emit_byte(c, arg_count);
+  emit_u16(c, add_token(c, expr->function_call.token));
+}
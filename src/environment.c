@@ -1,41 +1,187 @@
 #include "environment.h"
+#include "gc.h"
 #include "kv.h"
 #include "util_error.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static int env_slot(environment *env, const char *name);
+static bool env_ensure_symbols(environment *env);
+
+/**
+ * frames are bump allocated in chunks that never move (frames point at each
+ * other), a chunk that was emptied is kept for the next push
+ */
+struct frame_chunk {
+  struct frame_chunk *prev;
+  struct frame_chunk *next;
+  size_t size;
+  size_t top;
+  void *data[];
+};
+
+static struct frame_chunk *frame_chunk = NULL;
+
+size_t env_shape = 0;
 
 environment *env_init() {
+  environment *env = env_init_scope(NULL);
+  if (env && !env_ensure_symbols(env)) {
+    free(env);
+    return NULL;
+  }
+  return env;
+}
+
+environment *env_init_scope(const struct scope *scope) {
   environment *env = malloc(sizeof(environment));
   if (!env) {
     return NULL;
   }
-  struct hash_table *table = hash_table_init();
-  if (!table) {
-    ERROR_LOG("error while allocating memory\n");
-    free(env);
-    return NULL;
+  env->parent = NULL;
+  env->symbols = NULL;
+  env->scope = scope;
+  env->slots = NULL;
+  env->remembered = 0;
+  if (scope && scope->count > 0) {
+    env->slots = calloc(scope->count, sizeof(struct obj_t *));
+    if (!env->slots) {
+      ERROR_LOG("error while allocating memory\n");
+      free(env);
+      return NULL;
+    }
+  }
+  return env;
+}
+
+environment *env_push_frame(const struct scope *scope) {
+  size_t size = sizeof(environment) + sizeof(struct obj_t *) * scope->count;
+  struct frame_chunk *chunk = frame_chunk;
+  if (!chunk || chunk->size - chunk->top < size) {
+    if (chunk && chunk->next && chunk->next->size >= size) {
+      chunk = chunk->next;
+    } else {
+      size_t chunk_size =
+          size > ENV_FRAME_CHUNK_SIZE ? size : ENV_FRAME_CHUNK_SIZE;
+      struct frame_chunk *fresh =
+          malloc(sizeof(struct frame_chunk) + chunk_size);
+      if (!fresh) {
+        ERROR_LOG("error while allocating memory\n");
+        return NULL;
+      }
+      fresh->prev = chunk;
+      fresh->next = NULL;
+      fresh->size = chunk_size;
+      if (chunk) {
+        // the cached chunks after the current one are too small, drop them
+        for (struct frame_chunk *next = chunk->next; next;) {
+          struct frame_chunk *after = next->next;
+          free(next);
+          next = after;
+        }
+        chunk->next = fresh;
+      }
+      chunk = fresh;
+    }
+    chunk->top = 0;
+    frame_chunk = chunk;
   }
+  environment *env = (environment *)((char *)chunk->data + chunk->top);
+  chunk->top += size;
   env->parent = NULL;
-  env->symbols = table;
+  env->symbols = NULL;
+  env->scope = scope;
+  env->slots = (struct obj_t **)(env + 1);
+  env->remembered = 0;
+  memset(env->slots, 0, sizeof(struct obj_t *) * scope->count);
   return env;
 }
 
+void env_pop_frame(environment *env) {
+  if (env->remembered) {
+    gc_forget_environment(env);
+  }
+  if (env->symbols) {
+    hash_table_free(env->symbols);
+    env_shape++;
+  }
+  frame_chunk->top = (char *)env - (char *)frame_chunk->data;
+  if (frame_chunk->top == 0 && frame_chunk->prev) {
+    frame_chunk = frame_chunk->prev;
+  }
+}
+
+environment *env_push_call(const struct scope *scope, bool captured) {
+  if (scope && !captured) {
+    return env_push_frame(scope);
+  }
+  return scope ? env_init_scope(scope) : env_init();
+}
+
+void env_release_call(environment *env, bool captured) {
+  if (captured) {
+    return;
+  }
+  if (env->scope) {
+    env_pop_frame(env); // a scoped call that is not captured is a frame
+  } else {
+    env_free(env);
+  }
+}
+
 void env_free(environment *env) {
   if (env) {
-    hash_table_free(env->symbols);
+    if (env->remembered) {
+      gc_forget_environment(env);
+    }
+    if (env->symbols) {
+      hash_table_free(env->symbols);
+      env_shape++;
+    }
+    free(env->slots);
     free(env);
   }
   env = NULL;
 }
 
+void env_clear(environment *env) {
+  if (env) {
+    if (env->symbols && env->symbols->size > 0) {
+      hash_table_clear(env->symbols);
+      env_shape++;
+    }
+    if (env->slots) {
+      memset(env->slots, 0, sizeof(struct obj_t *) * env->scope->count);
+    }
+  }
+}
+
 void env_define(environment *env, const char *name, void *value) {
-  hash_table_insert(env->symbols, name, value);
+  gc_write_barrier(env, value);
+  int slot = env_slot(env, name);
+  if (slot >= 0) {
+    env->slots[slot] = value;
+  } else if (env_ensure_symbols(env)) {
+    size_t size = env->symbols->size;
+    hash_table_insert(env->symbols, name, value);
+    if (env->symbols->size != size) {
+      env_shape++;
+    }
+  }
 }
 
 void env_set(environment *env, const char *name, void *value) {
   environment *current = env;
   while (current) {
-    if (hash_table_has(current->symbols, name)) {
+    int slot = env_slot(current, name);
+    if (slot >= 0 && current->slots[slot]) {
+      gc_write_barrier(current, value);
+      current->slots[slot] = value;
+      return;
+    }
+    if (current->symbols && hash_table_has(current->symbols, name)) {
+      gc_write_barrier(current, value);
       hash_table_insert(current->symbols, name, value);
       return;
     }
@@ -46,9 +192,58 @@ void env_set(environment *env, const char *name, void *value) {
 }
 
 struct obj_t *env_look_up(environment *env, char *key) {
-  struct obj_t *value = hash_table_get(env->symbols, key);
+  struct obj_t *value = NULL;
+  int slot = env_slot(env, key);
+  if (slot >= 0) {
+    value = env->slots[slot];
+  } else if (env->symbols) {
+    value = hash_table_get(env->symbols, key);
+  }
   if (!value && env->parent) {
     return env_look_up(env->parent, key);
   }
   return value;
 }
+
+struct entry *env_look_up_entry(environment *env, char *key) {
+  for (; env; env = env->parent) {
+    int slot = env_slot(env, key);
+    if (slot >= 0 && env->slots[slot]) {
+      return NULL;
+    }
+    if (env->symbols) {
+      struct entry *entry = hash_table_get_entry(env->symbols, key);
+      if (entry) {
+        return entry;
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * index of name in the scope of env, names looked up by name (rather than
+ * by the slot the resolver picked) end up here. the search goes backwards
+ * like scope_find in resolver.c
+ */
+static int env_slot(environment *env, const char *name) {
+  if (env->scope) {
+    for (size_t i = env->scope->count; i > 0; i--) {
+      if (strcmp(env->scope->names[i - 1], name) == 0) {
+        return i - 1;
+      }
+    }
+  }
+  return -1;
+}
+
+static bool env_ensure_symbols(environment *env) {
+  if (!env->symbols) {
+    env->symbols = hash_table_init();
+    if (!env->symbols) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+  }
+  return true;
+}
@@ -1,11 +1,20 @@
 #include "evaluator.h"
 #include "ast.h"
+#include "cnode.h"
+#include "compiler.h"
 #include "environment.h"
 #include "error_t.h"
+#include "fuse.h"
 #include "gc.h"
+#include "jit.h"
 #include "object_t.h"
+#include "reg_vm.h"
+#include "resolver.h"
+#include "stack_eval.h"
 #include "token.h"
 #include "util_error.h"
+#include "vm.h"
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,22 +27,19 @@ struct obj_t *evaluate_statement(struct environment *, struct statement *);
 struct obj_t *evaluate_let_statement(struct environment *, struct statement *);
 struct obj_t *evaluate_return_statement(struct environment *, struct statement *);
 
-struct obj_t *evaluate_literal_expr(struct expression *);
-struct obj_t *evaluate_prefix_expr(struct environment *, struct token *, struct expression *);
-struct obj_t *evaluate_infix_expr(struct token *, struct obj_t *, struct obj_t *);
-struct obj_t *evaluate_postfix_expr(struct environment *, struct token *, struct expression *);
-
-struct obj_t *evaluate_identifier_expr(struct environment *, char *, struct token *);
-
-struct obj_t **evaluate_expressions(struct environment *, struct expression **, size_t);
 
 struct obj_t *evaluate_block_statements(struct environment *, struct block_statement *);
 struct obj_t *evaluate_if_expression(struct environment *, struct expression *);
-struct obj_t *evaluate_fn_expression(struct environment *, struct expression *);
+struct obj_t *evaluate_loop_expression(struct environment *, struct expression *);
 struct obj_t *evaluate_fn_call_expression(struct environment *, struct expression *);
+struct obj_t *evaluate_function_call(struct token *, struct obj_t *, struct obj_t **, size_t);
+struct obj_t *evaluate_call_operands(struct environment *, struct expression *, struct obj_t **function, struct obj_t **args);
+static inline void bind_arguments(struct environment *, struct obj_t **args, size_t count);
+static void release_call_env(struct environment *);
+struct obj_t *evaluate_tail_call(struct environment *, struct expression *);
+struct obj_t *evaluate_fused_infix(struct environment *, struct expression *);
+static struct obj_t *evaluate_program_on(struct environment *, struct program *);
 
-struct obj_t *evaluate_prefix_bang_operator_expr(struct token*, struct obj_t *);
-struct obj_t *evaluate_prefix_minus_operator_expr(struct token*, struct obj_t *);
 struct obj_t *evaluate_prefix_plus_operator_expr(struct token*, struct obj_t *);
 struct obj_t *evaluate_prefix_increment_operator_expr(struct environment *, struct token*, struct expression *);
 struct obj_t *evaluate_prefix_decrement_operator_expr(struct environment *, struct token*, struct expression *);
@@ -44,19 +50,176 @@ struct obj_t *evaluate_infix_float_expr(struct token *, struct obj_t *, struct o
 struct obj_t *evaluate_infix_char_expr(struct token *, struct obj_t *, struct obj_t *);
 struct obj_t *evaluate_infix_string_expr(struct token *, struct obj_t *, struct obj_t *);
 
+struct obj_t *evaluate_infix_quickened(struct expression *, struct obj_t *, struct obj_t *);
+static infix_quick_fn infix_quick_handler(enum TOKEN_TYPE, enum OBJECT_TYPE);
+static struct obj_t *evaluate_infix_temporary(struct expression *, struct obj_t *, struct obj_t *);
+
 struct obj_t *evaluate_postfix_integer_expr(struct token *, struct obj_t *);
+static struct obj_t *evaluate_step(struct environment *, struct expression *, struct token *, int delta);
 struct obj_t *evaluate_postfix_float_expr(struct token *, struct obj_t *);
 
-bool is_truthy(struct obj_t*);
-bool has_error(struct obj_t *);
-
 // clang-format on
 
+static enum EVAL_ENGINE active_engine = ENGINE_TREE_WALKER;
+
+/**
+ * tail calls: inside a function `return f(...)` does not call f, the callee
+ * and its arguments are stored in tail_call and the marker is returned up
+ * to evaluate_function_call, which runs the call in its loop instead of
+ * nesting another c frame. call_depth is 0 at the top level of a program,
+ * where a return ends the program
+ */
+static struct {
+  struct token *token;
+  struct obj_t *function;
+  struct obj_t *args[FUSED_CALL_MAX_ARGS];
+  size_t arg_count;
+} tail_call;
+
+static struct obj_t tail_call_marker = {
+    .type = OBJECT_RETURN, .gc_next = NULL, .immortal = true};
+
+/**
+ * what a return statement evaluates to, the value is stored in the marker
+ * instead of a new OBJECT_RETURN. nothing is evaluated while a return is
+ * on its way up to the call (or the program) that takes the value out, so
+ * one marker is enough
+ */
+static struct obj_t return_marker = {
+    .type = OBJECT_RETURN, .gc_next = NULL, .immortal = true};
+
+static size_t call_depth = 0;
+
+/**
+ * arguments of calls with more than CALL_INLINE_ARGS arguments, taken and
+ * given back in call order. it never moves, so the arguments of a call stay
+ * put while nested calls evaluate theirs. calls that do not fit anymore
+ * fall back to malloc
+ */
+static struct {
+  struct obj_t *values[ARG_STACK_SIZE];
+  size_t count;
+} arg_stack;
+
+/**
+ * identifier lookup, names the resolver bound to a slot are read from the
+ * environment depth levels up. when that environment is not a call of the
+ * resolved function or the slot was not set yet the name is looked up, the
+ * error path is the one of evaluate_identifier_expr
+ */
+static inline struct obj_t *evaluate_name(struct environment *env,
+                                          struct expression *ident) {
+  const struct scope *scope = ident->identifier_expr.scope;
+  if (scope) {
+    struct environment *target = env;
+    for (size_t i = 0; target && i < ident->identifier_expr.depth; i++) {
+      target = target->parent;
+    }
+    if (target && target->scope == scope &&
+        target->slots[ident->identifier_expr.slot]) {
+      return target->slots[ident->identifier_expr.slot];
+    }
+  }
+  struct obj_t *value = env_look_up(env, ident->identifier_expr.identifier);
+  return value ? value
+               : evaluate_identifier_expr(env, ident->identifier_expr.identifier,
+                                          ident->identifier_expr.token);
+}
+
+/**
+ * callee of a call site by a name the resolver left to be looked up by name,
+ * in practice a function bound in the global environment. the call site
+ * caches the hash table entry of the name, rebinding the name updates the
+ * entry in place and adding a binding that could shadow it (or removing
+ * one) changes env_shape
+ */
+static inline struct obj_t *evaluate_callee_name(struct environment *env,
+                                                 struct expression *call) {
+  if (call->function_call.cached_entry &&
+      call->function_call.cached_shape == env_shape) {
+    return call->function_call.cached_entry->value;
+  }
+  struct expression *callee = call->function_call.function;
+  struct entry *entry =
+      env_look_up_entry(env, callee->identifier_expr.identifier);
+  call->function_call.cached_entry = entry;
+  call->function_call.cached_shape = env_shape;
+  return entry ? entry->value : evaluate_name(env, callee);
+}
+
+static const struct {
+  const char *name;
+  enum EVAL_ENGINE engine;
+} engine_names[] = {
+    {"tree", ENGINE_TREE_WALKER},
+    {"vm", ENGINE_BYTECODE_VM},
+    {"regvm", ENGINE_REGISTER_VM},
+    {"closure", ENGINE_CLOSURE},
+    {"stack", ENGINE_STACK},
+};
+
+void evaluator_set_engine(enum EVAL_ENGINE engine) { active_engine = engine; }
+
+enum EVAL_ENGINE evaluator_get_engine() { return active_engine; }
+
+bool evaluator_engine_from_name(const char *name, enum EVAL_ENGINE *engine) {
+  for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); i++) {
+    if (strcmp(engine_names[i].name, name) == 0) {
+      *engine = engine_names[i].engine;
+      return true;
+    }
+  }
+  return false;
+}
+
 struct obj_t *evaluate_program(struct environment *env,
                                struct program *program) {
   if (!program) {
     return gc_alloc(OBJECT_SENTINEL);
   }
+  gc_push_env_root(env);
+  struct obj_t *result = evaluate_program_on(env, program);
+  gc_pop_roots(1);
+  return result;
+}
+
+/**
+ * run program on the active engine, the engines register what they hold
+ * outside of environments on the shadow root stack of the gc (gc.h)
+ */
+static struct obj_t *evaluate_program_on(struct environment *env,
+                                         struct program *program) {
+  switch (active_engine) {
+  case ENGINE_BYTECODE_VM: {
+    struct obj_t *result = vm_run_program(env, program);
+    if (result) {
+      return result;
+    }
+    // programs the compiler cannot lower run on the tree walker instead
+  }; break;
+  case ENGINE_REGISTER_VM: {
+    struct obj_t *result = reg_vm_run_program(env, program);
+    if (result) {
+      return result;
+    }
+  }; break;
+  case ENGINE_CLOSURE: {
+    struct obj_t *result = cnode_run_program(env, program);
+    if (result) {
+      return result;
+    }
+  }; break;
+  case ENGINE_STACK: {
+    struct obj_t *result = stack_eval_run_program(env, program);
+    if (result) {
+      return result;
+    }
+  }; break;
+  case ENGINE_TREE_WALKER:
+    break;
+  }
+  resolve_program(program);
+  fuse_program(program);
   return evaluate_statements(env, program->statements,
                              program->statement_count);
 }
@@ -91,23 +254,31 @@ struct obj_t *evaluate_expression(struct environment *env,
     return evaluate_literal_expr(expr);
   };
   case EXPR_IDENTIFIER: {
-    return evaluate_identifier_expr(env, expr->identifier_expr.identifier,
-                                    expr->identifier_expr.token);
+    return evaluate_name(env, expr);
   }; break;
   case EXPR_PREFIX: {
     return evaluate_prefix_expr(env, expr->prefix_expr.op,
                                 expr->prefix_expr.right);
   };
   case EXPR_INFIX: {
+    if (expr->fused != FUSED_NONE) {
+      return evaluate_fused_infix(env, expr);
+    }
     struct obj_t *left = evaluate_expression(env, expr->infix_expr.left);
     if (has_error(left)) {
       return left;
     }
+    gc_push_root(&left);
     struct obj_t *right = evaluate_expression(env, expr->infix_expr.right);
+    gc_pop_roots(1);
     if (has_error(right)) {
       return right;
     }
-    return evaluate_infix_expr(expr->infix_expr.op, left, right);
+    struct obj_t *result = evaluate_infix_temporary(expr, left, right);
+    if (result) {
+      return result;
+    }
+    return evaluate_infix_quickened(expr, left, right);
   };
   case EXPR_POSTFIX: {
     return evaluate_postfix_expr(env, expr->postfix_expr.op,
@@ -122,39 +293,23 @@ struct obj_t *evaluate_expression(struct environment *env,
   case EXPR_FUNCTION_CALL: {
     return evaluate_fn_call_expression(env, expr);
   }; break;
+  case EXPR_LOOP: {
+    return evaluate_loop_expression(env, expr);
+  };
   default:
     return gc_alloc(OBJECT_SENTINEL);
   }
 }
 
-struct obj_t **evaluate_expressions(struct environment *env,
-                                    struct expression **exprs,
-                                    size_t expr_count) {
-  struct obj_t **results =
-      (struct obj_t **)malloc(sizeof(struct obj_t *) * expr_count);
-  if (!results) {
-    ERROR_LOG("error while allocating memory\n");
-    return NULL;
-  }
-  for (size_t i = 0; i < expr_count; i++) {
-    struct obj_t *result = evaluate_expression(env, exprs[i]);
-    if (has_error(result)) {
-      results[0] = result;
-      return results;
-    }
-    results[i] = result;
-  }
-  return results;
-}
-
 struct obj_t *evaluate_statements(struct environment *env,
                                   struct statement **stmts, size_t stmt_count) {
-  struct obj_t *result;
+  struct obj_t *result = gc_alloc(OBJECT_SENTINEL);
   for (size_t i = 0; i < stmt_count; i++) {
+    gc_safe_point();
     result = evaluate_statement(env, stmts[i]);
-    if (result && result->type == OBJECT_RETURN) {
+    if (result && object_t_type(result) == OBJECT_RETURN) {
       return result->return_value.value;
-    } else if (result && result->type == OBJECT_ERROR) {
+    } else if (result && object_t_type(result) == OBJECT_ERROR) {
       return result;
     }
   }
@@ -165,10 +320,15 @@ struct obj_t *evaluate_let_statement(struct environment *env,
                                      struct statement *stmt) {
   if (stmt) {
     struct obj_t *value = evaluate_expression(env, stmt->let_stmt.value);
-    if (has_error(value)) {
-      return value;
+    if (has_error(value) || object_t_type(value) == OBJECT_RETURN) {
+      return value; // a return in the value does not bind the marker
+    }
+    if (stmt->let_stmt.scope && env->scope == stmt->let_stmt.scope) {
+      gc_write_barrier(env, value);
+      env->slots[stmt->let_stmt.slot] = value;
+    } else {
+      env_define(env, stmt->let_stmt.ident, value);
     }
-    env_define(env, stmt->let_stmt.ident, value);
     return value;
   }
   return gc_alloc(OBJECT_SENTINEL);
@@ -178,12 +338,13 @@ struct obj_t *evaluate_block_statements(struct environment *env,
                                         struct block_statement *block) {
 
   if (block) {
-    struct obj_t *result;
+    struct obj_t *result = gc_alloc(OBJECT_SENTINEL);
     for (size_t i = 0; i < block->statement_count; i++) {
+      gc_safe_point();
       result = evaluate_statement(env, block->statements[i]);
-      if (result && result->type == OBJECT_RETURN) {
+      if (result && object_t_type(result) == OBJECT_RETURN) {
         return result;
-      } else if (result && result->type == OBJECT_ERROR) {
+      } else if (result && object_t_type(result) == OBJECT_ERROR) {
         return result;
       }
     }
@@ -195,15 +356,22 @@ struct obj_t *evaluate_block_statements(struct environment *env,
 struct obj_t *evaluate_return_statement(struct environment *env,
                                         struct statement *stmt) {
   if (stmt) {
-    struct obj_t *value = evaluate_expression(env, stmt->return_stmt.value);
+    struct expression *expr = stmt->return_stmt.value;
+    if (call_depth > 0 && expr && expr->type == EXPR_FUNCTION_CALL &&
+        expr->function_call.arg_count <= FUSED_CALL_MAX_ARGS) {
+      return evaluate_tail_call(env, expr);
+    }
+    struct obj_t *value;
+    if (stmt->fused == FUSED_RETURN_NAME) {
+      value = evaluate_name(env, stmt->return_stmt.value);
+    } else {
+      value = evaluate_expression(env, stmt->return_stmt.value);
+    }
     if (has_error(value)) {
       return value;
     }
-    struct obj_t *object = gc_alloc(OBJECT_RETURN);
-    if (object) {
-      object->return_value.value = value;
-      return object;
-    }
+    return_marker.return_value.value = value;
+    return &return_marker;
   }
   return gc_alloc(OBJECT_SENTINEL);
 }
@@ -227,6 +395,47 @@ struct obj_t *evaluate_if_expression(struct environment *env,
   return gc_alloc(OBJECT_SENTINEL);
 }
 
+/**
+ * the body runs in env like any other block, so an iteration allocates
+ * nothing besides the values its statements produce. a loop evaluates to
+ * the sentinel value, return and errors leave the loop (and are the only
+ * way out of a loop without a condition)
+ */
+struct obj_t *evaluate_loop_expression(struct environment *env,
+                                       struct expression *expr) {
+  if (expr->loop.init) {
+    struct obj_t *init = evaluate_statement(env, expr->loop.init);
+    if (init && (object_t_type(init) == OBJECT_RETURN ||
+                 object_t_type(init) == OBJECT_ERROR)) {
+      return init;
+    }
+  }
+  for (;;) {
+    gc_safe_point();
+    if (expr->loop.condition) {
+      struct obj_t *condition = evaluate_expression(env, expr->loop.condition);
+      if (has_error(condition)) {
+        return condition;
+      }
+      if (!is_truthy(condition)) {
+        break;
+      }
+    }
+    struct obj_t *result = evaluate_block_statements(env, expr->loop.body);
+    if (result &&
+        (object_t_type(result) == OBJECT_RETURN || has_error(result))) {
+      return result;
+    }
+    if (expr->loop.update) {
+      struct obj_t *update = evaluate_expression(env, expr->loop.update);
+      if (has_error(update)) {
+        return update;
+      }
+    }
+  }
+  return gc_alloc(OBJECT_SENTINEL);
+}
+
 struct obj_t *evaluate_fn_expression(struct environment *env,
                                      struct expression *expr) {
   if (expr) {
@@ -234,11 +443,16 @@ struct obj_t *evaluate_fn_expression(struct environment *env,
     if (!obj) {
       return gc_alloc(OBJECT_SENTINEL);
     }
+    // a call environment no closure refers to can be a frame that is gone
+    // once the call returns, the closure encloses what encloses the call
+    if (env->scope && !env->scope->captured) {
+      env = env->parent;
+    }
     obj->function_value.env = env;
-    obj->function_value.param_capacity = expr->function.param_capacity;
-    obj->function_value.param_count = expr->function.param_count;
-    obj->function_value.parameters = expr->function.parameters;
-    obj->function_value.blk_stmts = expr->function.body;
+    obj->function_value.proto = function_proto_of(&expr->function);
+    if (!obj->function_value.proto) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
     return obj;
   }
   return gc_alloc(OBJECT_SENTINEL);
@@ -247,54 +461,228 @@ struct obj_t *evaluate_fn_expression(struct environment *env,
 struct obj_t *evaluate_fn_call_expression(struct environment *env,
                                           struct expression *expr) {
   if (expr) {
-    struct obj_t *function =
-        evaluate_expression(env, expr->function_call.function);
-    if (has_error(function)) {
-      return function;
+    size_t arg_count = expr->function_call.arg_count;
+    struct obj_t *inline_args[CALL_INLINE_ARGS];
+    struct obj_t **args = inline_args;
+    size_t base = arg_stack.count;
+    if (arg_count > CALL_INLINE_ARGS) {
+      if (ARG_STACK_SIZE - base >= arg_count) {
+        args = &arg_stack.values[base];
+        arg_stack.count += arg_count;
+      } else {
+        args = malloc(sizeof(struct obj_t *) * arg_count);
+        if (!args) {
+          ERROR_LOG("error while allocating memory\n");
+          return gc_alloc(OBJECT_SENTINEL);
+        }
+      }
     }
-    if (function->type != OBJECT_FUNCTION) {
-      struct obj_t *err = gc_alloc(OBJECT_ERROR);
-      error_t_format_err(err->err_value, expr->function_call.token,
-                         "invalid function call",
-                         "only functions can be called");
-      return err;
+    struct obj_t *function = NULL;
+    struct obj_t *result = evaluate_call_operands(env, expr, &function, args);
+    if (!result) {
+      result = evaluate_function_call(expr->function_call.token, function,
+                                      args, arg_count);
     }
-
-    // evaluate the arguments
-    struct obj_t **args = evaluate_expressions(
-        env, expr->function_call.arguments, expr->function_call.arg_count);
-    if (!args) {
-      return gc_alloc(OBJECT_SENTINEL);
+    if (args == &arg_stack.values[base]) {
+      arg_stack.count = base;
+    } else if (args != inline_args) {
+      free(args);
     }
-    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+    return result;
+  }
+  return gc_alloc(OBJECT_SENTINEL);
+}
+
+/**
+ * evaluate the callee of a call and its arguments into args, returns the
+ * error that stopped the evaluation or NULL. identifiers of fused calls are
+ * looked up directly. the callee and the arguments evaluated so far are
+ * roots while the next argument is evaluated
+ */
+struct obj_t *evaluate_call_operands(struct environment *env,
+                                     struct expression *expr,
+                                     struct obj_t **function,
+                                     struct obj_t **args) {
+  bool fused = expr->fused == FUSED_CALL_NAMES;
+  struct expression *callee = expr->function_call.function;
+  if (callee->type == EXPR_IDENTIFIER && !callee->identifier_expr.scope) {
+    *function = evaluate_callee_name(env, expr);
+  } else {
+    *function =
+        fused ? evaluate_name(env, callee) : evaluate_expression(env, callee);
+  }
+  if (has_error(*function)) {
+    return *function;
+  }
+  if (object_t_type(*function) != OBJECT_FUNCTION) {
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, expr->function_call.token,
+                       "invalid function call",
+                       "only functions can be called");
+    return err;
+  }
+  size_t arg_count = expr->function_call.arg_count;
+  if (fused) {
+    for (size_t i = 0; i < arg_count; i++) {
+      args[i] = evaluate_name(env, expr->function_call.arguments[i]);
       if (has_error(args[i])) {
-        free(args);
         return args[i];
-      } else {
       }
     }
+    return NULL;
+  }
+  for (size_t i = 0; i < arg_count; i++) {
+    args[i] = NULL;
+  }
+  gc_push_root(function);
+  gc_push_roots(args, arg_count);
+  struct obj_t *err = NULL;
+  for (size_t i = 0; i < arg_count && !err; i++) {
+    args[i] = evaluate_expression(env, expr->function_call.arguments[i]);
+    if (has_error(args[i])) {
+      err = args[i];
+    }
+  }
+  gc_pop_roots(2);
+  return err;
+}
 
-    struct environment *child = env_init();
+/**
+ * `return f(...)` inside of a function, the operands are evaluated before
+ * tail_call is written as they can make tail calls of their own
+ */
+struct obj_t *evaluate_tail_call(struct environment *env,
+                                 struct expression *expr) {
+  struct obj_t *args[FUSED_CALL_MAX_ARGS];
+  struct obj_t *function = NULL;
+  struct obj_t *err = evaluate_call_operands(env, expr, &function, args);
+  if (err) {
+    return err;
+  }
+  tail_call.token = expr->function_call.token;
+  tail_call.function = function;
+  tail_call.arg_count = expr->function_call.arg_count;
+  memcpy(tail_call.args, args, sizeof(struct obj_t *) * tail_call.arg_count);
+  return &tail_call_marker;
+}
+
+/**
+ * call function with evaluated arguments, the arguments are bound to the
+ * parameters in a new environment enclosed by the one of the function,
+ * straight into the slots when the function was resolved. environments
+ * that cannot be captured are frames on the frame stack (or freed when
+ * the function was not resolved) and released once the call returns, it is
+ * a root of the gc while the body runs. tail calls made by the body are run
+ * by the loop, the environment is reused for them unless the body creates
+ * functions that could capture it
+ */
+struct obj_t *evaluate_function_call(struct token *token,
+                                     struct obj_t *function,
+                                     struct obj_t **args, size_t arg_count) {
+  struct obj_t *tail_args[FUSED_CALL_MAX_ARGS];
+  struct environment *child = NULL;
+  struct obj_t *result = NULL;
+  call_depth++;
+  for (;;) {
+    if (object_t_type(function) != OBJECT_FUNCTION) {
+      result = gc_alloc(OBJECT_ERROR);
+      error_t_format_err(result->err_value, token, "invalid function call",
+                         "only functions can be called");
+      break;
+    }
+    struct function_proto *proto = function->function_value.proto;
+    if (arg_count < proto->param_count) {
+      result = gc_alloc(OBJECT_ERROR);
+      error_t_format_err(result->err_value, token, "invalid function call",
+                         "not enough arguments for the function parameters");
+      break;
+    }
+    if (jit_try_call(function, args, arg_count, &result)) {
+      break;
+    }
+
+    const struct scope *scope = proto->scope;
+    if (child && child->scope != scope) {
+      release_call_env(child);
+      child = NULL;
+    }
     if (!child) {
-      free(args);
-      return gc_alloc(OBJECT_SENTINEL);
+      child = env_push_call(scope, proto->captured);
+      if (!child) {
+        result = gc_alloc(OBJECT_SENTINEL);
+        break;
+      }
+      gc_push_env_root(child);
     }
     child->parent = function->function_value.env;
-
-    for (size_t i = 0; i < function->function_value.param_count; i++) {
-      env_define(child, function->function_value.parameters[i]->id, args[i]);
+    if (scope) {
+      bind_arguments(child, args, proto->param_count);
+    } else {
+      for (size_t i = 0; i < proto->param_count; i++) {
+        env_define(child, proto->parameters[i]->id, args[i]);
+      }
     }
 
-    struct obj_t *result =
-        evaluate_block_statements(child, function->function_value.blk_stmts);
-    if (result && result->type == OBJECT_RETURN) {
-      return result->return_value.value;
+    result = evaluate_block_statements(child, proto->body);
+    if (proto->captured) {
+      gc_pop_roots(1);
+      child = NULL; // closures created by the body keep it
+    }
+    if (result != &tail_call_marker) {
+      break;
     }
+    if (child) {
+      env_clear(child);
+    }
+    token = tail_call.token;
+    function = tail_call.function;
+    arg_count = tail_call.arg_count;
+    memcpy(tail_args, tail_call.args, sizeof(struct obj_t *) * arg_count);
+    args = tail_args;
+  }
+  if (child) {
+    release_call_env(child);
+  }
+  call_depth--;
+  if (result && object_t_type(result) == OBJECT_RETURN) {
+    return result->return_value.value;
+  }
+  return result;
+}
 
-    free(args);
-    return result;
+/**
+ * parameter i is slot i, unrolled for the usual arities
+ */
+static inline void bind_arguments(struct environment *env,
+                                  struct obj_t **args, size_t count) {
+  struct obj_t **slots = env->slots;
+  for (size_t i = 0; i < count && !env->remembered; i++) {
+    gc_write_barrier(env, args[i]);
   }
-  return gc_alloc(OBJECT_SENTINEL);
+  switch (count) {
+  case 4:
+    slots[3] = args[3];
+    // fall through
+  case 3:
+    slots[2] = args[2];
+    // fall through
+  case 2:
+    slots[1] = args[1];
+    // fall through
+  case 1:
+    slots[0] = args[0];
+    // fall through
+  case 0:
+    break;
+  default:
+    memcpy(slots, args, sizeof(struct obj_t *) * count);
+  }
+}
+
+// environment of a call that was not captured, it is a root until now
+static void release_call_env(struct environment *env) {
+  gc_pop_roots(1);
+  env_release_call(env, false);
 }
 
 struct obj_t *evaluate_fn_def_stmt(struct expression *expr) {
@@ -306,49 +694,8 @@ struct obj_t *evaluate_literal_expr(struct expression *expr) {
   if (!expr) {
     return gc_alloc(OBJECT_SENTINEL);
   }
-  switch (expr->literal.literal_type) {
-  case LITERAL_BOOL: {
-    return expr->literal.value.bool_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                          : gc_alloc(OBJECT_BOOL_FALSE);
-  };
-  case LITERAL_INT: {
-    struct obj_t *obj = gc_alloc(OBJECT_INT);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->int_value = expr->literal.value.int_value;
-    return obj;
-  };
-  case LITERAL_FLOAT: {
-    struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->double_value = expr->literal.value.float_value;
-    return obj;
-  };
-  case LITERAL_STRING: {
-    struct obj_t *obj = gc_alloc(OBJECT_STRING);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->string_value.data =
-        strndup(expr->literal.value.string_literal->value,
-                expr->literal.value.string_literal->length);
-    obj->string_value.length = expr->literal.value.string_literal->length;
-    return obj;
-  };
-  case LITERAL_CHAR: {
-    struct obj_t *obj = gc_alloc(OBJECT_CHAR);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->rune_value = expr->literal.value.char_value;
-    return obj;
-  };
-  default:
-    return gc_alloc(OBJECT_SENTINEL);
-  }
+  struct obj_t *value = literal_object_of(&expr->literal);
+  return value ? value : gc_alloc(OBJECT_SENTINEL);
 }
 
 struct obj_t *evaluate_prefix_expr(struct environment *env,
@@ -400,19 +747,13 @@ struct obj_t *evaluate_prefix_bang_operator_expr(struct token *operator,
 
 struct obj_t *evaluate_prefix_minus_operator_expr(struct token *operator,
                                                   struct obj_t * right) {
-  if (right->type == OBJECT_INT) {
-    struct obj_t *obj = gc_alloc(OBJECT_INT);
+  if (object_t_is_int(right)) {
+    return gc_int(-object_t_int(right));
+  } else if (object_t_type(right) == OBJECT_DOUBLE) {
+    struct obj_t *obj = gc_double(-object_t_double(right));
     if (!obj) {
       return gc_alloc(OBJECT_SENTINEL);
     }
-    obj->int_value = -right->int_value;
-    return obj;
-  } else if (right->type == OBJECT_DOUBLE) {
-    struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->double_value = -right->double_value;
     return obj;
   } else {
     struct obj_t *err = gc_alloc(OBJECT_ERROR);
@@ -425,19 +766,13 @@ struct obj_t *evaluate_prefix_minus_operator_expr(struct token *operator,
 
 struct obj_t *evaluate_prefix_plus_operator_expr(struct token *token,
                                                  struct obj_t *right) {
-  if (right->type == OBJECT_INT) {
-    struct obj_t *obj = gc_alloc(OBJECT_INT);
-    if (!obj) {
-      return gc_alloc(OBJECT_SENTINEL);
-    }
-    obj->int_value = +right->int_value;
-    return obj;
-  } else if (right->type == OBJECT_DOUBLE) {
-    struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+  if (object_t_is_int(right)) {
+    return gc_int(+object_t_int(right));
+  } else if (object_t_type(right) == OBJECT_DOUBLE) {
+    struct obj_t *obj = gc_double(+object_t_double(right));
     if (!obj) {
       return gc_alloc(OBJECT_SENTINEL);
     }
-    obj->double_value = +right->double_value;
     return obj;
   } else {
     struct obj_t *err = gc_alloc(OBJECT_ERROR);
@@ -448,38 +783,79 @@ struct obj_t *evaluate_prefix_plus_operator_expr(struct token *token,
   }
 }
 
+/**
+ * where the value of an identifier is stored, the slot the resolver bound
+ * it to or the hash table entry of its name. NULL when the name is not bound
+ * or is bound to a slot of a scope the resolver did not pick
+ */
+static struct obj_t **evaluate_binding(struct environment *env,
+                                       struct expression *ident) {
+  const struct scope *scope = ident->identifier_expr.scope;
+  if (scope) {
+    struct environment *target = env;
+    for (size_t i = 0; target && i < ident->identifier_expr.depth; i++) {
+      target = target->parent;
+    }
+    if (target && target->scope == scope &&
+        target->slots[ident->identifier_expr.slot]) {
+      return &target->slots[ident->identifier_expr.slot];
+    }
+  }
+  struct entry *entry =
+      env_look_up_entry(env, ident->identifier_expr.identifier);
+  return entry ? &entry->value : NULL;
+}
+
+/**
+ * ++ (delta 1) and -- (delta -1) of the number bound to an identifier. ints
+ * and most doubles are immediates (object_t.h), the name is rebound to the
+ * new number rather than updated in place. an immediate needs no write
+ * barrier and is stored straight into the binding. evaluates to the old
+ * number, NULL when the identifier is not bound to a number
+ */
+static struct obj_t *evaluate_step(struct environment *env,
+                                   struct expression *ident,
+                                   struct token *token, int delta) {
+  char *name = ident->identifier_expr.identifier;
+  struct obj_t **binding = evaluate_binding(env, ident);
+  struct obj_t *value =
+      binding ? *binding : evaluate_identifier_expr(env, name, token);
+  if (has_error(value)) {
+    return value;
+  }
+  struct obj_t *next;
+  if (object_t_is_int(value)) {
+    next = gc_int(object_t_int(value) + delta);
+  } else if (object_t_type(value) == OBJECT_DOUBLE) {
+    next = gc_double(object_t_double(value) + delta);
+  } else {
+    return NULL;
+  }
+  if (!next) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  if (binding && object_t_is_immediate(next)) {
+    *binding = next;
+  } else {
+    env_set(env, name, next);
+  }
+  return value;
+}
+
 struct obj_t *evaluate_prefix_increment_operator_expr(
     struct environment *env, struct token *token, struct expression *right) {
   switch (right->type) {
   case EXPR_IDENTIFIER: {
-    struct obj_t *res =
-        evaluate_identifier_expr(env, right->identifier_expr.identifier, token);
-    if (has_error(res)) {
+    struct obj_t *res = evaluate_step(env, right, token, 1);
+    if (res) {
       return res;
     }
-    if (res->type == OBJECT_INT) {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
-      if (obj) {
-        obj->int_value = res->int_value;
-        res->int_value += 1;
-        return obj;
-      }
-    } else if (res->type == OBJECT_DOUBLE) {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-      if (obj) {
-        obj->double_value = res->double_value;
-        res->double_value += 1;
-        return obj;
-      }
-    } else {
-      struct obj_t *err = gc_alloc(OBJECT_ERROR);
-      error_t_format_err(
-          err->err_value, token,
-          "operation not permitted on non numerical identifiers",
-          "operation only permitted on integer or floating point "
-          "identifiers (variables)");
-      return err;
-    }
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, token,
+                       "operation not permitted on non numerical identifiers",
+                       "operation only permitted on integer or floating point "
+                       "identifiers (variables)");
+    return err;
   }; break;
   default: {
     struct obj_t *err = gc_alloc(OBJECT_ERROR);
@@ -498,34 +874,16 @@ struct obj_t *evaluate_prefix_decrement_operator_expr(struct environment *env,
                                                       right) {
   switch (right->type) {
   case EXPR_IDENTIFIER: {
-    struct obj_t *res = evaluate_identifier_expr(
-        env, right->identifier_expr.identifier, operator);
-    if (has_error(res)) {
+    struct obj_t *res = evaluate_step(env, right, operator, -1);
+    if (res) {
       return res;
     }
-    if (res->type == OBJECT_INT) {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
-      if (obj) {
-        obj->int_value = res->int_value;
-        res->int_value -= 1;
-        return obj;
-      }
-    } else if (res->type == OBJECT_DOUBLE) {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-      if (obj) {
-        obj->double_value = res->double_value;
-        res->double_value -= 1;
-        return obj;
-      }
-    } else {
-      struct obj_t *err = gc_alloc(OBJECT_ERROR);
-      error_t_format_err(
-          err->err_value, operator,
-          "operation not permitted on non numerical identifiers",
-          "operation only permitted on integer or floating point "
-          "identifiers (variables)");
-      return err;
-    }
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, operator,
+                       "operation not permitted on non numerical identifiers",
+                       "operation only permitted on integer or floating point "
+                       "identifiers (variables)");
+    return err;
   }; break;
   default: {
     struct obj_t *err = gc_alloc(OBJECT_ERROR);
@@ -541,15 +899,20 @@ struct obj_t *evaluate_prefix_decrement_operator_expr(struct environment *env,
 struct obj_t *evaluate_infix_expr(struct token *operator, struct obj_t * left,
                                   struct obj_t *right) {
   if (left && right) {
-    if (left->type == OBJECT_INT && right->type == OBJECT_INT) {
+    enum OBJECT_TYPE type = object_t_type(left);
+    if (type != object_t_type(right)) {
+      struct obj_t *err = gc_alloc(OBJECT_ERROR);
+      error_t_format_err(err->err_value, operator, "type mismatch", "");
+      return err;
+    } else if (type == OBJECT_INT) {
       return evaluate_infix_integer_expr(operator, left, right);
-    } else if (left->type == OBJECT_DOUBLE && right->type == OBJECT_DOUBLE) {
+    } else if (type == OBJECT_DOUBLE) {
       return evaluate_infix_float_expr(operator, left, right);
-    } else if (left->type == OBJECT_CHAR && right->type == OBJECT_CHAR) {
+    } else if (type == OBJECT_CHAR) {
       return evaluate_infix_char_expr(operator, left, right);
-    } else if (left->type == OBJECT_BOOL && right->type == OBJECT_BOOL) {
+    } else if (type == OBJECT_BOOL) {
       return evaluate_infix_boolean_expr(operator, left, right);
-    } else if (left->type == OBJECT_STRING && right->type == OBJECT_STRING) {
+    } else if (type == OBJECT_STRING) {
       return evaluate_infix_string_expr(operator, left, right);
     } else {
       struct obj_t *err = gc_alloc(OBJECT_ERROR);
@@ -560,68 +923,370 @@ struct obj_t *evaluate_infix_expr(struct token *operator, struct obj_t * left,
   return gc_alloc(OBJECT_SENTINEL);
 }
 
+/**
+ * quickening of infix nodes: a generic node counts how often it sees the same
+ * type on both sides, after INFIX_QUICK_AFTER runs it installs a handler for
+ * that operator and type which skips the type dispatch of
+ * evaluate_infix_expr. the handler is guarded by a single type check, when
+ * the check fails the node goes back to generic, after INFIX_MAX_MISSES
+ * failures the node is considered polymorphic and stays generic
+ */
+#define INFIX_QUICK_AFTER 2
+#define INFIX_MAX_MISSES 4
+
+struct obj_t *evaluate_infix_quickened(struct expression *expr,
+                                       struct obj_t *left,
+                                       struct obj_t *right) {
+  if (!left || !right) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  enum OBJECT_TYPE type = object_t_type(left);
+  if (expr->infix_expr.quick) {
+    if (type == expr->infix_expr.quick_type &&
+        object_t_type(right) == type) {
+      return expr->infix_expr.quick(left, right);
+    }
+    expr->infix_expr.quick = NULL;
+    expr->infix_expr.quick_hits = 0;
+    expr->infix_expr.quick_misses++;
+  } else if (expr->infix_expr.quick_misses < INFIX_MAX_MISSES &&
+             type == object_t_type(right)) {
+    if (type != expr->infix_expr.quick_type) {
+      expr->infix_expr.quick_type = type;
+      expr->infix_expr.quick_hits = 0;
+    }
+    if (++expr->infix_expr.quick_hits >= INFIX_QUICK_AFTER) {
+      expr->infix_expr.quick =
+          infix_quick_handler(expr->infix_expr.op->type, type);
+      if (!expr->infix_expr.quick) {
+        // no specialized handler for this operator and type
+        expr->infix_expr.quick_misses = INFIX_MAX_MISSES;
+      }
+    }
+  }
+  return evaluate_infix_expr(expr->infix_expr.op, left, right);
+}
+
+/**
+ * a / b and a % b of ints are the sentinel value where they are undefined,
+ * for a zero divisor and for INT_MIN / -1 whose quotient is not an int
+ */
+static inline bool int_division_undefined(int a, int b) {
+  return b == 0 || (b == -1 && a == INT_MIN);
+}
+
+static inline bool double_division_undefined(double a, double b) {
+  (void)a;
+  return b == 0;
+}
+
+/**
+ * a boxed double (one without an immediate form, see object_t.h) produced by
+ * an infix node is referenced by nothing but the node it is an operand of,
+ * once that node has read it the object can hold its result instead of a
+ * new one. returns NULL when neither operand is such a temporary or the
+ * operator is not arithmetic, the caller then evaluates the node as usual
+ */
+static bool is_temporary(struct expression *operand, struct obj_t *value) {
+  return operand->type == EXPR_INFIX && !object_t_is_immediate(value) &&
+         !value->immortal;
+}
+
+static struct obj_t *evaluate_infix_temporary(struct expression *expr,
+                                              struct obj_t *left,
+                                              struct obj_t *right) {
+  struct obj_t *temp = NULL;
+  if (is_temporary(expr->infix_expr.left, left)) {
+    temp = left;
+  } else if (is_temporary(expr->infix_expr.right, right)) {
+    temp = right;
+  }
+  if (!temp || object_t_type(left) != OBJECT_DOUBLE ||
+      object_t_type(right) != OBJECT_DOUBLE) {
+    return NULL;
+  }
+  double a = object_t_double(left);
+  double b = object_t_double(right);
+  double value;
+  switch (expr->infix_expr.op->type) {
+  case PLUS:
+    value = a + b;
+    break;
+  case MINUS:
+    value = a - b;
+    break;
+  case ASTERISK:
+    value = a * b;
+    break;
+  case SLASH:
+    if (b == 0) {
+      return NULL;
+    }
+    value = a / b;
+    break;
+  default:
+    return NULL;
+  }
+  struct obj_t *immediate = object_t_immediate_double(value);
+  if (immediate) {
+    return immediate;
+  }
+  temp->double_value = value;
+  return temp;
+}
+
+/**
+ * identifier OP literal and identifier OP identifier in one step, the
+ * literal is an object on the stack since no infix operator keeps its
+ * operands
+ */
+struct obj_t *evaluate_fused_infix(struct environment *env,
+                                   struct expression *expr) {
+  struct expression *lhs = expr->infix_expr.left;
+  struct expression *rhs = expr->infix_expr.right;
+  struct obj_t *left = evaluate_name(env, lhs);
+  if (has_error(left)) {
+    return left;
+  }
+  if (expr->fused == FUSED_NAME_NAME) {
+    struct obj_t *right = evaluate_name(env, rhs);
+    if (has_error(right)) {
+      return right;
+    }
+    return evaluate_infix_quickened(expr, left, right);
+  }
+
+  struct obj_t literal = {.gc_next = NULL, .forwarded = false};
+  struct obj_t *right = &literal;
+  switch (rhs->literal.literal_type) {
+  case LITERAL_INT:
+    right = gc_int(rhs->literal.value.int_value);
+    break;
+  case LITERAL_FLOAT:
+    right = object_t_immediate_double(rhs->literal.value.float_value);
+    if (!right) {
+      right = &literal;
+      literal.type = OBJECT_DOUBLE;
+      literal.double_value = rhs->literal.value.float_value;
+    }
+    break;
+  case LITERAL_CHAR:
+    right = gc_char(rhs->literal.value.char_value);
+    break;
+  case LITERAL_BOOL:
+    right = rhs->literal.value.bool_value ? gc_alloc(OBJECT_BOOL_TRUE)
+                                          : gc_alloc(OBJECT_BOOL_FALSE);
+    break;
+  case LITERAL_STRING:
+    right = evaluate_literal_expr(rhs);
+    break;
+  }
+  return evaluate_infix_quickened(expr, left, right);
+}
+
+// clang-format off
+
+#define QUICK_ARITHMETIC(name, result, value, op)                              \
+  static struct obj_t *name(struct obj_t *left, struct obj_t *right) {         \
+    struct obj_t *obj = result(value(left) op value(right));                   \
+    if (!obj) {                                                                \
+      return gc_alloc(OBJECT_SENTINEL);                                        \
+    }                                                                          \
+    return obj;                                                                \
+  }
+
+#define QUICK_DIVISION(name, result, value, op, undefined)                     \
+  static struct obj_t *name(struct obj_t *left, struct obj_t *right) {         \
+    if (undefined(value(left), value(right))) {                                \
+      return gc_alloc(OBJECT_SENTINEL);                                        \
+    }                                                                          \
+    struct obj_t *obj = result(value(left) op value(right));                   \
+    if (!obj) {                                                                \
+      return gc_alloc(OBJECT_SENTINEL);                                        \
+    }                                                                          \
+    return obj;                                                                \
+  }
+
+#define QUICK_COMPARISON(name, value, op)                                      \
+  static struct obj_t *name(struct obj_t *left, struct obj_t *right) {         \
+    return value(left) op value(right) ? gc_alloc(OBJECT_BOOL_TRUE)            \
+                                       : gc_alloc(OBJECT_BOOL_FALSE);          \
+  }
+
+QUICK_ARITHMETIC(quick_int_add, gc_int, object_t_int, +)
+QUICK_ARITHMETIC(quick_int_sub, gc_int, object_t_int, -)
+QUICK_ARITHMETIC(quick_int_mul, gc_int, object_t_int, *)
+QUICK_DIVISION(quick_int_div, gc_int, object_t_int, /, int_division_undefined)
+QUICK_DIVISION(quick_int_mod, gc_int, object_t_int, %, int_division_undefined)
+QUICK_COMPARISON(quick_int_lt, object_t_int, <)
+QUICK_COMPARISON(quick_int_gt, object_t_int, >)
+QUICK_COMPARISON(quick_int_lt_eq, object_t_int, <=)
+QUICK_COMPARISON(quick_int_gt_eq, object_t_int, >=)
+QUICK_COMPARISON(quick_int_eq_eq, object_t_int, ==)
+QUICK_COMPARISON(quick_int_not_eq, object_t_int, !=)
+
+QUICK_ARITHMETIC(quick_double_add, gc_double, object_t_double, +)
+QUICK_ARITHMETIC(quick_double_sub, gc_double, object_t_double, -)
+QUICK_ARITHMETIC(quick_double_mul, gc_double, object_t_double, *)
+QUICK_DIVISION(quick_double_div, gc_double, object_t_double, /,
+               double_division_undefined)
+QUICK_COMPARISON(quick_double_lt, object_t_double, <)
+QUICK_COMPARISON(quick_double_gt, object_t_double, >)
+QUICK_COMPARISON(quick_double_lt_eq, object_t_double, <=)
+QUICK_COMPARISON(quick_double_gt_eq, object_t_double, >=)
+QUICK_COMPARISON(quick_double_eq_eq, object_t_double, ==)
+QUICK_COMPARISON(quick_double_not_eq, object_t_double, !=)
+
+QUICK_COMPARISON(quick_bool_eq_eq, object_t_bool, ==)
+QUICK_COMPARISON(quick_bool_not_eq, object_t_bool, !=)
+QUICK_COMPARISON(quick_char_eq_eq, object_t_char, ==)
+QUICK_COMPARISON(quick_char_not_eq, object_t_char, !=)
+
+#undef QUICK_ARITHMETIC
+#undef QUICK_DIVISION
+#undef QUICK_COMPARISON
+
+// clang-format on
+
+/**
+ * the handler for an operator applied to two operands of type, NULL if the
+ * combination is an error or is not specialized
+ */
+static infix_quick_fn infix_quick_handler(enum TOKEN_TYPE operator,
+                                          enum OBJECT_TYPE type) {
+  switch (type) {
+  case OBJECT_INT: {
+    switch (operator) {
+    case PLUS:
+      return quick_int_add;
+    case MINUS:
+      return quick_int_sub;
+    case ASTERISK:
+      return quick_int_mul;
+    case SLASH:
+      return quick_int_div;
+    case MOD:
+      return quick_int_mod;
+    case LT:
+      return quick_int_lt;
+    case GT:
+      return quick_int_gt;
+    case LT_EQ:
+      return quick_int_lt_eq;
+    case GT_EQ:
+      return quick_int_gt_eq;
+    case EQ_EQ:
+      return quick_int_eq_eq;
+    case NOT_EQ:
+      return quick_int_not_eq;
+    default:
+      return NULL;
+    }
+  };
+  case OBJECT_DOUBLE: {
+    switch (operator) {
+    case PLUS:
+      return quick_double_add;
+    case MINUS:
+      return quick_double_sub;
+    case ASTERISK:
+      return quick_double_mul;
+    case SLASH:
+      return quick_double_div;
+    case LT:
+      return quick_double_lt;
+    case GT:
+      return quick_double_gt;
+    case LT_EQ:
+      return quick_double_lt_eq;
+    case GT_EQ:
+      return quick_double_gt_eq;
+    case EQ_EQ:
+      return quick_double_eq_eq;
+    case NOT_EQ:
+      return quick_double_not_eq;
+    default:
+      return NULL;
+    }
+  };
+  case OBJECT_BOOL: {
+    return operator == EQ_EQ    ? quick_bool_eq_eq
+           : operator == NOT_EQ ? quick_bool_not_eq
+                                : NULL;
+  };
+  case OBJECT_CHAR: {
+    return operator == EQ_EQ    ? quick_char_eq_eq
+           : operator == NOT_EQ ? quick_char_not_eq
+                                : NULL;
+  };
+  default:
+    return NULL;
+  }
+}
+
 struct obj_t *evaluate_infix_integer_expr(struct token *operator,
                                           struct obj_t * left,
                                           struct obj_t *right) {
   if (left && right) {
     switch (operator->type) {
     case PLUS: {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
+      struct obj_t *obj = gc_int(object_t_int(left) + object_t_int(right));
       if (obj) {
-        obj->int_value = left->int_value + right->int_value;
         return obj;
       }
     }; break;
     case MINUS: {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
+      struct obj_t *obj = gc_int(object_t_int(left) - object_t_int(right));
       if (obj) {
-        obj->int_value = left->int_value - right->int_value;
         return obj;
       }
     }; break;
     case ASTERISK: {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
+      struct obj_t *obj = gc_int(object_t_int(left) * object_t_int(right));
       if (obj) {
-        obj->int_value = left->int_value * right->int_value;
         return obj;
       }
     }; break;
     case SLASH: {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
+      if (int_division_undefined(object_t_int(left), object_t_int(right))) {
+        return gc_alloc(OBJECT_SENTINEL);
+      }
+      struct obj_t *obj = gc_int(object_t_int(left) / object_t_int(right));
       if (obj) {
-        if (left->int_value != 0) {
-          obj->int_value = left->int_value / right->int_value;
-          return obj;
-        } else {
-          object_t_free(obj);
-          return gc_alloc(OBJECT_SENTINEL);
-        }
+        return obj;
       }
     }; break;
     case MOD: {
-      struct obj_t *obj = gc_alloc(OBJECT_INT);
+      if (int_division_undefined(object_t_int(left), object_t_int(right))) {
+        return gc_alloc(OBJECT_SENTINEL);
+      }
+      struct obj_t *obj = gc_int(object_t_int(left) % object_t_int(right));
       if (obj) {
-        obj->int_value = left->int_value % right->int_value;
         return obj;
       }
     }; break;
     case GT:
-      return left->int_value > right->int_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                                : gc_alloc(OBJECT_BOOL_FALSE);
+      return object_t_int(left) > object_t_int(right)
+                 ? gc_alloc(OBJECT_BOOL_TRUE)
+                 : gc_alloc(OBJECT_BOOL_FALSE);
     case GT_EQ:
-      return left->int_value >= right->int_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                                 : gc_alloc(OBJECT_BOOL_FALSE);
+      return object_t_int(left) >= object_t_int(right)
+                 ? gc_alloc(OBJECT_BOOL_TRUE)
+                 : gc_alloc(OBJECT_BOOL_FALSE);
     case LT:
-      return left->int_value < right->int_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                                : gc_alloc(OBJECT_BOOL_FALSE);
+      return object_t_int(left) < object_t_int(right)
+                 ? gc_alloc(OBJECT_BOOL_TRUE)
+                 : gc_alloc(OBJECT_BOOL_FALSE);
     case LT_EQ:
-      return left->int_value <= right->int_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                                 : gc_alloc(OBJECT_BOOL_FALSE);
+      return object_t_int(left) <= object_t_int(right)
+                 ? gc_alloc(OBJECT_BOOL_TRUE)
+                 : gc_alloc(OBJECT_BOOL_FALSE);
     case EQ_EQ:
-      return left->int_value == right->int_value ? gc_alloc(OBJECT_BOOL_TRUE)
-                                                 : gc_alloc(OBJECT_BOOL_FALSE);
+      return object_t_int(left) == object_t_int(right)
+                 ? gc_alloc(OBJECT_BOOL_TRUE)
+                 : gc_alloc(OBJECT_BOOL_FALSE);
     case NOT_EQ:
-      return left->double_value != right->double_value
+      return object_t_int(left) != object_t_int(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     default: {
@@ -642,11 +1307,11 @@ struct obj_t *evaluate_infix_boolean_expr(struct token *operator,
   if (left && right) {
     switch (operator->type) {
     case EQ_EQ:
-      return left->bool_value == right->bool_value
+      return object_t_bool(left) == object_t_bool(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case NOT_EQ:
-      return left->bool_value != right->bool_value
+      return object_t_bool(left) != object_t_bool(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     default: {
@@ -666,59 +1331,58 @@ struct obj_t *evaluate_infix_float_expr(struct token *operator,
   if (left && right) {
     switch (operator->type) {
     case PLUS: {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+      struct obj_t *obj =
+          gc_double(object_t_double(left) + object_t_double(right));
       if (obj) {
-        obj->double_value = left->double_value + right->double_value;
         return obj;
       }
     }; break;
     case MINUS: {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+      struct obj_t *obj =
+          gc_double(object_t_double(left) - object_t_double(right));
       if (obj) {
-        obj->double_value = left->double_value - right->double_value;
         return obj;
       }
     }; break;
     case ASTERISK: {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+      struct obj_t *obj =
+          gc_double(object_t_double(left) * object_t_double(right));
       if (obj) {
-        obj->double_value = left->double_value * right->double_value;
         return obj;
       }
     }; break;
     case SLASH: {
-      struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+      if (object_t_double(right) == 0) {
+        return gc_alloc(OBJECT_SENTINEL);
+      }
+      struct obj_t *obj =
+          gc_double(object_t_double(left) / object_t_double(right));
       if (obj) {
-        if (left->double_value != 0) {
-          obj->double_value = left->double_value / right->double_value;
-          return obj;
-        } else {
-          object_t_free(obj);
-        }
+        return obj;
       }
     }; break;
     case GT:
-      return left->double_value > right->double_value
+      return object_t_double(left) > object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case GT_EQ:
-      return left->double_value >= right->double_value
+      return object_t_double(left) >= object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case LT:
-      return left->double_value < right->double_value
+      return object_t_double(left) < object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case LT_EQ:
-      return left->double_value <= right->double_value
+      return object_t_double(left) <= object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case EQ_EQ:
-      return left->double_value == right->double_value
+      return object_t_double(left) == object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case NOT_EQ:
-      return left->double_value != right->double_value
+      return object_t_double(left) != object_t_double(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     default: {
@@ -739,11 +1403,11 @@ struct obj_t *evaluate_infix_char_expr(struct token *operator,
   if (left && right) {
     switch (operator->type) {
     case EQ_EQ:
-      return left->rune_value == right->rune_value
+      return object_t_char(left) == object_t_char(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     case NOT_EQ:
-      return left->rune_value != right->rune_value
+      return object_t_char(left) != object_t_char(right)
                  ? gc_alloc(OBJECT_BOOL_TRUE)
                  : gc_alloc(OBJECT_BOOL_FALSE);
     default: {
@@ -771,66 +1435,34 @@ struct obj_t *evaluate_postfix_expr(struct environment *env,
 
   if (left) {
     if (left->type == EXPR_IDENTIFIER) {
-      struct obj_t *res = evaluate_identifier_expr(
-          env, left->identifier_expr.identifier, operator);
-      if (has_error(res)) {
-        return res;
-      }
-      if (res->type == OBJECT_INT) {
-        switch (operator->type) {
-        case INC: {
-          struct obj_t *obj = gc_alloc(OBJECT_INT);
-          obj->int_value = res->int_value;
-          res->int_value += 1;
-          return obj;
-        }; break;
-        case DEC: {
-          struct obj_t *obj = gc_alloc(OBJECT_INT);
-          obj->int_value = res->int_value;
-          res->int_value -= 1;
-          return obj;
-        }; break;
-        default: {
-          struct obj_t *err = gc_alloc(OBJECT_ERROR);
-          error_t_format_err(
-              err->err_value, operator, "postfix operator cannot be found",
-              "increment(++) and decrement(--) operators are the only "
-              "postfix operators permitted");
-          return err;
-        }; break;
-        }
-      } else if (res->type == OBJECT_DOUBLE) {
-        switch (operator->type) {
-        case INC: {
-          struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-          obj->int_value = res->int_value;
-          res->int_value += 1;
-          return obj;
-        }; break;
-        case DEC: {
-          struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
-          obj->int_value = res->int_value;
-          res->int_value -= 1;
-          return obj;
-        }; break;
-        default: {
-          struct obj_t *err = gc_alloc(OBJECT_ERROR);
-          error_t_format_err(
-              err->err_value, operator, "postfix operator cannot be found",
-              "increment(++) and decrement(--) operators are the only "
-              "postfix operators permitted");
-          return err;
-        }; break;
-        }
-      } else {
+      int delta;
+      switch (operator->type) {
+      case INC: {
+        delta = 1;
+      }; break;
+      case DEC: {
+        delta = -1;
+      }; break;
+      default: {
         struct obj_t *err = gc_alloc(OBJECT_ERROR);
         error_t_format_err(
-            err->err_value, operator,
-            "operation not permitted on non numerical identifiers",
-            "operation only permitted on integer or floating point "
-            "indetifiers(variables)");
+            err->err_value, operator, "postfix operator cannot be found",
+            "increment(++) and decrement(--) operators are the only "
+            "postfix operators permitted");
         return err;
+      }; break;
+      }
+      struct obj_t *res = evaluate_step(env, left, operator, delta);
+      if (res) {
+        return res;
       }
+      struct obj_t *err = gc_alloc(OBJECT_ERROR);
+      error_t_format_err(
+          err->err_value, operator,
+          "operation not permitted on non numerical identifiers",
+          "operation only permitted on integer or floating point "
+          "indetifiers(variables)");
+      return err;
     } else {
       struct obj_t *err = gc_alloc(OBJECT_ERROR);
       error_t_format_err(
@@ -867,4 +1499,6 @@ bool is_truthy(struct obj_t *object) {
   }
 }
 
-bool has_error(struct obj_t *obj) { return obj && (obj->type == OBJECT_ERROR); }
+bool has_error(struct obj_t *obj) {
+  return obj && object_t_type(obj) == OBJECT_ERROR;
+}
@@ -0,0 +1,127 @@
+#include "fuse.h"
+#include "ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// clang-format off
+
+static void fuse_statements(struct statement **, size_t);
+static void fuse_statement(struct statement *);
+static void fuse_block(struct block_statement *);
+static void fuse_expression(struct expression *);
+static bool is_identifier(struct expression *);
+static bool is_fusable_literal(struct expression *);
+
+// clang-format on
+
+void fuse_program(struct program *program) {
+  if (program) {
+    fuse_statements(program->statements, program->statement_count);
+  }
+}
+
+static void fuse_statements(struct statement **stmts, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    fuse_statement(stmts[i]);
+  }
+}
+
+static void fuse_block(struct block_statement *block) {
+  if (block) {
+    fuse_statements(block->statements, block->statement_count);
+  }
+}
+
+static void fuse_statement(struct statement *stmt) {
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    fuse_expression(stmt->let_stmt.value);
+  }; break;
+  case STMT_RETURN: {
+    if (is_identifier(stmt->return_stmt.value)) {
+      stmt->fused = FUSED_RETURN_NAME;
+    } else {
+      fuse_expression(stmt->return_stmt.value);
+    }
+  }; break;
+  case STMT_EXPRESSION: {
+    fuse_expression(stmt->expr_stmt.expr);
+  }; break;
+  case STMT_FUNCTION_DEF: {
+    fuse_block(stmt->fn_def_stmt.body);
+  }; break;
+  }
+}
+
+static void fuse_expression(struct expression *expr) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+  case EXPR_POSTFIX:
+    break;
+  case EXPR_PREFIX: {
+    fuse_expression(expr->prefix_expr.right);
+  }; break;
+  case EXPR_INFIX: {
+    if (is_identifier(expr->infix_expr.left)) {
+      if (is_identifier(expr->infix_expr.right)) {
+        expr->fused = FUSED_NAME_NAME;
+        break;
+      } else if (is_fusable_literal(expr->infix_expr.right)) {
+        expr->fused = FUSED_NAME_LITERAL;
+        break;
+      }
+    }
+    fuse_expression(expr->infix_expr.left);
+    fuse_expression(expr->infix_expr.right);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    fuse_expression(expr->conditional.condition);
+    fuse_block(expr->conditional.consequence);
+    fuse_block(expr->conditional.alternative);
+  }; break;
+  case EXPR_LOOP: {
+    fuse_statement(expr->loop.init);
+    fuse_expression(expr->loop.condition);
+    fuse_expression(expr->loop.update);
+    fuse_block(expr->loop.body);
+  }; break;
+  case EXPR_FUNCTION: {
+    fuse_block(expr->function.body);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    bool names = is_identifier(expr->function_call.function) &&
+                 expr->function_call.arg_count <= FUSED_CALL_MAX_ARGS;
+    for (size_t i = 0; names && i < expr->function_call.arg_count; i++) {
+      names = is_identifier(expr->function_call.arguments[i]);
+    }
+    if (names) {
+      expr->fused = FUSED_CALL_NAMES;
+      break;
+    }
+    fuse_expression(expr->function_call.function);
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      fuse_expression(expr->function_call.arguments[i]);
+    }
+  }; break;
+  }
+}
+
+static bool is_identifier(struct expression *expr) {
+  return expr && expr->type == EXPR_IDENTIFIER;
+}
+
+/**
+ * string literals own their data, the other literals fit in an object on
+ * the stack of the evaluator
+ */
+static bool is_fusable_literal(struct expression *expr) {
+  return expr && expr->type == EXPR_LITERAL &&
+         expr->literal.literal_type != LITERAL_STRING;
+}
@@ -1,103 +1,473 @@
 #include "gc.h"
 #include "environment.h"
 #include "object_t.h"
+#include "slab.h"
+#include "util_error.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 // Static objects
-static const struct obj_t OBJ_SENTINEL = {
-    .type = OBJECT_SENTINEL, .gc_next = NULL, .marked = false};
-static const struct obj_t OBJ_TRUE = {
-    .type = OBJECT_BOOL, .bool_value = true, .gc_next = NULL, .marked = false};
-static const struct obj_t OBJ_FALSE = {
-    .type = OBJECT_BOOL, .bool_value = false, .gc_next = NULL, .marked = false};
+static const struct obj_t OBJ_SENTINEL = {.type = OBJECT_SENTINEL,
+                                          .gc_next = NULL,
+                                          .forwarded = false,
+                                          .immortal = true};
 
-// Starting point of all objects tracked by GC
-static struct obj_t *gc_object_list = NULL;
+/**
+ * young generation, objects are bump allocated from nursery_top. a young
+ * object is forwarded once it was copied to the old generation, gc_next
+ * then points to the copy
+ */
+struct obj_t *gc_nursery_start = NULL;
+struct obj_t *gc_nursery_end = NULL;
+static struct obj_t *nursery_top = NULL;
+
+/**
+ * the old generation is the object slab (object_t.h), the mark bits are in
+ * the bitmaps of its chunks. old_count is what the last major collection
+ * marked plus what was allocated since, the dead objects the lazy sweep has
+ * not freed yet are not counted
+ */
+static size_t old_count = 0;
+static size_t marked_count = 0; // by the current major collection
+static size_t major_threshold = GC_MAJOR_MIN;
+
+/**
+ * marking of the old generation, gray objects wait on the gray stack. the
+ * environment marking started from is marked then and its later changes go
+ * through the write barrier, so it is not marked again through the closures
+ */
+bool gc_marking = false;
+static struct {
+  struct obj_t **objects;
+  size_t count;
+  size_t capacity;
+} gray_stack = {NULL, 0, 0};
+static struct environment *mark_root = NULL;
+static size_t step_budget = GC_STEP_BUDGET;
+static size_t allocations = 0; // since the last increment
+
+static struct gc_stats stats = {0, 0, 0, 0, 0, 0};
+
+bool gc_requested = false;
+
+struct gc_root_stack gc_root_stack = {NULL, 0, 0, 0};
+
+/**
+ * what gc_visit does with the roots: copy the young ones out of the
+ * nursery, or shade them. environments are marked when marking starts,
+ * once it has the write barrier keeps them up to date
+ */
+static enum {
+  VISIT_EVACUATE,
+  VISIT_MARK,
+  VISIT_REMARK,
+} visit_mode;
+static bool visit_failed = false; // an evacuation found no memory
+
+/**
+ * environments that were given a young object since the last minor
+ * collection, env->remembered is its index + 1
+ */
+static struct {
+  struct environment **envs;
+  size_t count;
+  size_t capacity;
+} remembered_set = {NULL, 0, 0};
+
+// clang-format off
+
+static bool gc_nursery_init();
+static struct obj_t *gc_alloc_old(enum OBJECT_TYPE type);
+static struct obj_t *gc_evacuate(struct obj_t *obj, bool *failed);
+static void gc_evacuate_environment(struct environment *env, bool *failed);
+static void gc_minor();
+static void gc_visit_roots();
+static struct environment *gc_root_environment();
+static void gc_mark_step(size_t budget);
+static void gc_finish_major();
+static uint64_t gc_now();
+static void gc_record_pause(uint64_t start);
+
+// clang-format on
 
 struct obj_t *gc_alloc(enum OBJECT_TYPE type) {
   if (type == OBJECT_SENTINEL) {
     return (struct obj_t *)&OBJ_SENTINEL;
   } else if (type == OBJECT_BOOL_TRUE) {
-    return (struct obj_t *)&OBJ_TRUE;
+    return OBJECT_TRUE;
   } else if (type == OBJECT_BOOL_FALSE) {
-    return (struct obj_t *)&OBJ_FALSE;
+    return OBJECT_FALSE;
   } else {
-    struct obj_t *obj = object_t_init(type);
-    if (!obj) {
+    stats.allocated++;
+    if (gc_marking && ++allocations >= GC_STEP_INTERVAL) {
+      allocations = 0;
+      uint64_t start = gc_now();
+      gc_mark_step(step_budget);
+      stats.increments++;
+      gc_record_pause(start);
+    }
+    if (nursery_top == gc_nursery_end &&
+        (gc_nursery_start || !gc_nursery_init())) {
+      gc_requested = true;
+      return gc_alloc_old(type); // full until the next minor collection
+    }
+    struct obj_t *obj = nursery_top;
+    if (!object_t_init_in(obj, type)) {
       return NULL;
     }
-    obj->gc_next = gc_object_list;
-    gc_object_list = obj;
+    nursery_top++;
+    return obj;
+  }
+}
+
+struct obj_t *gc_alloc_double(double value) {
+  struct obj_t *obj = gc_alloc(OBJECT_DOUBLE);
+  if (obj) {
+    obj->double_value = value;
+  }
+  return obj;
+}
+
+static bool gc_nursery_init() {
+  gc_nursery_start = malloc(sizeof(struct obj_t) * GC_NURSERY_SIZE);
+  if (!gc_nursery_start) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  gc_nursery_end = gc_nursery_start + GC_NURSERY_SIZE;
+  nursery_top = gc_nursery_start;
+  return true;
+}
+
+static struct obj_t *gc_alloc_old(enum OBJECT_TYPE type) {
+  struct obj_t *obj = object_t_init(type);
+  if (!obj) {
+    return NULL;
+  }
+  old_count++;
+  if (gc_marking) {
+    gc_shade(obj); // its fields are set before the gray stack gets to it
+  }
+  return obj;
+}
+
+void gc_remember_environment(struct environment *env) {
+  if (remembered_set.count == remembered_set.capacity) {
+    size_t capacity =
+        remembered_set.capacity ? remembered_set.capacity * 2 : 64;
+    struct environment **envs = realloc(
+        remembered_set.envs, sizeof(struct environment *) * capacity);
+    if (!envs) {
+      ERROR_LOG("error while allocating memory\n");
+      return;
+    }
+    remembered_set.envs = envs;
+    remembered_set.capacity = capacity;
+  }
+  remembered_set.envs[remembered_set.count++] = env;
+  env->remembered = remembered_set.count;
+}
+
+void gc_forget_environment(struct environment *env) {
+  // the last environment of the set takes the place of env
+  struct environment *last = remembered_set.envs[--remembered_set.count];
+  remembered_set.envs[env->remembered - 1] = last;
+  last->remembered = env->remembered;
+  env->remembered = 0;
+}
+
+/**
+ * the old copy of a young object, obj itself for old and immortal objects.
+ * failed is set when there was no memory for a copy, obj stays young then.
+ * the environment of a young function needs no scan, it is remembered if
+ * it holds young objects
+ */
+static struct obj_t *gc_evacuate(struct obj_t *obj, bool *failed) {
+  if (!gc_is_young(obj)) {
     return obj;
   }
+  if (obj->forwarded) {
+    return obj->gc_next; // copied already
+  }
+  struct obj_t *copy = object_t_alloc();
+  if (!copy) {
+    *failed = true;
+    return obj;
+  }
+  *copy = *obj;
+  old_count++;
+  obj->forwarded = true;
+  obj->gc_next = copy;
+  if (copy->type == OBJECT_RETURN) {
+    copy->return_value.value = gc_evacuate(copy->return_value.value, failed);
+  }
+  if (gc_marking) {
+    gc_shade(copy); // young objects were not marked, nor what they refer to
+  }
+  return copy;
+}
+
+static void gc_evacuate_environment(struct environment *env, bool *failed) {
+  if (env->symbols) {
+    for (size_t i = 0; i < env->symbols->capacity; i++) {
+      for (entry *e = env->symbols->buckets[i]; e; e = e->next) {
+        e->value = gc_evacuate(e->value, failed);
+      }
+    }
+  }
+  if (env->slots) {
+    for (size_t i = 0; i < env->scope->count; i++) {
+      env->slots[i] = gc_evacuate(env->slots[i], failed);
+    }
+  }
 }
 
-static void gc_mark(struct obj_t *obj) {
-  if (!obj || obj->marked || obj->type == OBJECT_SENTINEL ||
-      obj->type == OBJECT_BOOL) {
+/**
+ * copy the young objects the remembered environments and the roots refer to
+ * into the old generation and empty the nursery
+ */
+static void gc_minor() {
+  bool failed = false;
+  for (size_t i = 0; i < remembered_set.count; i++) {
+    gc_evacuate_environment(remembered_set.envs[i], &failed);
+  }
+  visit_mode = VISIT_EVACUATE;
+  visit_failed = false;
+  gc_visit_roots();
+  if (failed || visit_failed) {
+    // some objects are still young, keep the nursery and the environments
+    // referring to them until the next minor collection
     return;
   }
-  obj->marked = true;
-
-  // recursively mark child objects
-  switch (obj->type) {
-    /*
-            case OBJECT_LIST:
-            for (int i = 0; i < obj->list_length; i++) {
-                gc_mark(obj->list_elements[i]);
-            }
-            break;
-        case OBJECT_CLOSURE:
-            gc_mark_environment(obj->closure.env);
-            break;
-     */
-  case OBJECT_FUNCTION: {
-    gc_mark_environment(obj->function_value.env);
-  }; break;
-  case OBJECT_RETURN: {
-    gc_mark(obj->return_value.value);
-  }; break;
-  default: {
-  }; break;
+  for (size_t i = 0; i < remembered_set.count; i++) {
+    remembered_set.envs[i]->remembered = 0;
+  }
+  remembered_set.count = 0;
+  for (struct obj_t *obj = gc_nursery_start; obj < nursery_top; obj++) {
+    if (!obj->forwarded) {
+      object_t_free_fields(obj); // unreached, the copy owns them otherwise
+    }
+  }
+  nursery_top = gc_nursery_start;
+}
+
+bool gc_grow_root_stack() {
+  size_t capacity = gc_root_stack.capacity ? gc_root_stack.capacity * 2 : 256;
+  struct gc_root *roots =
+      realloc(gc_root_stack.roots, sizeof(struct gc_root) * capacity);
+  if (!roots) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  gc_root_stack.roots = roots;
+  gc_root_stack.capacity = capacity;
+  return true;
+}
+
+static void gc_visit_roots() {
+  for (size_t i = 0; i < gc_root_stack.count; i++) {
+    struct gc_root *root = &gc_root_stack.roots[i];
+    switch (root->kind) {
+    case GC_ROOT_OBJECTS: {
+      for (size_t j = 0; j < root->objects.count; j++) {
+        gc_visit(&root->objects.values[j]);
+      }
+    }; break;
+    case GC_ROOT_ENVIRONMENT: {
+      gc_visit_environment(root->env);
+    }; break;
+    case GC_ROOT_VISITOR: {
+      root->visitor.visit(root->visitor.data);
+    }; break;
+    }
+  }
+}
+
+void gc_visit(struct obj_t **value) {
+  if (!*value) {
+    return;
+  }
+  if (visit_mode == VISIT_EVACUATE) {
+    *value = gc_evacuate(*value, &visit_failed);
+  } else {
+    gc_shade(*value);
+  }
+}
+
+void gc_visit_environment(struct environment *env) {
+  if (visit_mode == VISIT_MARK) {
+    gc_mark_environment(env);
+  }
+}
+
+/**
+ * the environment pushed first, the one of the program
+ */
+static struct environment *gc_root_environment() {
+  for (size_t i = 0; i < gc_root_stack.count; i++) {
+    if (gc_root_stack.roots[i].kind == GC_ROOT_ENVIRONMENT) {
+      return gc_root_stack.roots[i].env;
+    }
+  }
+  return NULL;
+}
+
+void gc_shade(struct obj_t *obj) {
+  if (!obj || object_t_is_immediate(obj) || obj->immortal ||
+      gc_is_young(obj) || !slab_mark(obj)) {
+    return; // immediate, immortal and young objects are not in the slab
+  }
+  marked_count++;
+  if (obj->type != OBJECT_FUNCTION && obj->type != OBJECT_RETURN) {
+    return; // no references, black right away
+  }
+  if (gray_stack.count == gray_stack.capacity) {
+    size_t capacity = gray_stack.capacity ? gray_stack.capacity * 2 : 256;
+    struct obj_t **objects =
+        realloc(gray_stack.objects, sizeof(struct obj_t *) * capacity);
+    if (!objects) {
+      // without a gray stack the object is marked through right away
+      ERROR_LOG("error while allocating memory\n");
+      if (obj->type == OBJECT_FUNCTION) {
+        gc_mark_environment(obj->function_value.env);
+      } else {
+        gc_shade(obj->return_value.value);
+      }
+      return;
+    }
+    gray_stack.objects = objects;
+    gray_stack.capacity = capacity;
+  }
+  gray_stack.objects[gray_stack.count++] = obj;
+}
+
+/**
+ * make the gray objects black until budget of them are, a budget of 0 runs
+ * until the gray stack is empty
+ */
+static void gc_mark_step(size_t budget) {
+  for (size_t done = 0;
+       gray_stack.count > 0 && (budget == 0 || done < budget); done++) {
+    struct obj_t *obj = gray_stack.objects[--gray_stack.count];
+
+    // recursively mark child objects
+    switch (obj->type) {
+      /*
+              case OBJECT_LIST:
+              for (int i = 0; i < obj->list_length; i++) {
+                  gc_shade(obj->list_elements[i]);
+              }
+              break;
+       */
+    case OBJECT_FUNCTION: {
+      gc_mark_environment(obj->function_value.env);
+    }; break;
+    case OBJECT_RETURN: {
+      gc_shade(obj->return_value.value);
+    }; break;
+    default: {
+    }; break;
+    }
   }
 }
 
 void gc_mark_environment(struct environment *env) {
   if (env) {
     struct environment *current_env = env;
-    while (current_env) {
-      hash_table_iterator it = hash_table_iterate(env->symbols);
-      const char *key;
-      struct obj_t *value;
-      while (hash_table_next(&it, &key, (void **)&value)) {
-        gc_mark(value);
+    // the root was marked when marking started
+    while (current_env && current_env != mark_root) {
+      if (current_env->symbols) {
+        hash_table_iterator it = hash_table_iterate(current_env->symbols);
+        const char *key;
+        struct obj_t *value;
+        while (hash_table_next(&it, &key, (void **)&value)) {
+          gc_shade(value);
+        }
+      }
+      if (current_env->slots) {
+        for (size_t i = 0; i < current_env->scope->count; i++) {
+          gc_shade(current_env->slots[i]);
+        }
       }
       current_env = current_env->parent;
     }
   }
 }
 
-static void gc_sweep() {
-  struct obj_t **curr = &gc_object_list;
-  while (*curr) {
-    if (!(*curr)->marked && (*curr)->type != OBJECT_SENTINEL &&
-        (*curr)->type != OBJECT_BOOL) {
-      // unmarked objects are considered unused -> free them
-      struct obj_t *unreached = *curr;
-      *curr = unreached->gc_next;
-      object_t_free(unreached);
-    } else {
-      // reset mark for next cycle -> if not marked in the next then cleaned up
-      (*curr)->marked = false;
-      curr = &(*curr)->gc_next;
-    }
-  }
+/**
+ * mark what is left gray, the unmarked objects are freed by the lazy sweep
+ * of the object slab as its chunks are needed again
+ */
+static void gc_finish_major() {
+  gc_mark_step(0);
+  slab_start_sweep(&object_slab);
+  gc_marking = false;
+  mark_root = NULL;
+  old_count = marked_count;
+  major_threshold =
+      old_count * 2 > GC_MAJOR_MIN ? old_count * 2 : GC_MAJOR_MIN;
+  stats.major_collections++;
 }
 
 /**
- * run a full gc cycle
+ * run a gc cycle, marking of the old generation starts once it has doubled
+ * since the last major collection and goes on in the increments of
+ * gc_alloc until the next cycle. the roots on the shadow root stack are
+ * shaded again before the sweep, stores into them have no barrier
  */
 void gc_collect(struct environment *env) {
-  gc_mark_environment(env); // first perform marking
-  gc_sweep();               // then sweep unused objects
+  if (gc_root_stack.lost) {
+    return; // a root is missing, wait until it is popped
+  }
+  uint64_t start = gc_now();
+  gc_requested = false;
+  gc_minor();
+  stats.minor_collections++;
+  if (gc_marking) {
+    visit_mode = VISIT_REMARK;
+    gc_visit_roots();
+    gc_finish_major();
+  } else if (old_count >= major_threshold) {
+    slab_finish_sweep(&object_slab); // so that no chunk has marks left
+    gc_marking = true;
+    marked_count = 0;
+    allocations = 0;
+    mark_root = NULL;
+    gc_mark_environment(env); // first mark the roots gray
+    visit_mode = VISIT_MARK;
+    gc_visit_roots();
+    mark_root = env ? env : gc_root_environment();
+    if (step_budget == 0) {
+      gc_finish_major();
+    }
+  }
+  gc_record_pause(start);
+}
+
+void gc_set_step_budget(size_t budget) { step_budget = budget; }
+
+const struct gc_stats *gc_get_stats() { return &stats; }
+
+void gc_print_stats(FILE *out) {
+  fprintf(out,
+          "gc: %zu minor and %zu major collections, %zu increments, "
+          "max pause %.3f ms, total %.3f ms, %zu KiB of object chunks\n",
+          stats.minor_collections, stats.major_collections, stats.increments,
+          stats.max_pause_ns / 1e6, stats.total_pause_ns / 1e6,
+          object_slab.chunk_count * SLAB_CHUNK_SIZE / 1024);
+}
+
+static uint64_t gc_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void gc_record_pause(uint64_t start) {
+  uint64_t pause = gc_now() - start;
+  stats.total_pause_ns += pause;
+  if (pause > stats.max_pause_ns) {
+    stats.max_pause_ns = pause;
+  }
 }
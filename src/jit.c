@@ -0,0 +1,909 @@
+#include "jit.h"
+#include "ast.h"
+#include "environment.h"
+#include "gc.h"
+#include "object_t.h"
+#include "token.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_MAX_PARAMS 16
+#define JIT_MAX_SLOTS 64
+#define JIT_MAX_BAILOUTS 16
+#define JIT_INITIAL_CODE_SIZE 256
+#define JIT_MAX_STACK (1024 * 1024) // bytes of stack native self calls can use
+#define JIT_DEEP_CALLS 4096 // calls interpreted after the native code was too deep
+
+/**
+ * types a native value can have, JIT_NEVER is the "type" of a return
+ * statement (control does not reach the end of it)
+ */
+enum JIT_TYPE {
+  JIT_NONE,
+  JIT_INT,
+  JIT_DOUBLE,
+  JIT_BOOL,
+  JIT_NEVER,
+};
+
+// what the entry point of the generated code returns
+enum JIT_EXIT {
+  JIT_BAILED_OUT, // a guard failed
+  JIT_RAN,        // the body ran to completion, the result is stored
+  JIT_TOO_DEEP,   // the self calls used up JIT_MAX_STACK
+};
+
+typedef enum JIT_EXIT (*jit_entry)(uint64_t *args, uint64_t *result);
+
+struct jit_function {
+  bool failed; // not compilable, or bailed out too often
+  size_t bailouts;
+  size_t deep_calls; // calls left to interpret after JIT_TOO_DEEP
+  enum JIT_TYPE params[JIT_MAX_PARAMS];
+  size_t param_count;
+  enum JIT_TYPE result;
+  char *self_name; // name the body calls itself by, borrowed from the ast
+  jit_entry entry;
+  void *pages;
+  size_t size;
+};
+
+static bool jit_enabled = JIT_SUPPORTED;
+
+void jit_set_enabled(bool enabled) { jit_enabled = enabled && JIT_SUPPORTED; }
+
+bool jit_is_enabled() { return jit_enabled; }
+
+#if JIT_SUPPORTED
+
+/**
+ * jit_compiler keeps the state needed while emitting the code of a single
+ * function, values are computed into rax (ints in eax, doubles as raw bits,
+ * bools as 0/1) and parameters and lets live in 8 byte slots below rbp
+ */
+struct jit_compiler {
+  uint8_t *code;
+  size_t count;
+  size_t capacity;
+
+  struct obj_t *function;
+  char *names[JIT_MAX_SLOTS]; // borrowed
+  enum JIT_TYPE types[JIT_MAX_SLOTS];
+  bool assigned[JIT_MAX_SLOTS];
+  size_t slot_count;
+
+  enum JIT_TYPE result; // result type the body is compiled for
+  char *self_name;
+
+  size_t bailout;    // offset of the bailout path of the entry stub
+  size_t too_deep;   // offset of the path taken when the stack is used up
+  size_t body;       // offset of the body
+  size_t start;      // offset of the body after the parameters are stored
+  size_t frame_size; // offset of the imm32 of the frame allocation
+  size_t *returns;   // rel32 offsets of the jumps to the epilogue
+  size_t return_count;
+  size_t return_capacity;
+  bool failed;
+};
+
+// clang-format off
+
+static struct jit_function *jit_compile(struct obj_t *function, struct obj_t **args);
+static bool jit_compile_body(struct jit_compiler *, struct jit_function *);
+static bool jit_install(struct jit_compiler *, struct jit_function *);
+static enum JIT_TYPE jit_type_of(struct obj_t *);
+
+static void emit(struct jit_compiler *, const uint8_t *bytes, size_t count);
+static void emit_u32(struct jit_compiler *, uint32_t);
+static void emit_u64(struct jit_compiler *, uint64_t);
+static size_t emit_rel32(struct jit_compiler *);
+static void patch_rel32(struct jit_compiler *, size_t at, size_t target);
+static void emit_bailout_if_equal(struct jit_compiler *);
+static void emit_load_slot(struct jit_compiler *, size_t slot);
+static void emit_store_slot(struct jit_compiler *, size_t slot);
+
+static int find_slot(struct jit_compiler *, const char *);
+static int define_slot(struct jit_compiler *, char *, enum JIT_TYPE);
+
+static enum JIT_TYPE compile_block(struct jit_compiler *, struct block_statement *, bool want_value, bool tail);
+static enum JIT_TYPE compile_statement(struct jit_compiler *, struct statement *, bool want_value, bool tail);
+static enum JIT_TYPE compile_expression(struct jit_compiler *, struct expression *);
+static enum JIT_TYPE compile_conditional(struct jit_compiler *, struct expression *, bool want_value, bool tail);
+static enum JIT_TYPE compile_infix(struct jit_compiler *, struct expression *);
+static enum JIT_TYPE compile_prefix(struct jit_compiler *, struct expression *);
+static enum JIT_TYPE compile_call(struct jit_compiler *, struct expression *, bool tail);
+static bool is_call(struct expression *);
+
+// clang-format on
+
+#define EMIT(jc, ...)                                                          \
+  emit((jc), (const uint8_t[]){__VA_ARGS__},                                   \
+       sizeof((const uint8_t[]){__VA_ARGS__}))
+
+bool jit_try_call(struct obj_t *function, struct obj_t **args,
+                  size_t arg_count, struct obj_t **result) {
+  if (!jit_enabled || !function || object_t_type(function) != OBJECT_FUNCTION) {
+    return false;
+  }
+  // compiled once per fn literal, the guards below hold for every closure
+  struct function_proto *proto = function->function_value.proto;
+  struct jit_function *jit = proto->jit;
+  if (!jit) {
+    if (++proto->call_count < JIT_HOT_CALLS || arg_count < proto->param_count) {
+      return false;
+    }
+    jit = jit_compile(function, args);
+    proto->jit = jit;
+    if (!jit) {
+      return false;
+    }
+  }
+  if (jit->failed || arg_count < jit->param_count) {
+    return false;
+  }
+  if (jit->deep_calls) {
+    // the interpreter takes the recursion deeper before native code resumes
+    jit->deep_calls--;
+    return false;
+  }
+
+  // guards: the arguments have the types the code was compiled for, and
+  // the name the body calls itself by still refers to this function
+  uint64_t native_args[JIT_MAX_PARAMS];
+  for (size_t i = 0; i < jit->param_count; i++) {
+    struct obj_t *arg = args[i];
+    if (jit_type_of(arg) != jit->params[i]) {
+      return false;
+    }
+    switch (jit->params[i]) {
+    case JIT_INT:
+      native_args[i] = (uint32_t)object_t_int(arg);
+      break;
+    case JIT_DOUBLE: {
+      double number = object_t_double(arg);
+      memcpy(&native_args[i], &number, sizeof(double));
+    }; break;
+    case JIT_BOOL:
+      native_args[i] = arg == gc_alloc(OBJECT_BOOL_TRUE);
+      break;
+    default:
+      return false;
+    }
+  }
+  if (jit->self_name &&
+      env_look_up(function->function_value.env, jit->self_name) != function) {
+    return false;
+  }
+
+  uint64_t value;
+  switch (jit->entry(native_args, &value)) {
+  case JIT_RAN:
+    break;
+  case JIT_BAILED_OUT:
+    if (++jit->bailouts >= JIT_MAX_BAILOUTS) {
+      jit->failed = true;
+    }
+    return false;
+  case JIT_TOO_DEEP:
+    jit->deep_calls = JIT_DEEP_CALLS;
+    return false;
+  }
+
+  switch (jit->result) {
+  case JIT_INT: {
+    struct obj_t *obj = gc_int((int32_t)(uint32_t)value);
+    if (!obj) {
+      return false;
+    }
+    *result = obj;
+  }; break;
+  case JIT_DOUBLE: {
+    double number;
+    memcpy(&number, &value, sizeof(double));
+    struct obj_t *obj = gc_double(number);
+    if (!obj) {
+      return false;
+    }
+    *result = obj;
+  }; break;
+  case JIT_BOOL: {
+    *result = value & 1 ? gc_alloc(OBJECT_BOOL_TRUE)
+                        : gc_alloc(OBJECT_BOOL_FALSE);
+  }; break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+static enum JIT_TYPE jit_type_of(struct obj_t *obj) {
+  if (!obj) {
+    return JIT_NONE;
+  }
+  switch (object_t_type(obj)) {
+  case OBJECT_INT:
+    return JIT_INT;
+  case OBJECT_DOUBLE:
+    return JIT_DOUBLE;
+  case OBJECT_BOOL:
+  case OBJECT_BOOL_TRUE:
+  case OBJECT_BOOL_FALSE:
+    return JIT_BOOL;
+  default:
+    return JIT_NONE;
+  }
+}
+
+/**
+ * compile the function for the types of args. the result type is not
+ * known up front (a recursive call returns it), so the body is compiled
+ * for each candidate until one type checks
+ */
+static struct jit_function *jit_compile(struct obj_t *function,
+                                        struct obj_t **args) {
+  struct jit_function *jit = calloc(1, sizeof(struct jit_function));
+  if (!jit) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  jit->failed = true;
+  size_t param_count = function->function_value.proto->param_count;
+  if (param_count > JIT_MAX_PARAMS) {
+    return jit;
+  }
+  jit->param_count = param_count;
+  for (size_t i = 0; i < param_count; i++) {
+    jit->params[i] = jit_type_of(args[i]);
+    if (jit->params[i] == JIT_NONE) {
+      return jit;
+    }
+  }
+
+  const enum JIT_TYPE candidates[] = {JIT_INT, JIT_DOUBLE, JIT_BOOL};
+  for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+    struct jit_compiler jc = {.function = function, .result = candidates[i]};
+    bool compiled = jit_compile_body(&jc, jit) && jit_install(&jc, jit);
+    free(jc.code);
+    free(jc.returns);
+    if (compiled) {
+      jit->result = candidates[i];
+      jit->self_name = jc.self_name;
+      jit->failed = false;
+      break;
+    }
+  }
+  return jit;
+}
+
+/**
+ * layout of the code:
+ *
+ *   entry:    save rbp, rbx, r12, keep the result pointer in rbx and the
+ *             stack pointer in r12, call body, store rax, return JIT_RAN
+ *   bailout:  restore the stack pointer from r12, return JIT_BAILED_OUT
+ *   too_deep: restore the stack pointer from r12, return JIT_TOO_DEEP
+ *   body:     the function itself, args pointer in rdi, result in rax. it
+ *             goes to too_deep once the self calls on top of the entry use
+ *             more than JIT_MAX_STACK bytes, and a tail self call jumps
+ *             back to start
+ */
+static bool jit_compile_body(struct jit_compiler *jc,
+                             struct jit_function *jit) {
+  EMIT(jc, 0x55, 0x53, 0x41, 0x54); // push rbp, push rbx, push r12
+  EMIT(jc, 0x48, 0x89, 0xf3);       // mov rbx, rsi
+  EMIT(jc, 0x49, 0x89, 0xe4);       // mov r12, rsp
+  EMIT(jc, 0xe8);                   // call body
+  size_t call_body = emit_rel32(jc);
+  EMIT(jc, 0x48, 0x89, 0x03);       // mov [rbx], rax
+  EMIT(jc, 0xb8);                   // mov eax, JIT_RAN
+  emit_u32(jc, JIT_RAN);
+  EMIT(jc, 0xe9);                   // jmp done
+  size_t ran_to_done = emit_rel32(jc);
+
+  jc->bailout = jc->count;
+  EMIT(jc, 0x4c, 0x89, 0xe4); // mov rsp, r12
+  EMIT(jc, 0xb8);             // mov eax, JIT_BAILED_OUT
+  emit_u32(jc, JIT_BAILED_OUT);
+  EMIT(jc, 0xe9);             // jmp done
+  size_t bailout_to_done = emit_rel32(jc);
+
+  jc->too_deep = jc->count;
+  EMIT(jc, 0x4c, 0x89, 0xe4); // mov rsp, r12
+  EMIT(jc, 0xb8);             // mov eax, JIT_TOO_DEEP
+  emit_u32(jc, JIT_TOO_DEEP);
+  patch_rel32(jc, ran_to_done, jc->count);
+  patch_rel32(jc, bailout_to_done, jc->count);
+  EMIT(jc, 0x41, 0x5c, 0x5b, 0x5d, 0xc3); // pop r12, pop rbx, pop rbp, ret
+
+  jc->body = jc->count;
+  patch_rel32(jc, call_body, jc->body);
+  EMIT(jc, 0x55);             // push rbp
+  EMIT(jc, 0x48, 0x89, 0xe5); // mov rbp, rsp
+  EMIT(jc, 0x48, 0x81, 0xec); // sub rsp, frame size
+  jc->frame_size = jc->count;
+  emit_u32(jc, 0);
+  EMIT(jc, 0x4c, 0x89, 0xe0); // mov rax, r12
+  EMIT(jc, 0x48, 0x29, 0xe0); // sub rax, rsp
+  EMIT(jc, 0x48, 0x3d);       // cmp rax, JIT_MAX_STACK
+  emit_u32(jc, JIT_MAX_STACK);
+  EMIT(jc, 0x0f, 0x87);       // ja too_deep
+  patch_rel32(jc, emit_rel32(jc), jc->too_deep);
+
+  for (size_t i = 0; i < jit->param_count; i++) {
+    char *name = jc->function->function_value.proto->parameters[i]->id;
+    int slot = define_slot(jc, name, jit->params[i]);
+    if (slot != (int)i) {
+      // parameters take the first slots, a repeated name does not
+      return false;
+    }
+    jc->assigned[slot] = true;
+    EMIT(jc, 0x48, 0x8b, 0x87); // mov rax, [rdi + 8 * i]
+    emit_u32(jc, 8 * i);
+    emit_store_slot(jc, slot);
+  }
+  jc->start = jc->count;
+
+  enum JIT_TYPE type =
+      compile_block(jc, jc->function->function_value.proto->body, true, true);
+  if (type != JIT_NEVER && type != jc->result) {
+    return false;
+  }
+
+  size_t epilogue = jc->count;
+  for (size_t i = 0; i < jc->return_count; i++) {
+    patch_rel32(jc, jc->returns[i], epilogue);
+  }
+  EMIT(jc, 0x48, 0x89, 0xec); // mov rsp, rbp
+  EMIT(jc, 0x5d, 0xc3);       // pop rbp, ret
+
+  if (!jc->failed) {
+    uint32_t frame_size = 8 * jc->slot_count;
+    memcpy(jc->code + jc->frame_size, &frame_size, sizeof(uint32_t));
+  }
+  return !jc->failed;
+}
+
+/**
+ * copy the code into its own pages and make them executable (but no
+ * longer writable)
+ */
+static bool jit_install(struct jit_compiler *jc, struct jit_function *jit) {
+  void *pages = mmap(NULL, jc->count, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    ERROR_LOG("error while mapping memory for the jit\n");
+    return false;
+  }
+  memcpy(pages, jc->code, jc->count);
+  if (mprotect(pages, jc->count, PROT_READ | PROT_EXEC) != 0) {
+    ERROR_LOG("error while protecting memory for the jit\n");
+    munmap(pages, jc->count);
+    return false;
+  }
+  jit->pages = pages;
+  jit->size = jc->count;
+  jit->entry = (jit_entry)pages;
+  return true;
+}
+
+// ========================================================================
+
+static void emit(struct jit_compiler *jc, const uint8_t *bytes,
+                 size_t count) {
+  if (jc->failed) {
+    return;
+  }
+  if (jc->count + count > jc->capacity) {
+    size_t capacity = jc->capacity ? jc->capacity : JIT_INITIAL_CODE_SIZE;
+    while (capacity < jc->count + count) {
+      capacity *= 2;
+    }
+    uint8_t *code = realloc(jc->code, capacity);
+    if (!code) {
+      ERROR_LOG("error while allocating memory\n");
+      jc->failed = true;
+      return;
+    }
+    jc->code = code;
+    jc->capacity = capacity;
+  }
+  memcpy(jc->code + jc->count, bytes, count);
+  jc->count += count;
+}
+
+static void emit_u32(struct jit_compiler *jc, uint32_t value) {
+  uint8_t bytes[sizeof(uint32_t)];
+  memcpy(bytes, &value, sizeof(uint32_t));
+  emit(jc, bytes, sizeof(uint32_t));
+}
+
+static void emit_u64(struct jit_compiler *jc, uint64_t value) {
+  uint8_t bytes[sizeof(uint64_t)];
+  memcpy(bytes, &value, sizeof(uint64_t));
+  emit(jc, bytes, sizeof(uint64_t));
+}
+
+/**
+ * emit a placeholder for the rel32 operand of a jump or call
+ */
+static size_t emit_rel32(struct jit_compiler *jc) {
+  size_t at = jc->count;
+  emit_u32(jc, 0);
+  return at;
+}
+
+static void patch_rel32(struct jit_compiler *jc, size_t at, size_t target) {
+  if (jc->failed) {
+    return;
+  }
+  int32_t rel = (int32_t)target - (int32_t)(at + sizeof(int32_t));
+  memcpy(jc->code + at, &rel, sizeof(int32_t));
+}
+
+static void emit_bailout_if_equal(struct jit_compiler *jc) {
+  EMIT(jc, 0x0f, 0x84); // je bailout
+  patch_rel32(jc, emit_rel32(jc), jc->bailout);
+}
+
+static void emit_load_slot(struct jit_compiler *jc, size_t slot) {
+  EMIT(jc, 0x48, 0x8b, 0x85); // mov rax, [rbp - 8 * (slot + 1)]
+  emit_u32(jc, (uint32_t)(-8 * (int32_t)(slot + 1)));
+}
+
+static void emit_store_slot(struct jit_compiler *jc, size_t slot) {
+  EMIT(jc, 0x48, 0x89, 0x85); // mov [rbp - 8 * (slot + 1)], rax
+  emit_u32(jc, (uint32_t)(-8 * (int32_t)(slot + 1)));
+}
+
+static int find_slot(struct jit_compiler *jc, const char *name) {
+  for (size_t i = 0; i < jc->slot_count; i++) {
+    if (strcmp(jc->names[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * a name keeps one type for the whole body
+ */
+static int define_slot(struct jit_compiler *jc, char *name,
+                       enum JIT_TYPE type) {
+  int slot = find_slot(jc, name);
+  if (slot >= 0) {
+    if (jc->types[slot] != type) {
+      jc->failed = true;
+      return -1;
+    }
+    return slot;
+  }
+  if (jc->slot_count >= JIT_MAX_SLOTS) {
+    jc->failed = true;
+    return -1;
+  }
+  jc->names[jc->slot_count] = name;
+  jc->types[jc->slot_count] = type;
+  jc->assigned[jc->slot_count] = false;
+  return jc->slot_count++;
+}
+
+// ========================================================================
+
+/**
+ * the value of a block is the value of its last statement, want_value is
+ * false when the value is discarded. tail is true when the value of the
+ * block is the result of the function
+ */
+static enum JIT_TYPE compile_block(struct jit_compiler *jc,
+                                   struct block_statement *block,
+                                   bool want_value, bool tail) {
+  if (!block || block->statement_count == 0) {
+    // an empty block evaluates to the sentinel value
+    if (want_value) {
+      jc->failed = true;
+    }
+    return JIT_NONE;
+  }
+  enum JIT_TYPE type = JIT_NONE;
+  for (size_t i = 0; i < block->statement_count && !jc->failed; i++) {
+    bool last = i + 1 == block->statement_count;
+    type = compile_statement(jc, block->statements[i], want_value && last,
+                             tail && last);
+    if (type == JIT_NEVER) {
+      // the rest of the block is unreachable
+      return JIT_NEVER;
+    }
+  }
+  return jc->failed ? JIT_NONE : type;
+}
+
+static enum JIT_TYPE compile_statement(struct jit_compiler *jc,
+                                       struct statement *stmt,
+                                       bool want_value, bool tail) {
+  if (!stmt) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    enum JIT_TYPE type = compile_expression(jc, stmt->let_stmt.value);
+    int slot = define_slot(jc, stmt->let_stmt.ident, type);
+    if (slot < 0) {
+      return JIT_NONE;
+    }
+    emit_store_slot(jc, slot);
+    jc->assigned[slot] = true;
+    return type;
+  };
+  case STMT_RETURN: {
+    struct expression *value = stmt->return_stmt.value;
+    if (is_call(value)) {
+      return compile_call(jc, value, true);
+    }
+    enum JIT_TYPE type = compile_expression(jc, value);
+    if (type != jc->result) {
+      jc->failed = true;
+      return JIT_NONE;
+    }
+    if (jc->return_count >= jc->return_capacity) {
+      size_t capacity = jc->return_capacity ? jc->return_capacity * 2 : 8;
+      size_t *returns = realloc(jc->returns, sizeof(size_t) * capacity);
+      if (!returns) {
+        ERROR_LOG("error while allocating memory\n");
+        jc->failed = true;
+        return JIT_NONE;
+      }
+      jc->returns = returns;
+      jc->return_capacity = capacity;
+    }
+    EMIT(jc, 0xe9); // jmp epilogue
+    jc->returns[jc->return_count++] = emit_rel32(jc);
+    return JIT_NEVER;
+  };
+  case STMT_EXPRESSION: {
+    struct expression *expr = stmt->expr_stmt.expr;
+    if (expr && expr->type == EXPR_CONDITIONAL) {
+      return compile_conditional(jc, expr, want_value, tail);
+    }
+    if (tail && is_call(expr)) {
+      return compile_call(jc, expr, true);
+    }
+    return compile_expression(jc, expr);
+  };
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+  jc->failed = true;
+  return JIT_NONE;
+}
+
+static enum JIT_TYPE compile_expression(struct jit_compiler *jc,
+                                        struct expression *expr) {
+  if (!expr || jc->failed) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL: {
+    switch (expr->literal.literal_type) {
+    case LITERAL_INT: {
+      EMIT(jc, 0xb8); // mov eax, imm32
+      emit_u32(jc, (uint32_t)expr->literal.value.int_value);
+      return JIT_INT;
+    };
+    case LITERAL_FLOAT: {
+      uint64_t bits;
+      memcpy(&bits, &expr->literal.value.float_value, sizeof(double));
+      EMIT(jc, 0x48, 0xb8); // mov rax, imm64
+      emit_u64(jc, bits);
+      return JIT_DOUBLE;
+    };
+    case LITERAL_BOOL: {
+      EMIT(jc, 0xb8); // mov eax, imm32
+      emit_u32(jc, expr->literal.value.bool_value ? 1 : 0);
+      return JIT_BOOL;
+    };
+    case LITERAL_STRING:
+    case LITERAL_CHAR:
+      break;
+    }
+  }; break;
+  case EXPR_IDENTIFIER: {
+    int slot = find_slot(jc, expr->identifier_expr.identifier);
+    if (slot < 0 || !jc->assigned[slot]) {
+      // a global, or a let that might not have run yet
+      break;
+    }
+    emit_load_slot(jc, slot);
+    return jc->types[slot];
+  };
+  case EXPR_PREFIX:
+    return compile_prefix(jc, expr);
+  case EXPR_INFIX:
+    return compile_infix(jc, expr);
+  case EXPR_CONDITIONAL:
+    return compile_conditional(jc, expr, true, false);
+  case EXPR_FUNCTION_CALL:
+    return compile_call(jc, expr, false);
+  case EXPR_POSTFIX:
+  case EXPR_FUNCTION:
+  case EXPR_LOOP:
+    // ++/-- update the argument objects of the caller in place, closures
+    // need an environment and loops would need backward jumps
+    break;
+  }
+  jc->failed = true;
+  return JIT_NONE;
+}
+
+/**
+ * lets inside a branch are only known to be bound inside of it
+ */
+static enum JIT_TYPE compile_conditional(struct jit_compiler *jc,
+                                         struct expression *expr,
+                                         bool want_value, bool tail) {
+  if (compile_expression(jc, expr->conditional.condition) != JIT_BOOL) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  bool assigned[JIT_MAX_SLOTS];
+  memcpy(assigned, jc->assigned, sizeof(assigned));
+
+  EMIT(jc, 0x85, 0xc0);       // test eax, eax
+  EMIT(jc, 0x0f, 0x84);       // jz else
+  size_t to_else = emit_rel32(jc);
+  enum JIT_TYPE consequence =
+      compile_block(jc, expr->conditional.consequence, want_value, tail);
+  memcpy(jc->assigned, assigned, sizeof(assigned));
+  EMIT(jc, 0xe9);             // jmp end
+  size_t to_end = emit_rel32(jc);
+  patch_rel32(jc, to_else, jc->count);
+
+  enum JIT_TYPE alternative = JIT_NONE;
+  if (expr->conditional.alternative) {
+    alternative =
+        compile_block(jc, expr->conditional.alternative, want_value, tail);
+    memcpy(jc->assigned, assigned, sizeof(assigned));
+  } else if (want_value) {
+    // evaluates to the sentinel value when the condition is false
+    jc->failed = true;
+  }
+  patch_rel32(jc, to_end, jc->count);
+
+  if (jc->failed || !want_value) {
+    return JIT_NONE;
+  }
+  if (consequence == JIT_NEVER) {
+    return alternative;
+  }
+  if (alternative == JIT_NEVER || alternative == consequence) {
+    return consequence;
+  }
+  jc->failed = true;
+  return JIT_NONE;
+}
+
+static enum JIT_TYPE compile_prefix(struct jit_compiler *jc,
+                                    struct expression *expr) {
+  struct token *op = expr->prefix_expr.op;
+  if (op->type != MINUS && op->type != BANG) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  enum JIT_TYPE type = compile_expression(jc, expr->prefix_expr.right);
+  if (op->type == BANG && type == JIT_BOOL) {
+    EMIT(jc, 0x83, 0xf0, 0x01); // xor eax, 1
+    return JIT_BOOL;
+  } else if (op->type == MINUS && type == JIT_INT) {
+    EMIT(jc, 0xf7, 0xd8); // neg eax
+    return JIT_INT;
+  } else if (op->type == MINUS && type == JIT_DOUBLE) {
+    EMIT(jc, 0x48, 0xb9); // mov rcx, sign bit
+    emit_u64(jc, UINT64_C(0x8000000000000000));
+    EMIT(jc, 0x48, 0x31, 0xc8); // xor rax, rcx
+    return JIT_DOUBLE;
+  }
+  jc->failed = true;
+  return JIT_NONE;
+}
+
+/**
+ * the left operand ends up in rax / xmm0 and the right one in rcx / xmm1
+ */
+static enum JIT_TYPE compile_infix(struct jit_compiler *jc,
+                                   struct expression *expr) {
+  enum JIT_TYPE left = compile_expression(jc, expr->infix_expr.left);
+  EMIT(jc, 0x50); // push rax
+  enum JIT_TYPE right = compile_expression(jc, expr->infix_expr.right);
+  EMIT(jc, 0x48, 0x89, 0xc1); // mov rcx, rax
+  EMIT(jc, 0x58);             // pop rax
+  if (jc->failed || left != right) {
+    // mixed operands are a type mismatch in the interpreter
+    jc->failed = true;
+    return JIT_NONE;
+  }
+
+  enum TOKEN_TYPE op = expr->infix_expr.op->type;
+  if (left == JIT_INT) {
+    switch (op) {
+    case PLUS:
+      EMIT(jc, 0x01, 0xc8); // add eax, ecx
+      return JIT_INT;
+    case MINUS:
+      EMIT(jc, 0x29, 0xc8); // sub eax, ecx
+      return JIT_INT;
+    case ASTERISK:
+      EMIT(jc, 0x0f, 0xaf, 0xc1); // imul eax, ecx
+      return JIT_INT;
+    case SLASH:
+    case MOD: {
+      // x / 0 and INT_MIN / -1 are the sentinel value, both guards bail
+      // out to the interpreter which returns it
+      EMIT(jc, 0x85, 0xc9); // test ecx, ecx
+      emit_bailout_if_equal(jc);
+      EMIT(jc, 0x83, 0xf9, 0xff); // cmp ecx, -1
+      emit_bailout_if_equal(jc);
+      EMIT(jc, 0x99, 0xf7, 0xf9); // cdq, idiv ecx
+      if (op == MOD) {
+        EMIT(jc, 0x89, 0xd0); // mov eax, edx
+      }
+      return JIT_INT;
+    };
+    case LT:
+    case GT:
+    case LT_EQ:
+    case GT_EQ:
+    case EQ_EQ:
+    case NOT_EQ: {
+      uint8_t setcc = op == LT      ? 0x9c
+                      : op == GT    ? 0x9f
+                      : op == LT_EQ ? 0x9e
+                      : op == GT_EQ ? 0x9d
+                      : op == EQ_EQ ? 0x94
+                                    : 0x95;
+      EMIT(jc, 0x39, 0xc8);       // cmp eax, ecx
+      EMIT(jc, 0x0f, setcc, 0xc0); // setcc al
+      EMIT(jc, 0x0f, 0xb6, 0xc0); // movzx eax, al
+      return JIT_BOOL;
+    };
+    default:
+      break;
+    }
+  } else if (left == JIT_DOUBLE) {
+    EMIT(jc, 0x66, 0x48, 0x0f, 0x6e, 0xc0); // movq xmm0, rax
+    EMIT(jc, 0x66, 0x48, 0x0f, 0x6e, 0xc9); // movq xmm1, rcx
+    switch (op) {
+    case PLUS:
+    case MINUS:
+    case ASTERISK:
+    case SLASH: {
+      if (op == SLASH) {
+        // x / 0.0 (or -0.0) is the sentinel value
+        EMIT(jc, 0x48, 0x89, 0xca); // mov rdx, rcx
+        EMIT(jc, 0x48, 0xd1, 0xe2); // shl rdx, 1
+        emit_bailout_if_equal(jc);
+      }
+      uint8_t opcode = op == PLUS       ? 0x58
+                       : op == MINUS    ? 0x5c
+                       : op == ASTERISK ? 0x59
+                                        : 0x5e;
+      EMIT(jc, 0xf2, 0x0f, opcode, 0xc1);     // <op>sd xmm0, xmm1
+      EMIT(jc, 0x66, 0x48, 0x0f, 0x7e, 0xc0); // movq rax, xmm0
+      return JIT_DOUBLE;
+    };
+    case LT:
+    case LT_EQ:
+      // a < b is b > a, which is false for unordered operands (nan)
+      EMIT(jc, 0x66, 0x0f, 0x2e, 0xc8); // ucomisd xmm1, xmm0
+      EMIT(jc, 0x0f, op == LT ? 0x97 : 0x93, 0xc0); // seta / setae al
+      EMIT(jc, 0x0f, 0xb6, 0xc0);       // movzx eax, al
+      return JIT_BOOL;
+    case GT:
+    case GT_EQ:
+      EMIT(jc, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+      EMIT(jc, 0x0f, op == GT ? 0x97 : 0x93, 0xc0); // seta / setae al
+      EMIT(jc, 0x0f, 0xb6, 0xc0);       // movzx eax, al
+      return JIT_BOOL;
+    case EQ_EQ:
+      EMIT(jc, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+      EMIT(jc, 0x0f, 0x94, 0xc0);       // sete al
+      EMIT(jc, 0x0f, 0x9b, 0xc1);       // setnp cl
+      EMIT(jc, 0x20, 0xc8);             // and al, cl
+      EMIT(jc, 0x0f, 0xb6, 0xc0);       // movzx eax, al
+      return JIT_BOOL;
+    case NOT_EQ:
+      EMIT(jc, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+      EMIT(jc, 0x0f, 0x95, 0xc0);       // setne al
+      EMIT(jc, 0x0f, 0x9a, 0xc1);       // setp cl
+      EMIT(jc, 0x08, 0xc8);             // or al, cl
+      EMIT(jc, 0x0f, 0xb6, 0xc0);       // movzx eax, al
+      return JIT_BOOL;
+    default:
+      break;
+    }
+  }
+  jc->failed = true;
+  return JIT_NONE;
+}
+
+static bool is_call(struct expression *expr) {
+  return expr && expr->type == EXPR_FUNCTION_CALL;
+}
+
+/**
+ * only calls of the function to itself are compiled, they go straight to
+ * the native body. the arguments are evaluated last to first (the body has
+ * no side effects) so they end up in order on the stack. a call in tail
+ * position stores them in the parameter slots and jumps back to the start
+ * of the body instead, so it takes no stack
+ */
+static enum JIT_TYPE compile_call(struct jit_compiler *jc,
+                                  struct expression *expr, bool tail) {
+  struct expression *callee = expr->function_call.function;
+  if (!callee || callee->type != EXPR_IDENTIFIER) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  char *name = callee->identifier_expr.identifier;
+  struct obj_t *function = jc->function;
+  if (find_slot(jc, name) >= 0 ||
+      env_look_up(function->function_value.env, name) != function) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  if (jc->self_name && strcmp(jc->self_name, name) != 0) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  jc->self_name = name;
+
+  size_t arg_count = expr->function_call.arg_count;
+  if (arg_count != function->function_value.proto->param_count) {
+    jc->failed = true;
+    return JIT_NONE;
+  }
+  for (size_t i = arg_count; i > 0; i--) {
+    enum JIT_TYPE type =
+        compile_expression(jc, expr->function_call.arguments[i - 1]);
+    if (type != jc->types[i - 1]) {
+      jc->failed = true;
+      return JIT_NONE;
+    }
+    EMIT(jc, 0x50); // push rax
+  }
+  if (tail) {
+    for (size_t i = 0; i < arg_count; i++) {
+      EMIT(jc, 0x58); // pop rax
+      emit_store_slot(jc, i);
+    }
+    EMIT(jc, 0xe9); // jmp start
+    patch_rel32(jc, emit_rel32(jc), jc->start);
+    return JIT_NEVER;
+  }
+  EMIT(jc, 0x48, 0x89, 0xe7); // mov rdi, rsp
+  EMIT(jc, 0xe8);             // call body
+  patch_rel32(jc, emit_rel32(jc), jc->body);
+  EMIT(jc, 0x48, 0x81, 0xc4); // add rsp, 8 * arg_count
+  emit_u32(jc, 8 * arg_count);
+  return jc->result;
+}
+
+#else
+
+bool jit_try_call(struct obj_t *function, struct obj_t **args,
+                  size_t arg_count, struct obj_t **result) {
+  return false;
+}
+
+#endif // JIT_SUPPORTED
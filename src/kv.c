@@ -96,12 +96,17 @@ static void resize(hash_table *table) {
 }
 
 struct obj_t *hash_table_get(hash_table *table, const char *key) {
+  entry *e = hash_table_get_entry(table, key);
+  return e ? e->value : NULL;
+}
+
+entry *hash_table_get_entry(hash_table *table, const char *key) {
   unsigned long index = hash(key) % table->capacity;
   entry *e = table->buckets[index];
 
   while (e) {
     if (strcmp(e->key, key) == 0) {
-      return e->value;
+      return e;
     }
     e = e->next;
   }
@@ -135,6 +140,20 @@ bool hash_table_has(hash_table *table, const char *key) {
   return hash_table_get(table, key) != NULL;
 }
 
+void hash_table_clear(hash_table *table) {
+  for (size_t i = 0; i < table->capacity; i++) {
+    entry *e = table->buckets[i];
+    while (e) {
+      entry *next = e->next;
+      free(e->key);
+      free(e);
+      e = next;
+    }
+    table->buckets[i] = NULL;
+  }
+  table->size = 0;
+}
+
 // iterator
 hash_table_iterator hash_table_iterate(hash_table *table) {
   hash_table_iterator it = {
@@ -1,5 +1,14 @@
+#include "evaluator.h"
+#include "gc.h"
+#include "jit.h"
 #include "repl.h"
+#include "transpiler.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // prettier-ignore
 // clang-format off
@@ -12,7 +21,66 @@
 \_| |_/\_| \_| \____/           \___/\_| \_/ \_/ \____/\_| \_\_|   \_| \_\____/  \_/ \____/\_| \_|
 */
 
-int main() {
-  repl();
-  return EXIT_SUCCESS;
+static void usage(const char *program) {
+  fprintf(stderr, "usage: %s [--engine=tree|vm|regvm|closure|stack] [--no-jit]\n"
+                  "       [--gc-budget=objects] [--gc-stats] [script.arc]\n"
+                  "       %s --emit-c script.arc\n", program, program);
+}
+
+int main(int argc, char **argv) {
+  const char *script = NULL;
+  bool emit_c = false;
+  bool gc_stats = false;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--engine=", 9) == 0) {
+      enum EVAL_ENGINE engine;
+      if (!evaluator_engine_from_name(argv[i] + 9, &engine)) {
+        fprintf(stderr, "unknown engine: %s\n", argv[i] + 9);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      evaluator_set_engine(engine);
+    } else if (strcmp(argv[i], "--no-jit") == 0) {
+      jit_set_enabled(false);
+    } else if (strncmp(argv[i], "--gc-budget=", 12) == 0) {
+      // strtoul skips spaces and a sign, and wraps negative values around
+      char *end = NULL;
+      errno = 0;
+      unsigned long budget = strtoul(argv[i] + 12, &end, 10);
+      if (!isdigit((unsigned char)argv[i][12]) || *end != '\0' ||
+          errno == ERANGE) {
+        fprintf(stderr, "invalid gc budget: %s\n", argv[i] + 12);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      gc_set_step_budget(budget);
+    } else if (strcmp(argv[i], "--gc-stats") == 0) {
+      gc_stats = true;
+    } else if (strcmp(argv[i], "--emit-c") == 0) {
+      emit_c = true;
+    } else if (argv[i][0] == '-' || script) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      script = argv[i];
+    }
+  }
+
+  if (emit_c) {
+    if (!script) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    return transpile_file(script, stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  bool ok = true;
+  if (script) {
+    ok = run_file(script);
+  } else {
+    repl();
+  }
+  if (gc_stats) {
+    gc_print_stats(stderr);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
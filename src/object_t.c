@@ -1,25 +1,50 @@
 #include "object_t.h"
 #include "ast.h"
+#include "compiler.h"
 #include "environment.h"
 #include "error_t.h"
+#include "gc.h"
+#include "slab.h"
 #include "util_error.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static void object_t_finalize(void *slot);
+static struct obj_t *object_t_init_from(struct slab_class *class,
+                                        enum OBJECT_TYPE type);
+
+struct slab_class object_slab = SLAB_CLASS(struct obj_t, object_t_finalize);
+
+// values of literals, never swept by the gc
+static struct slab_class immortal_slab = SLAB_CLASS(struct obj_t, NULL);
+
+struct obj_t *object_t_alloc() { return slab_alloc(&object_slab); }
 
 struct obj_t *object_t_init(enum OBJECT_TYPE type) {
-  struct obj_t *v = malloc(sizeof(struct obj_t));
+  return object_t_init_from(&object_slab, type);
+}
+
+static struct obj_t *object_t_init_from(struct slab_class *class,
+                                        enum OBJECT_TYPE type) {
+  struct obj_t *v = slab_alloc(class);
   if (!v) {
-    ERROR_LOG("error while allocation memory\n");
     return NULL;
   }
+  if (!object_t_init_in(v, type)) {
+    slab_free(v);
+    return NULL;
+  }
+  return v;
+}
+
+bool object_t_init_in(struct obj_t *v, enum OBJECT_TYPE type) {
   v->type = type;
   v->gc_next = NULL;
-  v->marked = false;
+  v->forwarded = false;
+  v->immortal = false;
 
   switch (type) {
-  case OBJECT_INT:
-    v->int_value = 0;
-    break;
   case OBJECT_DOUBLE:
     v->double_value = 0.0;
     break;
@@ -28,11 +53,6 @@ struct obj_t *object_t_init(enum OBJECT_TYPE type) {
     v->string_value.length = 0;
     v->string_value.capacity = 0;
     break;
-  case OBJECT_BOOL:
-    v->bool_value = false;
-    break;
-  case OBJECT_CHAR:
-    v->rune_value = '\0';
   case OBJECT_SENTINEL:
     break;
   case OBJECT_RETURN:
@@ -42,48 +62,109 @@ struct obj_t *object_t_init(enum OBJECT_TYPE type) {
     v->err_value = init_error_t();
     break;
   case OBJECT_FUNCTION: {
-    v->function_value.blk_stmts = NULL;
     v->function_value.env = NULL;
-    v->function_value.param_capacity = 0;
-    v->function_value.param_count = 0;
-    v->function_value.parameters = 0;
-  }; break;
-  default: {
-    free(v);
-    v = NULL;
+    v->function_value.proto = NULL;
   }; break;
+  default:
+    return false;
   }
-  return v;
+  return true;
 }
 
 void object_t_free(struct obj_t *v) {
-  if (v && v->type != OBJECT_BOOL && v->type != OBJECT_SENTINEL) {
-    switch (v->type) {
-    case OBJECT_STRING:
-      if (v->string_value.data)
-        free(v->string_value.data);
-      break;
-    case OBJECT_ERROR: {
-      free_error_t(v->err_value);
-    }; break;
-    case OBJECT_FUNCTION: {
-      if (v->function_value.parameters) {
-        for (size_t i = 0; i < v->function_value.param_count; i++) {
-          ast_identifier_free(v->function_value.parameters[i]);
-        }
-        free(v->function_value.parameters);
-      }
-      if (v->function_value.blk_stmts) {
-        ast_block_statement_free(v->function_value.blk_stmts);
-      }
-      if (v->function_value.env) {
-        env_free(v->function_value.env);
-      }
-    }; break;
-    default:
-      break;
-    }
-    free(v);
+  if (v && !object_t_is_immediate(v) && v->type != OBJECT_SENTINEL) {
+    object_t_free_fields(v);
+    slab_free(v);
   }
   v = NULL;
 }
+
+static void object_t_finalize(void *slot) { object_t_free_fields(slot); }
+
+void object_t_free_fields(struct obj_t *v) {
+  switch (v->type) {
+  case OBJECT_STRING:
+    if (v->string_value.data)
+      free(v->string_value.data);
+    break;
+  case OBJECT_ERROR: {
+    free_error_t(v->err_value);
+  }; break;
+  case OBJECT_FUNCTION:
+    // the prototype is shared by all closures of the literal and the
+    // environment by all closures created in it, neither is owned
+    break;
+  default:
+    break;
+  }
+}
+
+struct obj_t *literal_object_of(struct literal *literal) {
+  if (literal->object) {
+    return literal->object;
+  }
+  struct obj_t *value = NULL;
+  switch (literal->literal_type) {
+  case LITERAL_BOOL:
+    return literal->value.bool_value ? gc_alloc(OBJECT_BOOL_TRUE)
+                                     : gc_alloc(OBJECT_BOOL_FALSE);
+  case LITERAL_INT:
+    return gc_int(literal->value.int_value);
+  case LITERAL_CHAR:
+    return gc_char(literal->value.char_value);
+  case LITERAL_FLOAT: {
+    value = object_t_immediate_double(literal->value.float_value);
+    if (value) {
+      return value;
+    }
+    value = object_t_init_from(&immortal_slab, OBJECT_DOUBLE);
+    if (value) {
+      value->double_value = literal->value.float_value;
+    }
+  }; break;
+  case LITERAL_STRING: {
+    value = object_t_init_from(&immortal_slab, OBJECT_STRING);
+    if (value) {
+      value->string_value.data = strndup(literal->value.string_literal->value,
+                                         literal->value.string_literal->length);
+      value->string_value.length = literal->value.string_literal->length;
+    }
+  }; break;
+  }
+  if (value) {
+    value->immortal = true;
+  }
+  literal->object = value;
+  return value;
+}
+
+struct function_proto *function_proto_init(struct identifier **parameters,
+                                           size_t param_count,
+                                           size_t param_capacity,
+                                           struct block_statement *body,
+                                           const struct scope *scope) {
+  struct function_proto *proto = calloc(1, sizeof(struct function_proto));
+  if (!proto) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  proto->parameters = parameters;
+  proto->param_count = param_count;
+  proto->param_capacity = param_capacity;
+  proto->body = body;
+  proto->scope = scope;
+  proto->local_count = scope ? scope->count : param_count;
+  proto->captured =
+      scope ? scope->captured : compiler_block_creates_function(body);
+  return proto;
+}
+
+struct function_proto *function_proto_of(struct function_literal *literal) {
+  if (!literal->proto) {
+    literal->proto =
+        function_proto_init(literal->parameters, literal->param_count,
+                            literal->param_capacity, literal->body,
+                            literal->scope);
+  }
+  return literal->proto;
+}
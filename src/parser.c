@@ -338,6 +338,10 @@ parser_parse_prefix_fn parser_get_prefix_fn(enum TOKEN_TYPE type) {
     return parser_parse_grouped_expr;
   case IF:
     return parser_parse_if_expression;
+  case WHILE:
+    return parser_parse_while_expression;
+  case FOR:
+    return parser_parse_for_expression;
   case FUNCTION:
     return parser_parse_fn_expression;
   default:
@@ -831,6 +835,110 @@ struct expression *parser_parse_if_expression(struct parser *p) {
   return expr;
 }
 
+/**
+ * parse while loops
+ * while (<condition>) { <body> }
+ * exits with the current token at the RBRACE(}) of the body
+ */
+struct expression *parser_parse_while_expression(struct parser *p) {
+  struct expression *expr = ast_expression_init(EXPR_LOOP);
+  if (!expr) {
+    return NULL;
+  }
+  expr->loop.token = p->current_token;
+  parser_next_token(p);
+  struct expression *condition = parser_parse_expr_bp(p, LOWEST);
+  if (!condition) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  expr->loop.condition = condition;
+  if (!parser_expect_next_token(p, LBRACE)) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  struct block_statement *body = parser_parse_block_statement(p);
+  if (!body) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  expr->loop.body = body;
+  return expr;
+}
+
+/**
+ * parse for loops
+ * for (<init>; <condition>; <update>) { <body> }
+ * <init> -> let statement or expression
+ * each of the clauses can be left out, a loop without a condition runs until
+ * it returns. exits with the current token at the RBRACE(}) of the body
+ */
+struct expression *parser_parse_for_expression(struct parser *p) {
+  struct expression *expr = ast_expression_init(EXPR_LOOP);
+  if (!expr) {
+    return NULL;
+  }
+  expr->loop.token = p->current_token;
+  if (!parser_expect_next_token(p, LPAREN)) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  parser_next_token(p);
+  if (!parser_current_token_is(p, SEMICOLON)) {
+    // both statement parsers leave the current token at the SEMICOLON(;)
+    struct statement *init = parser_parse_statement(p);
+    if (!init) {
+      ast_expression_free(expr);
+      return NULL;
+    }
+    expr->loop.init = init;
+    if (!parser_current_token_is(p, SEMICOLON)) {
+      parser_add_error(p, "Expected %s, got %s",
+                       token_type_to_str(SEMICOLON),
+                       token_type_to_str(p->current_token->type));
+      ast_expression_free(expr);
+      return NULL;
+    }
+  }
+  parser_next_token(p);
+  if (!parser_current_token_is(p, SEMICOLON)) {
+    struct expression *condition = parser_parse_expr_bp(p, LOWEST);
+    if (!condition) {
+      ast_expression_free(expr);
+      return NULL;
+    }
+    expr->loop.condition = condition;
+    if (!parser_expect_next_token(p, SEMICOLON)) {
+      ast_expression_free(expr);
+      return NULL;
+    }
+  }
+  parser_next_token(p);
+  if (!parser_current_token_is(p, RPAREN)) {
+    struct expression *update = parser_parse_expr_bp(p, LOWEST);
+    if (!update) {
+      ast_expression_free(expr);
+      return NULL;
+    }
+    expr->loop.update = update;
+    if (!parser_expect_next_token(p, RPAREN)) {
+      ast_expression_free(expr);
+      return NULL;
+    }
+  }
+  if (!parser_expect_next_token(p, LBRACE)) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  struct block_statement *body = parser_parse_block_statement(p);
+  if (!body) {
+    ast_expression_free(expr);
+    return NULL;
+  }
+  expr->loop.body = body;
+  return expr;
+}
+
 /**
  * parse block statements
  * {<statements>} or {<expression>}
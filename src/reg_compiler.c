@@ -0,0 +1,778 @@
+#include "reg_compiler.h"
+#include "ast.h"
+#include "compiler.h"
+#include "object_t.h"
+#include "token.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CHUNK_CAPACITY 16
+
+/**
+ * marks a statement whose value is not used by the enclosing block
+ */
+#define NO_REGISTER -1
+
+/**
+ * reg_compiler keeps the state needed while lowering a single function body,
+ * locals take the registers [0, local_count) and temporaries are handed out
+ * above them like a stack (free_register is the top)
+ */
+struct reg_compiler {
+  struct reg_chunk *chunk;
+  char *locals[REG_MAX_REGISTERS]; // names of the local registers, borrowed
+  bool assigned[REG_MAX_REGISTERS]; // the local is bound on every path
+  size_t local_count;
+  size_t free_register;
+  size_t branch_depth; // > 0 while compiling a branch of a conditional
+  bool failed;         // set when the body cannot be represented
+};
+
+// clang-format off
+
+static struct reg_chunk *reg_chunk_init();
+static bool grow_array(void **items, size_t *capacity, size_t count, size_t item_size);
+
+static size_t emit_abc(struct reg_compiler *, enum REG_OPCODE, int a, int b, int c, struct token *);
+static size_t emit_abx(struct reg_compiler *, enum REG_OPCODE, int a, size_t bx, struct token *);
+static void patch_jump(struct reg_compiler *, size_t pc);
+static void emit_loop(struct reg_compiler *, size_t start);
+
+static size_t add_constant(struct reg_compiler *, struct obj_t *);
+static size_t add_name(struct reg_compiler *, const char *);
+static size_t add_function(struct reg_compiler *, struct reg_chunk *);
+
+static int alloc_register(struct reg_compiler *);
+static int resolve_local(struct reg_compiler *, const char *);
+static void declare_local(struct reg_compiler *, char *);
+static void collect_block_locals(struct reg_compiler *, struct block_statement *);
+static void collect_statement_locals(struct reg_compiler *, struct statement *);
+static void collect_expression_locals(struct reg_compiler *, struct expression *);
+static bool expression_has_side_effects(struct expression *);
+
+static void compile_block(struct reg_compiler *, struct block_statement *, int dst);
+static void compile_statement(struct reg_compiler *, struct statement *, int dst);
+static void compile_expression(struct reg_compiler *, struct expression *, int dst);
+static int compile_any(struct reg_compiler *, struct expression *);
+static int compile_rk(struct reg_compiler *, struct expression *);
+static struct obj_t *literal_constant(struct literal *);
+static void compile_get(struct reg_compiler *, char *, struct token *, int dst);
+static void compile_step(struct reg_compiler *, struct token *, struct expression *, int dst);
+static void compile_infix(struct reg_compiler *, struct expression *, int dst);
+static void compile_conditional(struct reg_compiler *, struct expression *, int dst);
+static void compile_loop(struct reg_compiler *, struct expression *, int dst);
+static void compile_call(struct reg_compiler *, struct expression *, int dst);
+
+// clang-format on
+
+struct reg_chunk *reg_compiler_compile_program(struct program *program) {
+  struct reg_chunk *chunk = reg_chunk_init();
+  if (!chunk) {
+    return NULL;
+  }
+  // top level names always live in the environment the program runs in
+  chunk->uses_env = true;
+
+  struct reg_compiler c = {.chunk = chunk};
+  int result = alloc_register(&c);
+  if (program->statement_count == 0) {
+    emit_abc(&c, ROP_LOADNULL, result, 0, 0, NULL);
+  }
+  for (size_t i = 0; i < program->statement_count; i++) {
+    bool last = i + 1 == program->statement_count;
+    compile_statement(&c, program->statements[i], last ? result : NO_REGISTER);
+  }
+  emit_abc(&c, ROP_RETURN, result, 0, 0, NULL);
+
+  if (c.failed) {
+    reg_chunk_free(chunk);
+    return NULL;
+  }
+  return chunk;
+}
+
+struct reg_chunk *reg_compiler_compile_function(struct identifier **parameters,
+                                                size_t param_count,
+                                                size_t param_capacity,
+                                                struct block_statement *body) {
+  struct reg_chunk *chunk = reg_chunk_init();
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->parameters = parameters;
+  chunk->param_count = param_count;
+  chunk->param_capacity = param_capacity;
+  chunk->body = body;
+  chunk->uses_env = compiler_block_creates_function(body);
+
+  struct reg_compiler c = {.chunk = chunk};
+  if (!chunk->uses_env) {
+    // arguments are copied in order, so parameter i lives in register i
+    for (size_t i = 0; i < param_count; i++) {
+      declare_local(&c, parameters[i]->id);
+      c.assigned[i] = true;
+    }
+    collect_block_locals(&c, body);
+    c.free_register = c.local_count;
+    if (c.local_count > chunk->register_count) {
+      chunk->register_count = c.local_count;
+    }
+  }
+  int result = alloc_register(&c);
+  compile_block(&c, body, result);
+  emit_abc(&c, ROP_RETURN, result, 0, 0, NULL);
+  chunk->local_count = c.local_count;
+
+  if (c.failed) {
+    reg_chunk_free(chunk);
+    return NULL;
+  }
+  return chunk;
+}
+
+void reg_chunk_free(struct reg_chunk *chunk) {
+  if (chunk) {
+    free(chunk->code);
+    free(chunk->tokens);
+    // NOTE: constants are immortal and nested chunks are kept alive, see
+    // chunk_free in compiler.c
+    free(chunk->constants);
+    for (size_t i = 0; i < chunk->name_count; i++) {
+      free(chunk->names[i]);
+    }
+    free(chunk->names);
+    free(chunk->functions);
+    free(chunk);
+  }
+  chunk = NULL;
+}
+
+static struct reg_chunk *reg_chunk_init() {
+  struct reg_chunk *chunk = calloc(1, sizeof(struct reg_chunk));
+  if (!chunk) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  return chunk;
+}
+
+/**
+ * make room for one more item in a growable array
+ */
+static bool grow_array(void **items, size_t *capacity, size_t count,
+                       size_t item_size) {
+  if (count < *capacity) {
+    return true;
+  }
+  size_t new_capacity = *capacity ? *capacity * 2 : INITIAL_CHUNK_CAPACITY;
+  void *new_items = realloc(*items, new_capacity * item_size);
+  if (!new_items) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  *items = new_items;
+  *capacity = new_capacity;
+  return true;
+}
+
+// ========================================================================
+
+/**
+ * append an instruction, returns its index in the chunk
+ */
+static size_t emit_abc(struct reg_compiler *c, enum REG_OPCODE op, int a,
+                       int b, int cc, struct token *token) {
+  struct reg_chunk *chunk = c->chunk;
+  // code and tokens are parallel arrays that grow in lockstep
+  size_t code_capacity = chunk->capacity;
+  size_t token_capacity = chunk->capacity;
+  if (!grow_array((void **)&chunk->code, &code_capacity, chunk->count,
+                  sizeof(struct reg_instr)) ||
+      !grow_array((void **)&chunk->tokens, &token_capacity, chunk->count,
+                  sizeof(struct token *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->capacity = code_capacity;
+  struct reg_instr *instr = &chunk->code[chunk->count];
+  instr->op = op;
+  instr->a = a;
+  instr->b = b;
+  instr->c = cc;
+  chunk->tokens[chunk->count] = token;
+  return chunk->count++;
+}
+
+static size_t emit_abx(struct reg_compiler *c, enum REG_OPCODE op, int a,
+                       size_t bx, struct token *token) {
+  if (bx > UINT16_MAX) {
+    c->failed = true;
+    return 0;
+  }
+  size_t pc = emit_abc(c, op, a, 0, 0, token);
+  if (!c->failed) {
+    c->chunk->code[pc].bx = bx;
+  }
+  return pc;
+}
+
+/**
+ * point a forward jump at the next instruction to be emitted
+ */
+static void patch_jump(struct reg_compiler *c, size_t pc) {
+  if (c->failed) {
+    return;
+  }
+  size_t offset = c->chunk->count - (pc + 1);
+  if (offset > UINT16_MAX) {
+    c->failed = true;
+    return;
+  }
+  c->chunk->code[pc].bx = offset;
+}
+
+/**
+ * jump back to the instruction at start
+ */
+static void emit_loop(struct reg_compiler *c, size_t start) {
+  emit_abx(c, ROP_LOOP, 0, c->chunk->count + 1 - start, NULL);
+}
+
+static size_t add_constant(struct reg_compiler *c, struct obj_t *value) {
+  struct reg_chunk *chunk = c->chunk;
+  if (!value || !grow_array((void **)&chunk->constants,
+                            &chunk->constant_capacity, chunk->constant_count,
+                            sizeof(struct obj_t *))) {
+    object_t_free(value);
+    c->failed = true;
+    return 0;
+  }
+  chunk->constants[chunk->constant_count] = value;
+  return chunk->constant_count++;
+}
+
+static size_t add_name(struct reg_compiler *c, const char *name) {
+  struct reg_chunk *chunk = c->chunk;
+  for (size_t i = 0; i < chunk->name_count; i++) {
+    if (strcmp(chunk->names[i], name) == 0) {
+      return i;
+    }
+  }
+  if (!grow_array((void **)&chunk->names, &chunk->name_capacity,
+                  chunk->name_count, sizeof(char *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->names[chunk->name_count] = strdup(name);
+  return chunk->name_count++;
+}
+
+static size_t add_function(struct reg_compiler *c,
+                           struct reg_chunk *function) {
+  struct reg_chunk *chunk = c->chunk;
+  if (!function ||
+      !grow_array((void **)&chunk->functions, &chunk->function_capacity,
+                  chunk->function_count, sizeof(struct reg_chunk *))) {
+    c->failed = true;
+    return 0;
+  }
+  chunk->functions[chunk->function_count] = function;
+  return chunk->function_count++;
+}
+
+// ========================================================================
+
+static int alloc_register(struct reg_compiler *c) {
+  if (c->free_register >= REG_MAX_REGISTERS) {
+    c->failed = true;
+    return 0;
+  }
+  int reg = c->free_register++;
+  if (c->free_register > c->chunk->register_count) {
+    c->chunk->register_count = c->free_register;
+  }
+  return reg;
+}
+
+static int resolve_local(struct reg_compiler *c, const char *name) {
+  if (c->chunk->uses_env) {
+    return -1;
+  }
+  for (size_t i = 0; i < c->local_count; i++) {
+    if (strcmp(c->locals[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void declare_local(struct reg_compiler *c, char *name) {
+  if (resolve_local(c, name) >= 0) {
+    return;
+  }
+  // keep one register free for the result of the body
+  if (c->local_count + 1 >= REG_MAX_REGISTERS) {
+    c->failed = true;
+    return;
+  }
+  c->locals[c->local_count++] = name;
+}
+
+/**
+ * give every let of the body a register up front, blocks do not open a new
+ * scope so the lets inside conditionals belong to the function as well
+ */
+static void collect_block_locals(struct reg_compiler *c,
+                                 struct block_statement *block) {
+  if (block) {
+    for (size_t i = 0; i < block->statement_count; i++) {
+      collect_statement_locals(c, block->statements[i]);
+    }
+  }
+}
+
+static void collect_statement_locals(struct reg_compiler *c,
+                                     struct statement *stmt) {
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    collect_expression_locals(c, stmt->let_stmt.value);
+    declare_local(c, stmt->let_stmt.ident);
+  }; break;
+  case STMT_RETURN: {
+    collect_expression_locals(c, stmt->return_stmt.value);
+  }; break;
+  case STMT_EXPRESSION: {
+    collect_expression_locals(c, stmt->expr_stmt.expr);
+  }; break;
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+}
+
+static void collect_expression_locals(struct reg_compiler *c,
+                                      struct expression *expr) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+  case EXPR_FUNCTION:
+    break;
+  case EXPR_PREFIX: {
+    collect_expression_locals(c, expr->prefix_expr.right);
+  }; break;
+  case EXPR_INFIX: {
+    collect_expression_locals(c, expr->infix_expr.left);
+    collect_expression_locals(c, expr->infix_expr.right);
+  }; break;
+  case EXPR_POSTFIX: {
+    collect_expression_locals(c, expr->postfix_expr.left);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    collect_expression_locals(c, expr->conditional.condition);
+    collect_block_locals(c, expr->conditional.consequence);
+    collect_block_locals(c, expr->conditional.alternative);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    collect_expression_locals(c, expr->function_call.function);
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      collect_expression_locals(c, expr->function_call.arguments[i]);
+    }
+  }; break;
+  case EXPR_LOOP: {
+    collect_statement_locals(c, expr->loop.init);
+    collect_expression_locals(c, expr->loop.condition);
+    collect_block_locals(c, expr->loop.body);
+    collect_expression_locals(c, expr->loop.update);
+  }; break;
+  }
+}
+
+/**
+ * an expression that can rebind a local (++, -- or a let inside a
+ * conditional), used to decide if an operand can be read in place
+ */
+static bool expression_has_side_effects(struct expression *expr) {
+  if (!expr) {
+    return false;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+  case EXPR_FUNCTION:
+    return false;
+  case EXPR_PREFIX:
+    return expr->prefix_expr.op->type == INC ||
+           expr->prefix_expr.op->type == DEC ||
+           expression_has_side_effects(expr->prefix_expr.right);
+  case EXPR_INFIX:
+    return expression_has_side_effects(expr->infix_expr.left) ||
+           expression_has_side_effects(expr->infix_expr.right);
+  case EXPR_POSTFIX:
+  case EXPR_CONDITIONAL:
+  case EXPR_LOOP:
+    return true;
+  case EXPR_FUNCTION_CALL: {
+    if (expression_has_side_effects(expr->function_call.function)) {
+      return true;
+    }
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      if (expression_has_side_effects(expr->function_call.arguments[i])) {
+        return true;
+      }
+    }
+    return false;
+  };
+  }
+  return false;
+}
+
+// ========================================================================
+
+/**
+ * a block leaves the value of its last statement in dst, an empty block
+ * evaluates to the sentinel value
+ */
+static void compile_block(struct reg_compiler *c,
+                          struct block_statement *block, int dst) {
+  if (!block || block->statement_count == 0) {
+    if (dst != NO_REGISTER) {
+      emit_abc(c, ROP_LOADNULL, dst, 0, 0, NULL);
+    }
+    return;
+  }
+  for (size_t i = 0; i < block->statement_count; i++) {
+    bool last = i + 1 == block->statement_count;
+    compile_statement(c, block->statements[i], last ? dst : NO_REGISTER);
+  }
+}
+
+/**
+ * compile a statement, its value ends up in dst unless dst is NO_REGISTER
+ */
+static void compile_statement(struct reg_compiler *c, struct statement *stmt,
+                              int dst) {
+  if (!stmt || stmt->type == STMT_FUNCTION_DEF) {
+    if (dst != NO_REGISTER) {
+      emit_abc(c, ROP_LOADNULL, dst, 0, 0, NULL);
+    }
+    return;
+  }
+  size_t mark = c->free_register;
+  switch (stmt->type) {
+  case STMT_LET: {
+    int local = resolve_local(c, stmt->let_stmt.ident);
+    if (local >= 0) {
+      compile_expression(c, stmt->let_stmt.value, local);
+      if (c->branch_depth == 0) {
+        c->assigned[local] = true;
+      }
+      if (dst != NO_REGISTER && dst != local) {
+        emit_abc(c, ROP_MOVE, dst, local, 0, NULL);
+      }
+    } else {
+      int value = dst != NO_REGISTER ? dst : alloc_register(c);
+      compile_expression(c, stmt->let_stmt.value, value);
+      emit_abx(c, ROP_DEFNAME, value, add_name(c, stmt->let_stmt.ident), NULL);
+    }
+  }; break;
+  case STMT_RETURN: {
+    int value = compile_any(c, stmt->return_stmt.value);
+    emit_abc(c, ROP_RETURN, value, 0, 0, NULL);
+  }; break;
+  case STMT_EXPRESSION: {
+    int value = dst != NO_REGISTER ? dst : alloc_register(c);
+    compile_expression(c, stmt->expr_stmt.expr, value);
+  }; break;
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+  c->free_register = mark;
+}
+
+/**
+ * compile an expression into the register dst
+ */
+static void compile_expression(struct reg_compiler *c, struct expression *expr,
+                               int dst) {
+  if (!expr) {
+    emit_abc(c, ROP_LOADNULL, dst, 0, 0, NULL);
+    return;
+  }
+  size_t mark = c->free_register;
+  switch (expr->type) {
+  case EXPR_LITERAL: {
+    if (expr->literal.literal_type == LITERAL_BOOL) {
+      emit_abc(c, ROP_LOADBOOL, dst, expr->literal.value.bool_value, 0, NULL);
+    } else {
+      size_t constant = add_constant(c, literal_constant(&expr->literal));
+      emit_abx(c, ROP_LOADK, dst, constant, NULL);
+    }
+  }; break;
+  case EXPR_IDENTIFIER: {
+    compile_get(c, expr->identifier_expr.identifier,
+                expr->identifier_expr.token, dst);
+  }; break;
+  case EXPR_PREFIX: {
+    struct token *op = expr->prefix_expr.op;
+    switch (op->type) {
+    case BANG:
+    case MINUS: {
+      int right = compile_any(c, expr->prefix_expr.right);
+      emit_abc(c, op->type == BANG ? ROP_NOT : ROP_NEGATE, dst, right, 0, op);
+    }; break;
+    case INC:
+    case DEC: {
+      compile_step(c, op, expr->prefix_expr.right, dst);
+    }; break;
+    default: {
+      emit_abc(c, ROP_RAISE, RAISE_UNKNOWN_PREFIX, 0, 0, op);
+    }; break;
+    }
+  }; break;
+  case EXPR_INFIX: {
+    compile_infix(c, expr, dst);
+  }; break;
+  case EXPR_POSTFIX: {
+    compile_step(c, expr->postfix_expr.op, expr->postfix_expr.left, dst);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    compile_conditional(c, expr, dst);
+  }; break;
+  case EXPR_FUNCTION: {
+    struct reg_chunk *function = reg_compiler_compile_function(
+        expr->function.parameters, expr->function.param_count,
+        expr->function.param_capacity, expr->function.body);
+    emit_abx(c, ROP_CLOSURE, dst, add_function(c, function), NULL);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    compile_call(c, expr, dst);
+  }; break;
+  case EXPR_LOOP: {
+    compile_loop(c, expr, dst);
+  }; break;
+  }
+  c->free_register = mark;
+}
+
+/**
+ * get the value of an expression into some register, a local that is bound
+ * on every path is used in place instead of being copied
+ */
+static int compile_any(struct reg_compiler *c, struct expression *expr) {
+  if (expr && expr->type == EXPR_IDENTIFIER) {
+    int local = resolve_local(c, expr->identifier_expr.identifier);
+    if (local >= 0 && c->assigned[local]) {
+      return local;
+    }
+  }
+  int reg = alloc_register(c);
+  compile_expression(c, expr, reg);
+  return reg;
+}
+
+/**
+ * like compile_any, but small constants are referenced straight from the
+ * constant pool
+ */
+static int compile_rk(struct reg_compiler *c, struct expression *expr) {
+  if (expr && expr->type == EXPR_LITERAL &&
+      expr->literal.literal_type != LITERAL_BOOL &&
+      c->chunk->constant_count <= REG_RK_MAX) {
+    size_t constant = add_constant(c, literal_constant(&expr->literal));
+    return REG_RK_CONSTANT | constant;
+  }
+  return compile_any(c, expr);
+}
+
+/**
+ * constants are the immortal values of the literals, see chunk_free in
+ * compiler.c
+ */
+static struct obj_t *literal_constant(struct literal *literal) {
+  if (literal->literal_type == LITERAL_BOOL) {
+    return NULL; // loaded with LOADBOOL
+  }
+  return literal_object_of(literal);
+}
+
+static void compile_get(struct reg_compiler *c, char *name,
+                        struct token *token, int dst) {
+  int local = resolve_local(c, name);
+  if (local < 0) {
+    emit_abx(c, ROP_GETNAME, dst, add_name(c, name), token);
+  } else if (c->assigned[local]) {
+    if (dst != local) {
+      emit_abc(c, ROP_MOVE, dst, local, 0, NULL);
+    }
+  } else {
+    // the let that binds the local might not have run, keep a name to
+    // fall back on
+    size_t name_index = add_name(c, name);
+    if (name_index > UINT8_MAX) {
+      c->failed = true;
+      return;
+    }
+    emit_abc(c, ROP_GETLOCAL, dst, local, name_index, token);
+  }
+}
+
+/**
+ * ++ and -- evaluate to the value the variable held before the update
+ */
+static void compile_step(struct reg_compiler *c, struct token *op,
+                         struct expression *target, int dst) {
+  if (!target || target->type != EXPR_IDENTIFIER) {
+    emit_abc(c, ROP_RAISE, RAISE_NON_IDENTIFIER, 0, 0, op);
+    return;
+  }
+  enum REG_OPCODE step = op->type == INC ? ROP_INC : ROP_DEC;
+  char *name = target->identifier_expr.identifier;
+  int old = alloc_register(c);
+  compile_get(c, name, op, old);
+  int local = resolve_local(c, name);
+  if (local >= 0) {
+    emit_abc(c, step, local, old, 0, op);
+  } else {
+    int updated = alloc_register(c);
+    emit_abc(c, step, updated, old, 0, op);
+    emit_abx(c, ROP_SETNAME, updated, add_name(c, name), NULL);
+  }
+  emit_abc(c, ROP_MOVE, dst, old, 0, NULL);
+}
+
+static void compile_infix(struct reg_compiler *c, struct expression *expr,
+                          int dst) {
+  struct expression *left_expr = expr->infix_expr.left;
+  int left;
+  if (expression_has_side_effects(expr->infix_expr.right)) {
+    // the right operand could rebind a local used on the left
+    left = alloc_register(c);
+    compile_expression(c, left_expr, left);
+  } else {
+    left = compile_rk(c, left_expr);
+  }
+  int right = compile_rk(c, expr->infix_expr.right);
+
+  struct token *op = expr->infix_expr.op;
+  enum REG_OPCODE opcode;
+  switch (op->type) {
+  case PLUS:
+    opcode = ROP_ADD;
+    break;
+  case MINUS:
+    opcode = ROP_SUB;
+    break;
+  case ASTERISK:
+    opcode = ROP_MUL;
+    break;
+  case LT:
+    opcode = ROP_LT;
+    break;
+  case GT:
+    opcode = ROP_GT;
+    break;
+  case LT_EQ:
+    opcode = ROP_LT_EQ;
+    break;
+  case GT_EQ:
+    opcode = ROP_GT_EQ;
+    break;
+  case EQ_EQ:
+    opcode = ROP_EQ_EQ;
+    break;
+  case NOT_EQ:
+    opcode = ROP_NOT_EQ;
+    break;
+  default:
+    opcode = ROP_INFIX;
+    break;
+  }
+  emit_abc(c, opcode, dst, left, right, op);
+}
+
+static void compile_conditional(struct reg_compiler *c,
+                                struct expression *expr, int dst) {
+  size_t mark = c->free_register;
+  int condition = compile_any(c, expr->conditional.condition);
+  size_t else_jump = emit_abx(c, ROP_JMPF, condition, 0, NULL);
+  c->free_register = mark;
+
+  c->branch_depth++;
+  compile_block(c, expr->conditional.consequence, dst);
+  size_t end_jump = emit_abx(c, ROP_JMP, 0, 0, NULL);
+  patch_jump(c, else_jump);
+  if (expr->conditional.alternative) {
+    compile_block(c, expr->conditional.alternative, dst);
+  } else {
+    emit_abc(c, ROP_LOADNULL, dst, 0, 0, NULL);
+  }
+  patch_jump(c, end_jump);
+  c->branch_depth--;
+}
+
+/**
+ * apart from the init everything in a loop may run any number of times (or
+ * not at all), so the lets inside of it are treated like the ones of a branch
+ */
+static void compile_loop(struct reg_compiler *c, struct expression *expr,
+                         int dst) {
+  if (expr->loop.init) {
+    compile_statement(c, expr->loop.init, NO_REGISTER);
+  }
+  c->branch_depth++;
+  size_t mark = c->free_register;
+  size_t start = c->chunk->count;
+  size_t exit_jump = 0;
+  if (expr->loop.condition) {
+    int condition = compile_any(c, expr->loop.condition);
+    exit_jump = emit_abx(c, ROP_JMPF, condition, 0, NULL);
+    c->free_register = mark;
+  }
+
+  compile_block(c, expr->loop.body, NO_REGISTER);
+  if (expr->loop.update) {
+    int update = alloc_register(c);
+    compile_expression(c, expr->loop.update, update);
+    c->free_register = mark;
+  }
+  emit_loop(c, start);
+  if (expr->loop.condition) {
+    patch_jump(c, exit_jump);
+  }
+  emit_abc(c, ROP_LOADNULL, dst, 0, 0, NULL);
+  c->branch_depth--;
+}
+
+/**
+ * the callee and the arguments are placed in consecutive registers, the
+ * frame of the callee starts right after the callee register
+ */
+static void compile_call(struct reg_compiler *c, struct expression *expr,
+                         int dst) {
+  size_t arg_count = expr->function_call.arg_count;
+  if (arg_count > UINT8_MAX) {
+    c->failed = true;
+    return;
+  }
+  int base = alloc_register(c);
+  for (size_t i = 0; i < arg_count; i++) {
+    alloc_register(c);
+  }
+  compile_expression(c, expr->function_call.function, base);
+  for (size_t i = 0; i < arg_count; i++) {
+    compile_expression(c, expr->function_call.arguments[i], base + 1 + i);
+  }
+  emit_abc(c, ROP_CALL, base, arg_count, 0, expr->function_call.token);
+  if (dst != base) {
+    emit_abc(c, ROP_MOVE, dst, base, 0, NULL);
+  }
+}
@@ -0,0 +1,383 @@
+#include "reg_vm.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object_t.h"
+#include "reg_compiler.h"
+#include "util_error.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define REG_VM_INITIAL_REGISTERS 256
+#define REG_VM_INITIAL_FRAME_COUNT 64
+
+/**
+ * reg_frame is an active function call, its registers start at base in the
+ * register file (the callee and the destination of the result is base - 1)
+ */
+struct reg_frame {
+  struct reg_chunk *chunk;
+  struct reg_instr *pc;
+  size_t base;
+  struct environment *env;
+};
+
+/**
+ * the register file and the frames live on the heap and grow on demand
+ */
+struct reg_vm {
+  struct obj_t **registers;
+  size_t register_capacity;
+  struct reg_frame *frames;
+  size_t frame_count;
+  size_t frame_capacity;
+};
+
+// clang-format off
+
+static struct obj_t *reg_vm_execute(struct reg_vm *, struct reg_chunk *, struct environment *);
+static bool reg_vm_push_frame(struct reg_vm *, struct reg_chunk *, size_t base, struct environment *);
+static void reg_vm_visit_roots(void *vm);
+
+// clang-format on
+
+struct obj_t *reg_vm_run_program(struct environment *env,
+                                 struct program *program) {
+  struct reg_chunk *chunk = reg_compiler_compile_program(program);
+  if (!chunk) {
+    return NULL;
+  }
+  struct reg_vm vm = {NULL, 0, NULL, 0, 0};
+  gc_push_root_visitor(reg_vm_visit_roots, &vm);
+  struct obj_t *result = reg_vm_execute(&vm, chunk, env);
+  gc_pop_roots(1);
+  free(vm.registers);
+  free(vm.frames);
+  reg_chunk_free(chunk);
+  return result;
+}
+
+/**
+ * the registers of the frames and their environments are roots. registers
+ * are cleared when their frame is pushed, so the ones above the arguments
+ * hold either NULL or what the frame (or a call it made) stored there
+ */
+static void reg_vm_visit_roots(void *data) {
+  struct reg_vm *vm = data;
+  size_t top = 0;
+  for (size_t i = 0; i < vm->frame_count; i++) {
+    struct reg_frame *frame = &vm->frames[i];
+    if (frame->base + frame->chunk->register_count > top) {
+      top = frame->base + frame->chunk->register_count;
+    }
+    gc_visit_environment(frame->env);
+  }
+  for (size_t i = 0; i < top; i++) {
+    gc_visit(&vm->registers[i]);
+  }
+}
+
+static bool reg_vm_push_frame(struct reg_vm *vm, struct reg_chunk *chunk,
+                              size_t base, struct environment *env) {
+  if (vm->frame_count >= vm->frame_capacity) {
+    size_t capacity = vm->frame_capacity ? vm->frame_capacity * 2
+                                         : REG_VM_INITIAL_FRAME_COUNT;
+    struct reg_frame *frames =
+        realloc(vm->frames, sizeof(struct reg_frame) * capacity);
+    if (!frames) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    vm->frames = frames;
+    vm->frame_capacity = capacity;
+  }
+  size_t size = base + chunk->register_count;
+  if (size > vm->register_capacity) {
+    size_t capacity = vm->register_capacity ? vm->register_capacity
+                                            : REG_VM_INITIAL_REGISTERS;
+    while (capacity < size) {
+      capacity *= 2;
+    }
+    struct obj_t **registers =
+        realloc(vm->registers, sizeof(struct obj_t *) * capacity);
+    if (!registers) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    vm->registers = registers;
+    vm->register_capacity = capacity;
+  }
+  for (size_t i = chunk->param_count; i < chunk->register_count; i++) {
+    vm->registers[base + i] = NULL;
+  }
+  struct reg_frame *frame = &vm->frames[vm->frame_count++];
+  frame->chunk = chunk;
+  frame->pc = chunk->code;
+  frame->base = base;
+  frame->env = env;
+  return true;
+}
+
+// clang-format off
+
+#define R(idx) (regs[(idx)])
+#define K(idx) (frame->chunk->constants[(idx)])
+#define RK(idx) ((idx) & REG_RK_CONSTANT ? K((idx) & REG_RK_MAX) : R(idx))
+#define NAME(idx) (frame->chunk->names[(idx)])
+#define TOKEN() (frame->chunk->tokens[pc - 1 - frame->chunk->code])
+
+// store the cached registers back into the frame / reload them from it
+#define SAVE_FRAME() (frame->pc = pc)
+#define LOAD_FRAME()                                                           \
+  do {                                                                         \
+    frame = &vm->frames[vm->frame_count - 1];                                  \
+    pc = frame->pc;                                                            \
+    regs = vm->registers + frame->base;                                        \
+  } while (0)
+
+#define THROW(error)                                                           \
+  do {                                                                         \
+    result = (error);                                                          \
+    goto done;                                                                 \
+  } while (0)
+
+/**
+ * int (op) int is handled inline, everything else goes through the
+ * operator semantics shared with the tree walker
+ */
+#define BINARY_OP(int_expr)                                                    \
+  do {                                                                         \
+    struct obj_t *left = RK(i.b);                                              \
+    struct obj_t *right = RK(i.c);                                             \
+    struct obj_t *value;                                                       \
+    if (object_t_is_int(left) && object_t_is_int(right)) {                     \
+      value = (int_expr);                                                      \
+    } else {                                                                   \
+      value = evaluate_infix_expr(TOKEN(), left, right);                       \
+      if (has_error(value)) {                                                  \
+        THROW(value);                                                          \
+      }                                                                        \
+    }                                                                          \
+    R(i.a) = value;                                                            \
+  } while (0)
+
+#define INT_RESULT(op) int_result(object_t_int(left) op object_t_int(right))
+#define BOOL_RESULT(op)                                                        \
+  (object_t_int(left) op object_t_int(right) ? gc_alloc(OBJECT_BOOL_TRUE)      \
+                                             : gc_alloc(OBJECT_BOOL_FALSE))
+
+// clang-format on
+
+static inline struct obj_t *int_result(int value) {
+  return gc_int(value);
+}
+
+static struct obj_t *reg_vm_execute(struct reg_vm *vm, struct reg_chunk *chunk,
+                                    struct environment *env) {
+  if (!reg_vm_push_frame(vm, chunk, 0, env)) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+
+  struct obj_t *result = NULL;
+  struct reg_frame *frame;
+  struct reg_instr *pc;
+  struct obj_t **regs;
+  LOAD_FRAME();
+
+  for (;;) {
+    struct reg_instr i = *pc++;
+    switch ((enum REG_OPCODE)i.op) {
+    case ROP_MOVE: {
+      R(i.a) = R(i.b);
+    }; break;
+    case ROP_LOADK: {
+      R(i.a) = K(i.bx);
+    }; break;
+    case ROP_LOADNULL: {
+      R(i.a) = gc_alloc(OBJECT_SENTINEL);
+    }; break;
+    case ROP_LOADBOOL: {
+      R(i.a) = i.b ? gc_alloc(OBJECT_BOOL_TRUE) : gc_alloc(OBJECT_BOOL_FALSE);
+    }; break;
+
+    case ROP_GETNAME: {
+      struct obj_t *value = env_look_up(frame->env, NAME(i.bx));
+      if (!value) {
+        THROW(vm_error(TOKEN(), "identifier not found", NULL));
+      }
+      R(i.a) = value;
+    }; break;
+    case ROP_DEFNAME: {
+      env_define(frame->env, NAME(i.bx), R(i.a));
+    }; break;
+    case ROP_SETNAME: {
+      env_set(frame->env, NAME(i.bx), R(i.a));
+    }; break;
+    case ROP_GETLOCAL: {
+      struct obj_t *value = R(i.b);
+      if (!value) {
+        // the let that binds the local has not run (yet), use the outer scope
+        value = env_look_up(frame->env, NAME(i.c));
+        if (!value) {
+          THROW(vm_error(TOKEN(), "identifier not found", NULL));
+        }
+      }
+      R(i.a) = value;
+    }; break;
+
+    case ROP_ADD: {
+      BINARY_OP(INT_RESULT(+));
+    }; break;
+    case ROP_SUB: {
+      BINARY_OP(INT_RESULT(-));
+    }; break;
+    case ROP_MUL: {
+      BINARY_OP(INT_RESULT(*));
+    }; break;
+    case ROP_LT: {
+      BINARY_OP(BOOL_RESULT(<));
+    }; break;
+    case ROP_GT: {
+      BINARY_OP(BOOL_RESULT(>));
+    }; break;
+    case ROP_LT_EQ: {
+      BINARY_OP(BOOL_RESULT(<=));
+    }; break;
+    case ROP_GT_EQ: {
+      BINARY_OP(BOOL_RESULT(>=));
+    }; break;
+    case ROP_EQ_EQ: {
+      BINARY_OP(BOOL_RESULT(==));
+    }; break;
+    case ROP_NOT_EQ: {
+      BINARY_OP(BOOL_RESULT(!=));
+    }; break;
+    case ROP_INFIX: {
+      struct obj_t *value = evaluate_infix_expr(TOKEN(), RK(i.b), RK(i.c));
+      if (has_error(value)) {
+        THROW(value);
+      }
+      R(i.a) = value;
+    }; break;
+
+    case ROP_NOT: {
+      R(i.a) = evaluate_prefix_bang_operator_expr(TOKEN(), R(i.b));
+    }; break;
+    case ROP_NEGATE: {
+      struct obj_t *value = evaluate_prefix_minus_operator_expr(TOKEN(), R(i.b));
+      if (has_error(value)) {
+        THROW(value);
+      }
+      R(i.a) = value;
+    }; break;
+    case ROP_INC:
+    case ROP_DEC: {
+      int delta = i.op == ROP_INC ? 1 : -1;
+      struct obj_t *value = vm_step(TOKEN(), R(i.b), delta);
+      if (has_error(value)) {
+        THROW(value);
+      }
+      R(i.a) = value;
+    }; break;
+    case ROP_RAISE: {
+      THROW(vm_raise(TOKEN(), i.a));
+    }; break;
+
+    case ROP_JMP: {
+      pc += i.bx;
+    }; break;
+    case ROP_JMPF: {
+      if (!is_truthy(R(i.a))) {
+        pc += i.bx;
+      }
+    }; break;
+    case ROP_LOOP: {
+      pc -= i.bx;
+      gc_safe_point();
+    }; break;
+
+    case ROP_CLOSURE: {
+      struct reg_chunk *function = frame->chunk->functions[i.bx];
+      struct obj_t *obj = gc_alloc(OBJECT_FUNCTION);
+      if (!obj) {
+        THROW(gc_alloc(OBJECT_SENTINEL));
+      }
+      if (!function->proto) {
+        function->proto =
+            function_proto_init(function->parameters, function->param_count,
+                                function->param_capacity, function->body, NULL);
+        if (!function->proto) {
+          THROW(gc_alloc(OBJECT_SENTINEL));
+        }
+        function->proto->reg_chunk = function;
+      }
+      obj->function_value.env = frame->env;
+      obj->function_value.proto = function->proto;
+      R(i.a) = obj;
+    }; break;
+    case ROP_CALL: {
+      struct obj_t *callee = R(i.a);
+      if (object_t_type(callee) != OBJECT_FUNCTION) {
+        THROW(vm_error(TOKEN(), "invalid function call",
+                       "only functions can be called"));
+      }
+      struct function_proto *proto = callee->function_value.proto;
+      struct reg_chunk *function = proto->reg_chunk;
+      if (!function) {
+        // created by another engine, compile it the first time it is called
+        function = reg_compiler_compile_function(
+            proto->parameters, proto->param_count, proto->param_capacity,
+            proto->body);
+        if (!function) {
+          THROW(vm_error(TOKEN(), "invalid function call",
+                         "function body cannot be compiled to bytecode"));
+        }
+        proto->reg_chunk = function;
+      }
+      if (i.b < function->param_count) {
+        THROW(vm_error(TOKEN(), "invalid function call",
+                       "not enough arguments for the function parameters"));
+      }
+
+      // the arguments already sit in the first registers of the callee
+      size_t base = frame->base + i.a + 1;
+      struct environment *call_env = callee->function_value.env;
+      if (function->uses_env) {
+        call_env = env_init();
+        if (!call_env) {
+          THROW(gc_alloc(OBJECT_SENTINEL));
+        }
+        call_env->parent = callee->function_value.env;
+        struct obj_t **args = regs + i.a + 1;
+        for (size_t p = 0; p < function->param_count; p++) {
+          env_define(call_env, function->parameters[p]->id, args[p]);
+        }
+      }
+
+      SAVE_FRAME();
+      if (!reg_vm_push_frame(vm, function, base, call_env)) {
+        THROW(gc_alloc(OBJECT_SENTINEL));
+      }
+      LOAD_FRAME();
+      gc_safe_point();
+    }; break;
+    case ROP_RETURN: {
+      struct obj_t *value = R(i.a);
+      if (vm->frame_count == 1) {
+        result = value;
+        goto done;
+      }
+      size_t destination = frame->base - 1;
+      vm->frame_count--;
+      LOAD_FRAME();
+      vm->registers[destination] = value;
+    }; break;
+    }
+  }
+
+done:
+  vm->frame_count = 0;
+  return result ? result : gc_alloc(OBJECT_SENTINEL);
+}
@@ -7,6 +7,7 @@
 #include "object_t.h"
 #include "parser.h"
 #include "util_error.h"
+#include "util_file.h"
 #include "util_repr.h"
 #include <ctype.h>
 #include <stdbool.h>
@@ -112,7 +113,7 @@ void evaluate(const char *buffer, size_t size, struct environment *global_env) {
     string_t *str = init_string_t(8);
 
     struct obj_t *result = evaluate_program(global_env, program);
-    if (result->type == OBJECT_ERROR) {
+    if (object_t_type(result) == OBJECT_ERROR) {
         frepr_string_t(stderr, result->err_value->message);
     } else {
         t_object_repr(result, str);
@@ -177,6 +178,28 @@ void repl() {
     }
 }
 
+bool run_file(const char *filename) {
+    file_info *finfo = load_file(filename);
+    if (!finfo) {
+        fprintf(stderr, "could not read %s\n", filename);
+        return false;
+    }
+
+    struct environment *global_env = env_init();
+    if (!global_env) {
+        ERROR_LOG("error occurred while allocating memory\n");
+        free(finfo->buffer);
+        free(finfo);
+        return false;
+    }
+
+    evaluate(finfo->buffer, finfo->len, global_env);
+
+    free(finfo->buffer);
+    free(finfo);
+    return true;
+}
+
 void shutdown() { 
     // TODO: free resources && perform cleanups
 }
@@ -0,0 +1,356 @@
+#include "resolver.h"
+#include "ast.h"
+#include "environment.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * chain of the scopes of the fn literals around the node being resolved,
+ * lives on the c stack while the body of the innermost one is walked
+ */
+struct enclosing {
+  struct scope *scope;
+  struct enclosing *parent;
+};
+
+/**
+ * the program is walked twice. binding tags every identifier with the scope
+ * and slot of its name and finds the scopes functions nested in them refer
+ * to, only those scopes are materialized as environments closures can keep
+ * (the others are skipped by the closures, see evaluate_fn_expression), so
+ * the depths are counted once all of them are known
+ */
+enum RESOLVE_PASS {
+  RESOLVE_BIND,
+  RESOLVE_DEPTH,
+};
+
+static enum RESOLVE_PASS resolve_pass = RESOLVE_BIND;
+
+// clang-format off
+
+static void resolve_statements(struct statement **, size_t, struct enclosing *);
+static void resolve_statement(struct statement *, struct enclosing *);
+static void resolve_block(struct block_statement *, struct enclosing *);
+static void resolve_expression(struct expression *, struct enclosing *);
+static void resolve_function(struct function_literal *, struct enclosing *);
+static void resolve_identifier(struct expression *, struct enclosing *);
+
+static void declare_block(struct scope *, struct block_statement *);
+static void declare_statement(struct scope *, struct statement *);
+static void declare_expression(struct scope *, struct expression *);
+
+static struct scope *scope_init();
+static void scope_free(struct scope *);
+static bool scope_add(struct scope *, const char *name, bool unique);
+static int scope_find(const struct scope *, const char *name);
+
+// clang-format on
+
+void resolve_program(struct program *program) {
+  if (program) {
+    resolve_pass = RESOLVE_BIND;
+    resolve_statements(program->statements, program->statement_count, NULL);
+    resolve_pass = RESOLVE_DEPTH;
+    resolve_statements(program->statements, program->statement_count, NULL);
+  }
+}
+
+static void resolve_statements(struct statement **stmts, size_t count,
+                               struct enclosing *enclosing) {
+  for (size_t i = 0; i < count; i++) {
+    resolve_statement(stmts[i], enclosing);
+  }
+}
+
+static void resolve_block(struct block_statement *block,
+                          struct enclosing *enclosing) {
+  if (block) {
+    resolve_statements(block->statements, block->statement_count, enclosing);
+  }
+}
+
+static void resolve_statement(struct statement *stmt,
+                              struct enclosing *enclosing) {
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    resolve_expression(stmt->let_stmt.value, enclosing);
+    if (enclosing) {
+      // every let of the body was declared up front
+      stmt->let_stmt.scope = enclosing->scope;
+      stmt->let_stmt.slot = scope_find(enclosing->scope, stmt->let_stmt.ident);
+    }
+  }; break;
+  case STMT_RETURN: {
+    resolve_expression(stmt->return_stmt.value, enclosing);
+  }; break;
+  case STMT_EXPRESSION: {
+    resolve_expression(stmt->expr_stmt.expr, enclosing);
+  }; break;
+  case STMT_FUNCTION_DEF:
+    break; // evaluates to nothing
+  }
+}
+
+static void resolve_expression(struct expression *expr,
+                               struct enclosing *enclosing) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+    break;
+  case EXPR_IDENTIFIER: {
+    resolve_identifier(expr, enclosing);
+  }; break;
+  case EXPR_PREFIX: {
+    resolve_expression(expr->prefix_expr.right, enclosing);
+  }; break;
+  case EXPR_INFIX: {
+    resolve_expression(expr->infix_expr.left, enclosing);
+    resolve_expression(expr->infix_expr.right, enclosing);
+  }; break;
+  case EXPR_POSTFIX: {
+    resolve_expression(expr->postfix_expr.left, enclosing);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    resolve_expression(expr->conditional.condition, enclosing);
+    resolve_block(expr->conditional.consequence, enclosing);
+    resolve_block(expr->conditional.alternative, enclosing);
+  }; break;
+  case EXPR_LOOP: {
+    resolve_statement(expr->loop.init, enclosing);
+    resolve_expression(expr->loop.condition, enclosing);
+    resolve_expression(expr->loop.update, enclosing);
+    resolve_block(expr->loop.body, enclosing);
+  }; break;
+  case EXPR_FUNCTION: {
+    resolve_function(&expr->function, enclosing);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    resolve_expression(expr->function_call.function, enclosing);
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      resolve_expression(expr->function_call.arguments[i], enclosing);
+    }
+  }; break;
+  }
+}
+
+/**
+ * parameter i is slot i (arguments are stored by position), the lets of
+ * the body follow. if the scope cannot be built the body is left as is and
+ * all of its names are looked up by name
+ */
+static void resolve_function(struct function_literal *function,
+                             struct enclosing *enclosing) {
+  if (resolve_pass == RESOLVE_DEPTH) {
+    if (function->scope) {
+      struct enclosing inner = {.scope = function->scope, .parent = enclosing};
+      resolve_block(function->body, &inner);
+    }
+    return;
+  }
+  if (function->scope) {
+    return;
+  }
+  struct scope *scope = scope_init();
+  if (!scope) {
+    return;
+  }
+  bool ok = true;
+  for (size_t i = 0; ok && i < function->param_count; i++) {
+    ok = scope_add(scope, function->parameters[i]->id, false);
+  }
+  if (!ok) {
+    scope_free(scope);
+    return;
+  }
+  declare_block(scope, function->body);
+  function->scope = scope;
+
+  struct enclosing inner = {.scope = scope, .parent = enclosing};
+  resolve_block(function->body, &inner);
+}
+
+/**
+ * the innermost scope with the name binds it. as an unset slot falls back to
+ * looking the name up, every outer scope with the name is captured as well
+ */
+static void resolve_identifier(struct expression *expr,
+                               struct enclosing *enclosing) {
+  if (resolve_pass == RESOLVE_DEPTH) {
+    if (!expr->identifier_expr.scope) {
+      return;
+    }
+    // the environment of the innermost function is always there, outer
+    // ones only when they are captured
+    size_t depth = 0;
+    for (struct enclosing *e = enclosing;
+         e && e->scope != expr->identifier_expr.scope; e = e->parent) {
+      if (e->parent && e->parent->scope->captured) {
+        depth++;
+      }
+    }
+    expr->identifier_expr.depth = depth;
+    return;
+  }
+  bool bound = false;
+  for (struct enclosing *e = enclosing; e; e = e->parent) {
+    int slot = scope_find(e->scope, expr->identifier_expr.identifier);
+    if (slot < 0) {
+      continue;
+    }
+    if (!bound) {
+      expr->identifier_expr.scope = e->scope;
+      expr->identifier_expr.slot = slot;
+      bound = true;
+    }
+    if (e != enclosing) {
+      e->scope->captured = true;
+    }
+  }
+}
+
+// ========================================================================
+
+/**
+ * blocks do not open a scope, the lets of conditionals and loops belong to
+ * the function as well. nested fn literals get a scope of their own
+ */
+static void declare_block(struct scope *scope, struct block_statement *block) {
+  if (block) {
+    for (size_t i = 0; i < block->statement_count; i++) {
+      declare_statement(scope, block->statements[i]);
+    }
+  }
+}
+
+static void declare_statement(struct scope *scope, struct statement *stmt) {
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    declare_expression(scope, stmt->let_stmt.value);
+    scope_add(scope, stmt->let_stmt.ident, true);
+  }; break;
+  case STMT_RETURN: {
+    declare_expression(scope, stmt->return_stmt.value);
+  }; break;
+  case STMT_EXPRESSION: {
+    declare_expression(scope, stmt->expr_stmt.expr);
+  }; break;
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+}
+
+static void declare_expression(struct scope *scope, struct expression *expr) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_IDENTIFIER:
+  case EXPR_FUNCTION:
+    break;
+  case EXPR_PREFIX: {
+    declare_expression(scope, expr->prefix_expr.right);
+  }; break;
+  case EXPR_INFIX: {
+    declare_expression(scope, expr->infix_expr.left);
+    declare_expression(scope, expr->infix_expr.right);
+  }; break;
+  case EXPR_POSTFIX: {
+    declare_expression(scope, expr->postfix_expr.left);
+  }; break;
+  case EXPR_CONDITIONAL: {
+    declare_expression(scope, expr->conditional.condition);
+    declare_block(scope, expr->conditional.consequence);
+    declare_block(scope, expr->conditional.alternative);
+  }; break;
+  case EXPR_LOOP: {
+    declare_statement(scope, expr->loop.init);
+    declare_expression(scope, expr->loop.condition);
+    declare_expression(scope, expr->loop.update);
+    declare_block(scope, expr->loop.body);
+  }; break;
+  case EXPR_FUNCTION_CALL: {
+    declare_expression(scope, expr->function_call.function);
+    for (size_t i = 0; i < expr->function_call.arg_count; i++) {
+      declare_expression(scope, expr->function_call.arguments[i]);
+    }
+  }; break;
+  }
+}
+
+// ========================================================================
+
+/**
+ * NOTE: scopes are referenced by the environments of calls and by the
+ * bodies of fn literals, which outlive the ast (see ast.c), so they are
+ * kept alive the same way as compiled chunks
+ */
+static struct scope *scope_init() {
+  struct scope *scope = calloc(1, sizeof(struct scope));
+  if (!scope) {
+    ERROR_LOG("error while allocating memory\n");
+  }
+  return scope;
+}
+
+static void scope_free(struct scope *scope) {
+  if (scope) {
+    for (size_t i = 0; i < scope->count; i++) {
+      free(scope->names[i]);
+    }
+    free(scope->names);
+    free(scope);
+  }
+}
+
+/**
+ * append name, lets are only added once while a repeated parameter gets a
+ * slot of its own (the last one wins, like a repeated env_define)
+ */
+static bool scope_add(struct scope *scope, const char *name, bool unique) {
+  if (unique && scope_find(scope, name) >= 0) {
+    return true;
+  }
+  if (scope->count == scope->capacity) {
+    size_t capacity =
+        scope->capacity ? scope->capacity * 2 : SCOPE_INITIAL_CAPACITY;
+    char **names = realloc(scope->names, sizeof(char *) * capacity);
+    if (!names) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    scope->names = names;
+    scope->capacity = capacity;
+  }
+  char *copy = strdup(name);
+  if (!copy) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  scope->names[scope->count++] = copy;
+  return true;
+}
+
+/**
+ * the last slot with the name, see scope_add
+ */
+static int scope_find(const struct scope *scope, const char *name) {
+  for (size_t i = scope->count; i > 0; i--) {
+    if (strcmp(scope->names[i - 1], name) == 0) {
+      return i - 1;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,162 @@
+#include "runtime.h"
+#include "environment.h"
+#include "error_t.h"
+#include "gc.h"
+#include "object_t.h"
+#include "string_t.h"
+#include "util_error.h"
+#include "util_repr.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct obj_t *arc_string(const char *data, size_t length) {
+  struct obj_t *obj = gc_alloc(OBJECT_STRING);
+  if (obj) {
+    obj->string_value.data = strndup(data, length);
+    obj->string_value.length = length;
+  }
+  return obj;
+}
+
+struct obj_t *arc_char(char value) { return gc_char(value); }
+
+struct obj_t *arc_error(struct token *token, const char *message,
+                        const char *help) {
+  struct obj_t *err = gc_alloc(OBJECT_ERROR);
+  if (err) {
+    error_t_format_err(err->err_value, token, message, help);
+  }
+  return err;
+}
+
+struct obj_t *arc_step(struct environment *env, char *name,
+                       struct token *token, int delta) {
+  struct obj_t *value = evaluate_identifier_expr(env, name, token);
+  if (has_error(value)) {
+    return value;
+  }
+  // ints and most doubles are immediates (object_t.h), the name is rebound
+  // to a new value rather than updated in place
+  struct obj_t *next = NULL;
+  if (object_t_is_int(value)) {
+    next = arc_int(object_t_int(value) + delta);
+  } else if (object_t_type(value) == OBJECT_DOUBLE) {
+    next = arc_double(object_t_double(value) + delta);
+  }
+  if (next) {
+    env_set(env, name, next);
+    return value;
+  }
+  return arc_error(token, "operation not permitted on non numerical identifiers",
+                   "operation only permitted on integer or floating point "
+                   "identifiers (variables)");
+}
+
+struct obj_t *arc_step_slot(struct environment *owner, struct obj_t **slot,
+                            struct environment *env, char *name,
+                            struct token *token, int delta) {
+  struct obj_t *value = *slot;
+  if (!value) {
+    return arc_step(env, name, token, delta); // the let did not run yet
+  }
+  struct obj_t *next = NULL;
+  if (object_t_is_int(value)) {
+    next = arc_int(object_t_int(value) + delta);
+  } else if (object_t_type(value) == OBJECT_DOUBLE) {
+    next = arc_double(object_t_double(value) + delta);
+  }
+  if (!next) {
+    return arc_error(token,
+                     "operation not permitted on non numerical identifiers",
+                     "operation only permitted on integer or floating point "
+                     "identifiers (variables)");
+  }
+  if (owner) {
+    gc_write_barrier(owner, next);
+  }
+  *slot = next;
+  return value;
+}
+
+struct obj_t *arc_function(struct environment *env, struct token *token,
+                           struct function_proto **proto,
+                           const char *const *names, size_t param_count,
+                           arc_native_fn native) {
+  struct obj_t *obj = gc_alloc(OBJECT_FUNCTION);
+  if (!obj) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+  if (!*proto) {
+    // built the first time the literal is evaluated, like function_proto_of
+    struct identifier **parameters = NULL;
+    if (param_count > 0) {
+      parameters = malloc(sizeof(struct identifier *) * param_count);
+      if (!parameters) {
+        ERROR_LOG("error while allocating memory\n");
+        return gc_alloc(OBJECT_SENTINEL);
+      }
+      for (size_t i = 0; i < param_count; i++) {
+        parameters[i] = malloc(sizeof(struct identifier));
+        parameters[i]->id = strdup(names[i]);
+        parameters[i]->token = token;
+      }
+    }
+    *proto = function_proto_init(parameters, param_count, param_count, NULL,
+                                 NULL);
+    if (!*proto) {
+      return gc_alloc(OBJECT_SENTINEL);
+    }
+    (*proto)->native = native;
+  }
+  obj->function_value.env = env;
+  obj->function_value.proto = *proto;
+  return obj;
+}
+
+struct obj_t *arc_call(struct token *token, struct obj_t *function,
+                       struct obj_t **args, size_t arg_count) {
+  if (object_t_type(function) != OBJECT_FUNCTION ||
+      !function->function_value.proto->native) {
+    return arc_error(token, "invalid function call",
+                     "only functions can be called");
+  }
+  struct function_proto *proto = function->function_value.proto;
+  size_t param_count = proto->param_count;
+  if (arg_count < param_count) {
+    return arc_error(token, "invalid function call",
+                     "not enough arguments for the function parameters");
+  }
+  return proto->native(function->function_value.env, args);
+}
+
+struct environment *arc_call_env(const struct scope *scope,
+                                 struct environment *parent,
+                                 struct obj_t **args, size_t param_count) {
+  struct environment *env = env_init_scope(scope);
+  if (!env) {
+    return NULL;
+  }
+  env->parent = parent;
+  for (size_t i = 0; i < param_count; i++) {
+    arc_bind(env, i, args[i]);
+  }
+  return env;
+}
+
+bool arc_run(arc_native_fn program, struct environment *env) {
+  struct obj_t *result = program(env, NULL);
+  bool ok = !has_error(result);
+  if (!ok) {
+    frepr_string_t(stderr, result->err_value->message);
+  } else {
+    string_t *str = init_string_t(8);
+    t_object_repr(result, str);
+    repr_string_t(str);
+    free_string_t(str);
+  }
+  gc_collect(env);
+  return ok;
+}
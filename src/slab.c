@@ -0,0 +1,224 @@
+#include "slab.h"
+#include "util_error.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+// free slots stay poisoned so that a use after slab_free is still reported
+#define SLOT_POISON(slot, size) ASAN_POISON_MEMORY_REGION(slot, size)
+#define SLOT_UNPOISON(slot, size) ASAN_UNPOISON_MEMORY_REGION(slot, size)
+#else
+#define SLOT_POISON(slot, size) ((void)(slot), (void)(size))
+#define SLOT_UNPOISON(slot, size) ((void)(slot), (void)(size))
+#endif
+
+// the slots of a chunk start after its header
+#define SLAB_HEADER_SIZE                                                       \
+  ((sizeof(struct slab_chunk) + alignof(max_align_t) - 1) &                    \
+   ~(alignof(max_align_t) - 1))
+
+// clang-format off
+
+static struct slab_chunk *slab_chunk_init(struct slab_class *class);
+static void slab_sweep_chunk(struct slab_class *class, struct slab_chunk *chunk);
+static struct slab_chunk *slab_sweep_until_free(struct slab_class *class);
+static void slab_release_if_spare(struct slab_class *class, struct slab_chunk *chunk);
+static void slab_link(struct slab_class *class, struct slab_chunk *chunk);
+static void slab_unlink(struct slab_class *class, struct slab_chunk *chunk);
+
+// clang-format on
+
+void *slab_alloc(struct slab_class *class) {
+  struct slab_chunk *chunk = class->partial;
+  while (chunk && chunk->epoch != class->epoch) {
+    slab_sweep_chunk(class, chunk); // can release it when it is empty
+    chunk = class->partial;
+  }
+  if (!chunk) {
+    chunk = slab_sweep_until_free(class);
+  }
+  if (!chunk) {
+    chunk = slab_chunk_init(class);
+    if (!chunk) {
+      return NULL;
+    }
+  }
+  void *slot;
+  if (chunk->free) {
+    slot = chunk->free;
+    SLOT_UNPOISON(slot, class->size);
+    chunk->free = *(void **)slot;
+  } else {
+    slot = chunk->unused;
+    chunk->unused += class->size;
+  }
+  size_t index = slab_index(chunk, slot);
+  chunk->in_use[index / 64] |= (uint64_t)1 << (index % 64);
+  if (chunk->used++ == 0) {
+    class->empty_count--;
+  }
+  class->used++;
+  if (chunk->used == class->slots) {
+    slab_unlink(class, chunk);
+  }
+  return slot;
+}
+
+void slab_free(void *slot) {
+  struct slab_chunk *chunk = slab_chunk_of(slot);
+  struct slab_class *class = chunk->class;
+  if (chunk->used == class->slots) {
+    slab_link(class, chunk);
+  }
+  size_t index = slab_index(chunk, slot);
+  uint64_t bit = (uint64_t)1 << (index % 64);
+  chunk->in_use[index / 64] &= ~bit;
+  chunk->marks[index / 64] &= ~bit;
+  *(void **)slot = chunk->free;
+  chunk->free = slot;
+  SLOT_POISON(slot, class->size);
+  class->used--;
+  if (--chunk->used == 0) {
+    slab_release_if_spare(class, chunk);
+  }
+}
+
+void slab_start_sweep(struct slab_class *class) {
+  class->epoch++;
+  class->sweep = class->newest;
+}
+
+void slab_finish_sweep(struct slab_class *class) {
+  while (class->sweep) {
+    struct slab_chunk *chunk = class->sweep;
+    class->sweep = chunk->older;
+    if (chunk->epoch != class->epoch) {
+      slab_sweep_chunk(class, chunk);
+    }
+  }
+}
+
+static struct slab_chunk *slab_chunk_init(struct slab_class *class) {
+  if (!class->slots) {
+    class->slots = (SLAB_CHUNK_SIZE - SLAB_HEADER_SIZE) / class->size;
+  }
+  struct slab_chunk *chunk = aligned_alloc(SLAB_CHUNK_SIZE, SLAB_CHUNK_SIZE);
+  if (!chunk) {
+    ERROR_LOG("error while allocating memory\n");
+    return NULL;
+  }
+  chunk->class = class;
+  chunk->free = NULL;
+  chunk->unused = (char *)chunk + SLAB_HEADER_SIZE;
+  chunk->used = 0;
+  chunk->epoch = class->epoch; // nothing to sweep in it
+  memset(chunk->in_use, 0, sizeof(chunk->in_use));
+  memset(chunk->marks, 0, sizeof(chunk->marks));
+  chunk->older = class->newest;
+  chunk->newer = NULL;
+  if (class->newest) {
+    class->newest->newer = chunk;
+  }
+  class->newest = chunk;
+  class->chunk_count++;
+  class->empty_count++;
+  slab_link(class, chunk);
+  return chunk;
+}
+
+/**
+ * finalize and free the slots of chunk that are in use and not marked,
+ * only the bitmaps are read for the ones that stay
+ */
+static void slab_sweep_chunk(struct slab_class *class,
+                             struct slab_chunk *chunk) {
+  chunk->epoch = class->epoch;
+  bool full = chunk->used == class->slots;
+  size_t before = chunk->used;
+  size_t first = SLAB_HEADER_SIZE / class->size; // index of the first slot
+  char *slots = (char *)chunk + SLAB_HEADER_SIZE;
+  for (size_t w = 0; w < SLAB_BITMAP_WORDS; w++) {
+    uint64_t dead = chunk->in_use[w] & ~chunk->marks[w];
+    chunk->in_use[w] &= chunk->marks[w];
+    chunk->marks[w] = 0;
+    while (dead) {
+      size_t index = w * 64 + __builtin_ctzll(dead);
+      dead &= dead - 1;
+      void *slot = slots + (index - first) * class->size;
+      class->finalize(slot);
+      *(void **)slot = chunk->free;
+      chunk->free = slot;
+      SLOT_POISON(slot, class->size);
+      chunk->used--;
+    }
+  }
+  class->used -= before - chunk->used;
+  if (full && chunk->used < class->slots) {
+    slab_link(class, chunk);
+  }
+  if (before > 0 && chunk->used == 0) {
+    slab_release_if_spare(class, chunk);
+  }
+}
+
+/**
+ * sweep the chunks that are left until one has a free slot, NULL if none
+ * has. called when the partial list is empty
+ */
+static struct slab_chunk *slab_sweep_until_free(struct slab_class *class) {
+  while (class->sweep && !class->partial) {
+    struct slab_chunk *chunk = class->sweep;
+    class->sweep = chunk->older;
+    if (chunk->epoch != class->epoch) {
+      slab_sweep_chunk(class, chunk);
+    }
+  }
+  return class->partial;
+}
+
+/**
+ * chunk just became empty, it is kept if it is the only empty one
+ */
+static void slab_release_if_spare(struct slab_class *class,
+                                  struct slab_chunk *chunk) {
+  if (class->empty_count == 0) {
+    class->empty_count++;
+    return;
+  }
+  slab_unlink(class, chunk);
+  if (class->sweep == chunk) {
+    class->sweep = chunk->older;
+  }
+  if (chunk->older) {
+    chunk->older->newer = chunk->newer;
+  }
+  if (chunk->newer) {
+    chunk->newer->older = chunk->older;
+  } else {
+    class->newest = chunk->older;
+  }
+  class->chunk_count--;
+  free(chunk);
+}
+
+static void slab_link(struct slab_class *class, struct slab_chunk *chunk) {
+  chunk->prev = NULL;
+  chunk->next = class->partial;
+  if (class->partial) {
+    class->partial->prev = chunk;
+  }
+  class->partial = chunk;
+}
+
+static void slab_unlink(struct slab_class *class, struct slab_chunk *chunk) {
+  if (chunk->prev) {
+    chunk->prev->next = chunk->next;
+  } else {
+    class->partial = chunk->next;
+  }
+  if (chunk->next) {
+    chunk->next->prev = chunk->prev;
+  }
+}
@@ -0,0 +1,532 @@
+#include "stack_eval.h"
+#include "ast.h"
+#include "environment.h"
+#include "error_t.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "jit.h"
+#include "object_t.h"
+#include "token.h"
+#include "util_error.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+struct machine {
+  struct frame *frames;
+  size_t frame_count;
+  size_t frame_capacity;
+  struct obj_t **values;
+  size_t value_count;
+  size_t value_capacity;
+};
+
+// clang-format off
+
+static bool push_frame(struct machine *, enum FRAME_KIND, struct environment *);
+static void pop_frame(struct machine *);
+static void pop_call_frame(struct machine *);
+static bool push_value(struct machine *, struct obj_t *);
+static struct obj_t *pop_value(struct machine *);
+static void drop_values(struct machine *, size_t count);
+static bool push_expression(struct machine *, struct environment *, struct expression *);
+static bool push_block(struct machine *, struct environment *, struct statement **, size_t count);
+
+static struct obj_t *run(struct machine *);
+static struct obj_t *step_expression(struct machine *, struct frame *);
+static struct obj_t *step_call(struct machine *, struct frame *);
+static struct obj_t *step_loop(struct machine *, struct frame *);
+static struct obj_t *push_loop_body(struct machine *, struct frame *);
+static struct obj_t *step_statement(struct machine *, struct frame *);
+static struct obj_t *step_block(struct machine *, struct frame *);
+static struct obj_t *unwind_return(struct machine *, struct obj_t *value);
+static void visit_roots(void *machine);
+
+// clang-format on
+
+/**
+ * the step functions return NULL to keep running, anything else stops the
+ * machine with that value (an error, or the value of a top level return)
+ */
+#define CONTINUE NULL
+#define OUT_OF_MEMORY (gc_alloc(OBJECT_SENTINEL))
+
+struct obj_t *stack_eval_run_program(struct environment *env,
+                                     struct program *program) {
+  struct machine m = {0};
+  m.frames = malloc(sizeof(struct frame) * STACK_EVAL_INITIAL_FRAMES);
+  m.values = malloc(sizeof(struct obj_t *) * STACK_EVAL_INITIAL_VALUES);
+  if (!m.frames || !m.values) {
+    ERROR_LOG("error while allocating memory\n");
+    free(m.frames);
+    free(m.values);
+    return NULL;
+  }
+  m.frame_capacity = STACK_EVAL_INITIAL_FRAMES;
+  m.value_capacity = STACK_EVAL_INITIAL_VALUES;
+
+  struct obj_t *result = OUT_OF_MEMORY;
+  gc_push_root_visitor(visit_roots, &m);
+  if (push_block(&m, env, program->statements, program->statement_count)) {
+    result = run(&m);
+  }
+  // an error stops the machine in the middle of its calls
+  while (m.frame_count > 0) {
+    if (m.frames[m.frame_count - 1].kind == FRAME_CALL) {
+      pop_call_frame(&m);
+    } else {
+      pop_frame(&m);
+    }
+  }
+  gc_pop_roots(1);
+  free(m.frames);
+  free(m.values);
+  return result;
+}
+
+static struct obj_t *run(struct machine *m) {
+  while (m->frame_count > 0) {
+    struct frame *frame = &m->frames[m->frame_count - 1];
+    struct obj_t *stop = CONTINUE;
+    switch (frame->kind) {
+    case FRAME_EXPRESSION:
+      stop = step_expression(m, frame);
+      break;
+    case FRAME_STATEMENT:
+      stop = step_statement(m, frame);
+      break;
+    case FRAME_BLOCK:
+      stop = step_block(m, frame);
+      break;
+    case FRAME_CALL:
+      // the body finished without a return, its value is on the stack
+      pop_call_frame(m);
+      break;
+    }
+    if (stop) {
+      return stop;
+    }
+  }
+  return m->value_count > 0 ? m->values[m->value_count - 1]
+                            : gc_alloc(OBJECT_SENTINEL);
+}
+
+/**
+ * the value stack and the environments of the frames are the roots of the
+ * machine, blocks are its safe points (see step_block)
+ */
+static void visit_roots(void *data) {
+  struct machine *m = data;
+  for (size_t i = 0; i < m->value_count; i++) {
+    gc_visit(&m->values[i]);
+  }
+  for (size_t i = 0; i < m->frame_count; i++) {
+    gc_visit_environment(m->frames[i].env);
+  }
+}
+
+// ========================================================================
+
+static bool push_frame(struct machine *m, enum FRAME_KIND kind,
+                       struct environment *env) {
+  if (m->frame_count == m->frame_capacity) {
+    size_t capacity = m->frame_capacity * 2;
+    struct frame *frames = realloc(m->frames, sizeof(struct frame) * capacity);
+    if (!frames) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    m->frames = frames;
+    m->frame_capacity = capacity;
+  }
+  struct frame *frame = &m->frames[m->frame_count++];
+  frame->kind = kind;
+  frame->state = 0;
+  frame->base = m->value_count;
+  frame->env = env;
+  return true;
+}
+
+/**
+ * the stacks give memory back once they are a quarter full, so a deep
+ * recursion does not hold on to its peak
+ */
+static void pop_frame(struct machine *m) {
+  m->frame_count--;
+  if (m->frame_capacity > STACK_EVAL_INITIAL_FRAMES &&
+      m->frame_count < m->frame_capacity / 4) {
+    size_t capacity = m->frame_capacity / 2;
+    struct frame *frames = realloc(m->frames, sizeof(struct frame) * capacity);
+    if (frames) {
+      m->frames = frames;
+      m->frame_capacity = capacity;
+    }
+  }
+}
+
+/**
+ * pop a FRAME_CALL and give back the environment of its call
+ */
+static void pop_call_frame(struct machine *m) {
+  struct frame *frame = &m->frames[m->frame_count - 1];
+  env_release_call(frame->env, frame->captured);
+  pop_frame(m);
+}
+
+static bool push_value(struct machine *m, struct obj_t *value) {
+  if (m->value_count == m->value_capacity) {
+    size_t capacity = m->value_capacity * 2;
+    struct obj_t **values =
+        realloc(m->values, sizeof(struct obj_t *) * capacity);
+    if (!values) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    m->values = values;
+    m->value_capacity = capacity;
+  }
+  m->values[m->value_count++] = value;
+  return true;
+}
+
+static struct obj_t *pop_value(struct machine *m) {
+  struct obj_t *value = m->values[m->value_count - 1];
+  drop_values(m, 1);
+  return value;
+}
+
+static void drop_values(struct machine *m, size_t count) {
+  m->value_count -= count;
+  if (m->value_capacity > STACK_EVAL_INITIAL_VALUES &&
+      m->value_count < m->value_capacity / 4) {
+    size_t capacity = m->value_capacity / 2;
+    struct obj_t **values =
+        realloc(m->values, sizeof(struct obj_t *) * capacity);
+    if (values) {
+      m->values = values;
+      m->value_capacity = capacity;
+    }
+  }
+}
+
+static bool push_expression(struct machine *m, struct environment *env,
+                            struct expression *expr) {
+  if (!push_frame(m, FRAME_EXPRESSION, env)) {
+    return false;
+  }
+  m->frames[m->frame_count - 1].expr = expr;
+  return true;
+}
+
+static bool push_block(struct machine *m, struct environment *env,
+                       struct statement **statements, size_t count) {
+  if (!push_frame(m, FRAME_BLOCK, env)) {
+    return false;
+  }
+  struct frame *frame = &m->frames[m->frame_count - 1];
+  frame->block.statements = statements;
+  frame->block.count = count;
+  return true;
+}
+
+/**
+ * replace the frame on top of the stack by its value
+ */
+static struct obj_t *finish(struct machine *m, struct obj_t *value) {
+  if (has_error(value)) {
+    return value;
+  }
+  pop_frame(m);
+  return push_value(m, value) ? CONTINUE : OUT_OF_MEMORY;
+}
+
+// ========================================================================
+
+/**
+ * a block leaves the value of its last statement on the value stack, the
+ * values of the statements before it are dropped
+ */
+static struct obj_t *step_block(struct machine *m, struct frame *frame) {
+  gc_safe_point();
+  size_t index = frame->state;
+  if (index > 0 && index < frame->block.count) {
+    drop_values(m, 1);
+  }
+  if (index == frame->block.count) {
+    if (index == 0) {
+      return finish(m, gc_alloc(OBJECT_SENTINEL));
+    }
+    pop_frame(m);
+    return CONTINUE;
+  }
+  frame->state++;
+  struct statement *stmt = frame->block.statements[index];
+  if (!push_frame(m, FRAME_STATEMENT, frame->env)) {
+    return OUT_OF_MEMORY;
+  }
+  m->frames[m->frame_count - 1].stmt = stmt;
+  return CONTINUE;
+}
+
+static struct obj_t *step_statement(struct machine *m, struct frame *frame) {
+  struct statement *stmt = frame->stmt;
+  if (!stmt) {
+    return finish(m, gc_alloc(OBJECT_SENTINEL));
+  }
+  switch (stmt->type) {
+  case STMT_LET: {
+    if (frame->state++ == 0) {
+      return push_expression(m, frame->env, stmt->let_stmt.value)
+                 ? CONTINUE
+                 : OUT_OF_MEMORY;
+    }
+    // the value stays on the stack as the value of the statement
+    env_define(frame->env, stmt->let_stmt.ident,
+               m->values[m->value_count - 1]);
+    pop_frame(m);
+    return CONTINUE;
+  };
+  case STMT_RETURN: {
+    if (frame->state++ == 0) {
+      return push_expression(m, frame->env, stmt->return_stmt.value)
+                 ? CONTINUE
+                 : OUT_OF_MEMORY;
+    }
+    return unwind_return(m, pop_value(m));
+  };
+  case STMT_EXPRESSION: {
+    // the statement is replaced by its expression
+    frame->kind = FRAME_EXPRESSION;
+    frame->expr = stmt->expr_stmt.expr;
+    return CONTINUE;
+  };
+  case STMT_FUNCTION_DEF:
+    break;
+  }
+  return finish(m, gc_alloc(OBJECT_SENTINEL));
+}
+
+/**
+ * drop the frames up to the innermost call, its value is the returned
+ * value. a return outside of a function ends the program
+ */
+static struct obj_t *unwind_return(struct machine *m, struct obj_t *value) {
+  while (m->frame_count > 0 &&
+         m->frames[m->frame_count - 1].kind != FRAME_CALL) {
+    pop_frame(m);
+  }
+  if (m->frame_count == 0) {
+    return value;
+  }
+  drop_values(m, m->value_count - m->frames[m->frame_count - 1].base);
+  pop_call_frame(m);
+  return push_value(m, value) ? CONTINUE : OUT_OF_MEMORY;
+}
+
+static struct obj_t *step_expression(struct machine *m, struct frame *frame) {
+  struct expression *expr = frame->expr;
+  struct environment *env = frame->env;
+  if (!expr) {
+    return finish(m, gc_alloc(OBJECT_SENTINEL));
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+    return finish(m, evaluate_literal_expr(expr));
+  case EXPR_IDENTIFIER:
+    return finish(m, evaluate_identifier_expr(env,
+                                              expr->identifier_expr.identifier,
+                                              expr->identifier_expr.token));
+  case EXPR_PREFIX: {
+    struct token *op = expr->prefix_expr.op;
+    if (op->type != BANG && op->type != MINUS) {
+      // ++ and -- only take identifiers, nothing to evaluate first
+      return finish(m, evaluate_prefix_expr(env, op, expr->prefix_expr.right));
+    }
+    if (frame->state++ == 0) {
+      return push_expression(m, env, expr->prefix_expr.right) ? CONTINUE
+                                                              : OUT_OF_MEMORY;
+    }
+    struct obj_t *right = pop_value(m);
+    return finish(m, op->type == BANG
+                         ? evaluate_prefix_bang_operator_expr(op, right)
+                         : evaluate_prefix_minus_operator_expr(op, right));
+  };
+  case EXPR_POSTFIX:
+    return finish(m, evaluate_postfix_expr(env, expr->postfix_expr.op,
+                                           expr->postfix_expr.left));
+  case EXPR_INFIX: {
+    switch (frame->state++) {
+    case 0:
+      return push_expression(m, env, expr->infix_expr.left) ? CONTINUE
+                                                            : OUT_OF_MEMORY;
+    case 1:
+      return push_expression(m, env, expr->infix_expr.right) ? CONTINUE
+                                                             : OUT_OF_MEMORY;
+    default: {
+      struct obj_t *right = pop_value(m);
+      struct obj_t *left = pop_value(m);
+      return finish(m, evaluate_infix_expr(expr->infix_expr.op, left, right));
+    };
+    }
+  };
+  case EXPR_CONDITIONAL: {
+    if (frame->state++ == 0) {
+      return push_expression(m, env, expr->conditional.condition)
+                 ? CONTINUE
+                 : OUT_OF_MEMORY;
+    }
+    struct block_statement *branch = is_truthy(pop_value(m))
+                                         ? expr->conditional.consequence
+                                         : expr->conditional.alternative;
+    if (!branch) {
+      return finish(m, gc_alloc(OBJECT_SENTINEL));
+    }
+    // the if expression is replaced by the block of the branch taken
+    pop_frame(m);
+    return push_block(m, env, branch->statements, branch->statement_count)
+               ? CONTINUE
+               : OUT_OF_MEMORY;
+  };
+  case EXPR_FUNCTION:
+    return finish(m, evaluate_fn_expression(env, expr));
+  case EXPR_FUNCTION_CALL:
+    return step_call(m, frame);
+  case EXPR_LOOP:
+    return step_loop(m, frame);
+  }
+  return finish(m, gc_alloc(OBJECT_SENTINEL));
+}
+
+/**
+ * resume points of a loop frame, named after the child that just finished
+ */
+enum LOOP_STATE {
+  LOOP_START,
+  LOOP_INIT_DONE,
+  LOOP_CONDITION_DONE,
+  LOOP_BODY_DONE,
+  LOOP_UPDATE_DONE,
+};
+
+/**
+ * the loop frame stays on the stack for the whole loop, the values of the
+ * init, the body and the update are dropped as soon as they are produced
+ */
+static struct obj_t *step_loop(struct machine *m, struct frame *frame) {
+  struct expression *expr = frame->expr;
+  struct environment *env = frame->env;
+  switch (frame->state) {
+  case LOOP_START: {
+    if (expr->loop.init) {
+      frame->state = LOOP_INIT_DONE;
+      if (!push_frame(m, FRAME_STATEMENT, env)) {
+        return OUT_OF_MEMORY;
+      }
+      m->frames[m->frame_count - 1].stmt = expr->loop.init;
+      return CONTINUE;
+    }
+  }; break;
+  case LOOP_CONDITION_DONE: {
+    if (!is_truthy(pop_value(m))) {
+      return finish(m, gc_alloc(OBJECT_SENTINEL));
+    }
+    return push_loop_body(m, frame);
+  };
+  case LOOP_BODY_DONE: {
+    drop_values(m, 1);
+    if (expr->loop.update) {
+      frame->state = LOOP_UPDATE_DONE;
+      return push_expression(m, env, expr->loop.update) ? CONTINUE
+                                                        : OUT_OF_MEMORY;
+    }
+  }; break;
+  case LOOP_INIT_DONE:
+  case LOOP_UPDATE_DONE: {
+    drop_values(m, 1);
+  }; break;
+  }
+  if (!expr->loop.condition) {
+    return push_loop_body(m, frame);
+  }
+  frame->state = LOOP_CONDITION_DONE;
+  return push_expression(m, env, expr->loop.condition) ? CONTINUE
+                                                       : OUT_OF_MEMORY;
+}
+
+static struct obj_t *push_loop_body(struct machine *m, struct frame *frame) {
+  frame->state = LOOP_BODY_DONE;
+  struct block_statement *body = frame->expr->loop.body;
+  return push_block(m, frame->env, body->statements, body->statement_count)
+             ? CONTINUE
+             : OUT_OF_MEMORY;
+}
+
+/**
+ * the callee and then the arguments are evaluated onto the value stack, the
+ * frame of the call expression then becomes the FRAME_CALL of the body
+ */
+static struct obj_t *step_call(struct machine *m, struct frame *frame) {
+  struct expression *expr = frame->expr;
+  size_t arg_count = expr->function_call.arg_count;
+  size_t state = frame->state++;
+  if (state == 0) {
+    return push_expression(m, frame->env, expr->function_call.function)
+               ? CONTINUE
+               : OUT_OF_MEMORY;
+  }
+  if (state == 1) {
+    struct obj_t *callee = m->values[m->value_count - 1];
+    if (object_t_type(callee) != OBJECT_FUNCTION) {
+      struct obj_t *err = gc_alloc(OBJECT_ERROR);
+      error_t_format_err(err->err_value, expr->function_call.token,
+                         "invalid function call",
+                         "only functions can be called");
+      return err;
+    }
+  }
+  if (state <= arg_count) {
+    return push_expression(m, frame->env,
+                           expr->function_call.arguments[state - 1])
+               ? CONTINUE
+               : OUT_OF_MEMORY;
+  }
+
+  struct obj_t **args = &m->values[m->value_count - arg_count];
+  struct obj_t *function = args[-1];
+  struct function_proto *proto = function->function_value.proto;
+  if (arg_count < proto->param_count) {
+    struct obj_t *err = gc_alloc(OBJECT_ERROR);
+    error_t_format_err(err->err_value, expr->function_call.token,
+                       "invalid function call",
+                       "not enough arguments for the function parameters");
+    return err;
+  }
+  struct obj_t *native = NULL;
+  if (jit_try_call(function, args, arg_count, &native)) {
+    drop_values(m, arg_count + 1);
+    return finish(m, native);
+  }
+
+  struct environment *child = env_push_call(proto->scope, proto->captured);
+  if (!child) {
+    return OUT_OF_MEMORY;
+  }
+  child->parent = function->function_value.env;
+  for (size_t i = 0; i < proto->param_count; i++) {
+    env_define(child, proto->parameters[i]->id, args[i]);
+  }
+  drop_values(m, arg_count + 1);
+
+  frame->kind = FRAME_CALL;
+  frame->base = m->value_count;
+  frame->env = child;
+  frame->captured = proto->captured;
+  struct block_statement *body = proto->body;
+  if (!body) {
+    pop_call_frame(m);
+    return push_value(m, gc_alloc(OBJECT_SENTINEL)) ? CONTINUE : OUT_OF_MEMORY;
+  }
+  return push_block(m, child, body->statements, body->statement_count)
+             ? CONTINUE
+             : OUT_OF_MEMORY;
+}
@@ -0,0 +1,975 @@
+#include "transpiler.h"
+#include "ast.h"
+#include "lexer.h"
+#include "environment.h"
+#include "parser.h"
+#include "resolver.h"
+#include "string_t.h"
+#include "token.h"
+#include "util_error.h"
+#include "util_file.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * state shared by the whole translation unit, tokens are emitted as static
+ * structs pointing into a copy of the source so that runtime errors print
+ * the same messages as the interpreter
+ */
+struct transpiler {
+  const char *source;
+  size_t source_len;
+  struct token **tokens;
+  size_t token_count;
+  size_t token_capacity;
+  size_t function_count;
+  string_t *declarations; // parameter name tables and prototypes
+  string_t *functions;    // compiled fn literals
+  bool failed;
+};
+
+/**
+ * body of the c function being emitted, expression values are stored in
+ * the numbered temporaries of its array. when no closure refers to the
+ * names of the function they are the first entries of the array, the
+ * temporaries follow. once a return has been written the rest of the block
+ * is unreachable and is not emitted
+ */
+struct emitter {
+  string_t *out;
+  size_t temp_count;
+  int indent;
+  bool returned;
+  const struct scope *scope; // names of the function, NULL for the program
+  size_t param_count;
+  size_t index; // of the fn literal, its prototype is arc_proto_<index>
+  bool tail;    // a tail call jumps back to the start of the body
+};
+
+// clang-format off
+
+static void emitf(string_t *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void emit_line(struct emitter *, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void emit_c_string(string_t *out, const char *data, size_t length);
+static size_t token_ref(struct transpiler *, struct token *);
+static size_t emit_temp(struct emitter *);
+static size_t emit_statements(struct transpiler *, struct emitter *, struct statement **, size_t count, bool used);
+static size_t emit_statement(struct transpiler *, struct emitter *, struct statement *, bool used);
+static size_t emit_expression(struct transpiler *, struct emitter *, struct expression *);
+static bool slot_ref(struct emitter *, const struct scope *, size_t depth, size_t slot, char *lvalue, char *owner, size_t size);
+static size_t emit_identifier(struct transpiler *, struct emitter *, struct expression *);
+static void emit_condition(struct transpiler *, struct emitter *, struct expression *, char *test, size_t size);
+static void emit_effect(struct transpiler *, struct emitter *, struct expression *);
+static size_t emit_literal(struct transpiler *, struct emitter *, struct literal *);
+static size_t emit_step(struct transpiler *, struct emitter *, struct token *, struct expression *);
+static size_t emit_infix(struct transpiler *, struct emitter *, struct expression *);
+static size_t emit_conditional(struct transpiler *, struct emitter *, struct expression *, bool used);
+static size_t emit_loop(struct transpiler *, struct emitter *, struct expression *, bool used);
+static size_t emit_function(struct transpiler *, struct emitter *, struct expression *);
+static size_t emit_call(struct transpiler *, struct emitter *, struct expression *, bool tail);
+static void emit_error_check(struct emitter *, size_t temp);
+static void emit_body(struct transpiler *, struct emitter *, const char *name, struct statement **, size_t count);
+static void emit_scope(struct transpiler *, size_t index, const struct scope *);
+static void emit_tokens(struct transpiler *, string_t *out);
+
+// clang-format on
+
+#define TOKEN_FMT "%s"
+#define TOKEN_ARG(buffer, transpiler, token)                                   \
+  (token_name(buffer, sizeof(buffer), transpiler, token))
+
+static const char *token_name(char *buffer, size_t size, struct transpiler *t,
+                              struct token *token) {
+  if (!token) {
+    return "NULL";
+  }
+  snprintf(buffer, size, "&arc_tok_%zu", token_ref(t, token));
+  return buffer;
+}
+
+bool transpile_file(const char *filename, FILE *out) {
+  file_info *finfo = load_file(filename);
+  if (!finfo) {
+    fprintf(stderr, "could not read %s\n", filename);
+    return false;
+  }
+  struct lexer *l = lexer_init(finfo->buffer, finfo->len);
+  struct parser *p = l ? parser_init(l) : NULL;
+  struct program *program = p ? parser_parse_program(p) : NULL;
+  if (!program || parser_has_errors(p)) {
+    if (p) {
+      parser_print_errors(p);
+    }
+    if (program) {
+      ast_program_free(program);
+    }
+    if (p) {
+      parser_free(p);
+    }
+    free(finfo->buffer);
+    free(finfo);
+    return false;
+  }
+
+  resolve_program(program);
+  struct transpiler t = {
+      .source = finfo->buffer,
+      .source_len = finfo->len,
+      .declarations = init_string_t(256),
+      .functions = init_string_t(1024),
+  };
+  struct emitter main = {.scope = NULL};
+  emit_body(&t, &main, "arc_main", program->statements,
+            program->statement_count);
+
+  if (!t.failed) {
+    string_t *header = init_string_t(1024);
+    emitf(header, "/* generated from %s by interpreter --emit-c */\n",
+          filename);
+    emitf(header, "#include \"runtime.h\"\n\n");
+    emitf(header, "static const char arc_source[] =\n");
+    emit_c_string(header, t.source, t.source_len);
+    emitf(header, ";\n\n");
+    emit_tokens(&t, header);
+
+    fwrite(header->str, 1, header->len, out);
+    fwrite(t.declarations->str, 1, t.declarations->len, out);
+    fwrite(t.functions->str, 1, t.functions->len, out);
+    fprintf(out, "int main(void) {\n"
+                 "  struct environment *env = env_init();\n"
+                 "  if (!env) {\n"
+                 "    return 1;\n"
+                 "  }\n"
+                 "  return arc_run(arc_main, env) ? 0 : 1;\n"
+                 "}\n");
+    free_string_t(header);
+  }
+
+  free_string_t(t.declarations);
+  free_string_t(t.functions);
+  free(t.tokens);
+  ast_program_free(program);
+  parser_free(p);
+  free(finfo->buffer);
+  free(finfo);
+  return !t.failed;
+}
+
+static void emitf(string_t *out, const char *format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  if ((size_t)length < sizeof(buffer)) {
+    string_t_ncat(out, buffer, length);
+    return;
+  }
+  char *large = malloc(length + 1);
+  if (!large) {
+    ERROR_LOG("error while allocating memory\n");
+    return;
+  }
+  va_start(args, format);
+  vsnprintf(large, length + 1, format, args);
+  va_end(args);
+  string_t_ncat(out, large, length);
+  free(large);
+}
+
+static void emit_line(struct emitter *e, const char *format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  emitf(e->out, "%*s%s\n", e->indent * 2, "", buffer);
+}
+
+/**
+ * write data as a c string literal, one literal per source line
+ */
+static void emit_c_string(string_t *out, const char *data, size_t length) {
+  string_t_cat_char(out, '"');
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = data[i];
+    switch (c) {
+    case '"':
+    case '\\':
+      string_t_cat_char(out, '\\');
+      string_t_cat_char(out, c);
+      break;
+    case '\n':
+      string_t_cat(out, "\\n");
+      if (i + 1 < length) {
+        string_t_cat(out, "\"\n\"");
+      }
+      break;
+    case '\t':
+      string_t_cat(out, "\\t");
+      break;
+    default:
+      if (c < 0x20 || c >= 0x7f) {
+        // octal escapes take at most three digits, hex ones do not stop
+        emitf(out, "\\%03o", c);
+      } else {
+        string_t_cat_char(out, c);
+      }
+      break;
+    }
+  }
+  string_t_cat_char(out, '"');
+}
+
+static size_t token_ref(struct transpiler *t, struct token *token) {
+  for (size_t i = 0; i < t->token_count; i++) {
+    if (t->tokens[i] == token) {
+      return i;
+    }
+  }
+  if (t->token_count == t->token_capacity) {
+    size_t capacity = t->token_capacity ? t->token_capacity * 2 : 16;
+    struct token **tokens =
+        realloc(t->tokens, sizeof(struct token *) * capacity);
+    if (!tokens) {
+      ERROR_LOG("error while allocating memory\n");
+      t->failed = true;
+      return 0;
+    }
+    t->tokens = tokens;
+    t->token_capacity = capacity;
+  }
+  t->tokens[t->token_count] = token;
+  return t->token_count++;
+}
+
+static size_t source_offset(struct transpiler *t, const char *pointer) {
+  if (pointer >= t->source && pointer <= t->source + t->source_len) {
+    return pointer - t->source;
+  }
+  return 0;
+}
+
+static void emit_tokens(struct transpiler *t, string_t *out) {
+  for (size_t i = 0; i < t->token_count; i++) {
+    struct token *token = t->tokens[i];
+    emitf(out,
+          "static struct token arc_tok_%zu = {.type = %d, .literal = "
+          "arc_source + %zu, .literal_len = %zu, .line_number = %u, "
+          ".line_start_pos = arc_source + %zu, .col_number = %u};\n",
+          i, token->type, source_offset(t, token->literal), token->literal_len,
+          token->line_number, source_offset(t, token->line_start_pos),
+          token->col_number);
+  }
+  if (t->token_count > 0) {
+    string_t_cat_char(out, '\n');
+  }
+}
+
+static size_t emit_temp(struct emitter *e) { return e->temp_count++; }
+
+static void emit_error_check(struct emitter *e, size_t temp) {
+  emit_line(e, "if (arc_failed(t[%zu])) {", temp);
+  emit_line(e, "  return t[%zu];", temp);
+  emit_line(e, "}");
+}
+
+// return the value of temp, nothing after it in the block is emitted
+static void emit_return(struct emitter *e, size_t temp) {
+  emit_line(e, "return t[%zu];", temp);
+  e->returned = true;
+}
+
+// whether the names of the function are the first entries of its array
+static bool slots_in_array(const struct emitter *e) {
+  return e->scope && !e->scope->captured;
+}
+
+/**
+ * emit a c function evaluating the statements, it returns the value of the
+ * last statement like a block does. the statements go to name_body, name
+ * binds the arguments (to slots of the array or of a new environment when
+ * closures refer to them), gives the body the array and enters it with
+ * arc_enter so that the environment and the array are roots. e has the
+ * scope, param_count and index of the function set
+ */
+static void emit_body(struct transpiler *t, struct emitter *e,
+                      const char *name, struct statement **stmts,
+                      size_t count) {
+  size_t slots = slots_in_array(e) ? e->scope->count : 0;
+  e->out = init_string_t(512);
+  e->temp_count = slots;
+  e->indent = 1;
+  emitf(t->declarations,
+        "static struct obj_t *%s(struct environment *env, "
+        "struct obj_t **args);\n",
+        name);
+  size_t result = emit_statements(t, e, stmts, count, true);
+  if (!e->returned) {
+    emit_return(e, result);
+  }
+
+  emitf(t->functions,
+        "static struct obj_t *%s_body(struct environment *env, "
+        "struct obj_t **t) {\n",
+        name);
+  if (e->tail) {
+    emitf(t->functions, "arc_tail:;\n");
+  }
+  string_t_ncat(t->functions, e->out->str, e->out->len);
+  emitf(t->functions, "}\n\n");
+  size_t size = e->temp_count > 0 ? e->temp_count : 1;
+  emitf(t->functions,
+        "static struct obj_t *%s(struct environment *env, "
+        "struct obj_t **args) {\n"
+        "  struct obj_t *t[%zu] = {0};\n",
+        name, size);
+  if (!e->scope) {
+    emitf(t->functions, "  (void)args;\n");
+  } else if (slots_in_array(e)) {
+    for (size_t i = 0; i < e->param_count; i++) {
+      emitf(t->functions, "  t[%zu] = args[%zu];\n", i, i);
+    }
+  } else {
+    emit_scope(t, e->index, e->scope);
+    emitf(t->functions,
+          "  env = arc_call_env(&arc_scope_%zu, env, args, %zu);\n"
+          "  if (!env) {\n"
+          "    return gc_alloc(OBJECT_SENTINEL);\n"
+          "  }\n",
+          e->index, e->param_count);
+  }
+  emitf(t->functions,
+        "  return arc_enter(%s_body, env, t, %zu);\n"
+        "}\n\n",
+        name, size);
+  free_string_t(e->out);
+}
+
+/**
+ * the names of a function closures refer to, the slots of the environments
+ * of its calls
+ */
+static void emit_scope(struct transpiler *t, size_t index,
+                       const struct scope *scope) {
+  emitf(t->declarations, "static char *arc_names_%zu[] = {", index);
+  for (size_t i = 0; i < scope->count; i++) {
+    emitf(t->declarations, "%s", i > 0 ? ", " : "");
+    emit_c_string(t->declarations, scope->names[i], strlen(scope->names[i]));
+  }
+  emitf(t->declarations,
+        "%s};\n"
+        "static const struct scope arc_scope_%zu = {arc_names_%zu, %zu, %zu, "
+        "true};\n",
+        scope->count > 0 ? "" : "NULL", index, index, scope->count,
+        scope->count);
+}
+
+/**
+ * emit a block, the temporary holding the value of its last statement is
+ * returned when used is set and the block does not end in a return. the
+ * statements after a return are unreachable and left out
+ */
+static size_t emit_statements(struct transpiler *t, struct emitter *e,
+                              struct statement **stmts, size_t count,
+                              bool used) {
+  if (count == 0) {
+    if (!used) {
+      return 0;
+    }
+    size_t temp = emit_temp(e);
+    emit_line(e, "t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+    return temp;
+  }
+  size_t result = 0;
+  for (size_t i = 0; i < count && !e->returned; i++) {
+    result = emit_statement(t, e, stmts[i], used && i + 1 == count);
+  }
+  return result;
+}
+
+static size_t emit_statement(struct transpiler *t, struct emitter *e,
+                             struct statement *stmt, bool used) {
+  switch (stmt->type) {
+  case STMT_LET: {
+    size_t value = emit_expression(t, e, stmt->let_stmt.value);
+    if (e->returned) {
+      return value;
+    }
+    size_t slot = stmt->let_stmt.slot;
+    if (stmt->let_stmt.scope && slots_in_array(e)) {
+      emit_line(e, "t[%zu] = t[%zu];", slot, value);
+    } else if (stmt->let_stmt.scope) {
+      emit_line(e, "arc_bind(env, %zu, t[%zu]);", slot, value);
+    } else {
+      emitf(e->out, "%*senv_define(env, ", e->indent * 2, "");
+      emit_c_string(e->out, stmt->let_stmt.ident,
+                    strlen(stmt->let_stmt.ident));
+      emitf(e->out, ", t[%zu]);\n", value);
+    }
+    return value;
+  };
+  case STMT_RETURN: {
+    struct expression *expr = stmt->return_stmt.value;
+    // a call of the function itself can reuse the array of its slots
+    bool tail = e->scope && expr &&
+                expr->type == EXPR_FUNCTION_CALL &&
+                expr->function_call.arg_count >= e->param_count;
+    size_t value = tail ? emit_call(t, e, expr, true)
+                        : emit_expression(t, e, expr);
+    if (!e->returned) {
+      emit_return(e, value);
+    }
+    return value;
+  };
+  case STMT_EXPRESSION: {
+    if (!used) {
+      emit_effect(t, e, stmt->expr_stmt.expr);
+      return 0;
+    }
+    return emit_expression(t, e, stmt->expr_stmt.expr);
+  };
+  case STMT_FUNCTION_DEF:
+  default: {
+    if (!used) {
+      return 0;
+    }
+    size_t temp = emit_temp(e);
+    emit_line(e, "t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+    return temp;
+  };
+  }
+}
+
+/**
+ * emit an expression whose value nothing reads, literals and fn literals
+ * have no effect and conditionals and loops declare no temporary for their
+ * value
+ */
+static void emit_effect(struct transpiler *t, struct emitter *e,
+                        struct expression *expr) {
+  if (!expr) {
+    return;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_FUNCTION:
+    break;
+  case EXPR_CONDITIONAL:
+    emit_conditional(t, e, expr, false);
+    break;
+  case EXPR_LOOP:
+    emit_loop(t, e, expr, false);
+    break;
+  default:
+    emit_expression(t, e, expr);
+    break;
+  }
+}
+
+static size_t emit_expression(struct transpiler *t, struct emitter *e,
+                              struct expression *expr) {
+  char tok[32];
+  if (!expr) {
+    size_t temp = emit_temp(e);
+    emit_line(e, "t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+    return temp;
+  }
+  switch (expr->type) {
+  case EXPR_LITERAL: {
+    return emit_literal(t, e, &expr->literal);
+  };
+  case EXPR_IDENTIFIER: {
+    return emit_identifier(t, e, expr);
+  };
+  case EXPR_PREFIX: {
+    struct token *op = expr->prefix_expr.op;
+    if (op->type == INC || op->type == DEC) {
+      return emit_step(t, e, op, expr->prefix_expr.right);
+    }
+    if (op->type != BANG && op->type != MINUS) {
+      size_t temp = emit_temp(e);
+      emit_line(e,
+                "t[%zu] = arc_error(" TOKEN_FMT
+                ", \"prefix operator not found\", \"!, -, ++, and -- are the "
+                "only prefix operators permitted\");",
+                temp, TOKEN_ARG(tok, t, op));
+      emit_return(e, temp);
+      return temp;
+    }
+    size_t right = emit_expression(t, e, expr->prefix_expr.right);
+    size_t temp = emit_temp(e);
+    emit_line(e, "t[%zu] = %s(" TOKEN_FMT ", t[%zu]);", temp,
+              op->type == BANG ? "evaluate_prefix_bang_operator_expr"
+                               : "evaluate_prefix_minus_operator_expr",
+              TOKEN_ARG(tok, t, op), right);
+    emit_error_check(e, temp);
+    return temp;
+  };
+  case EXPR_POSTFIX: {
+    return emit_step(t, e, expr->postfix_expr.op, expr->postfix_expr.left);
+  };
+  case EXPR_INFIX: {
+    return emit_infix(t, e, expr);
+  };
+  case EXPR_CONDITIONAL: {
+    return emit_conditional(t, e, expr, true);
+  };
+  case EXPR_FUNCTION: {
+    return emit_function(t, e, expr);
+  };
+  case EXPR_FUNCTION_CALL: {
+    return emit_call(t, e, expr, false);
+  };
+  case EXPR_LOOP: {
+    return emit_loop(t, e, expr, true);
+  };
+  }
+  size_t temp = emit_temp(e);
+  emit_line(e, "t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+  return temp;
+}
+
+/**
+ * the slot the resolver bound a name to as a c lvalue, and in owner the
+ * environment holding it ("NULL" for the array of the function). the
+ * environments of functions without one are skipped by the chain, like
+ * frames are by closures in the tree walker. false for names that are
+ * looked up by name
+ */
+static bool slot_ref(struct emitter *e, const struct scope *scope,
+                     size_t depth, size_t slot, char *lvalue, char *owner,
+                     size_t size) {
+  if (!scope) {
+    return false;
+  }
+  if (scope == e->scope && slots_in_array(e)) {
+    snprintf(lvalue, size, "t[%zu]", slot);
+    snprintf(owner, size, "NULL");
+    return true;
+  }
+  size_t hops = slots_in_array(e) ? depth - 1 : depth;
+  if (hops == 0) {
+    snprintf(owner, size, "env");
+  } else {
+    snprintf(owner, size, "arc_outer(env, %zu)", hops);
+  }
+  snprintf(lvalue, size, "%s->slots[%zu]", owner, slot);
+  return true;
+}
+
+/**
+ * a slot that was not set yet (its let did not run) falls back to looking
+ * the name up, parameters are always set
+ */
+static size_t emit_identifier(struct transpiler *t, struct emitter *e,
+                              struct expression *expr) {
+  char tok[32];
+  char lvalue[64];
+  char owner[64];
+  size_t temp = emit_temp(e);
+  char *name = expr->identifier_expr.identifier;
+  const struct scope *scope = expr->identifier_expr.scope;
+  size_t slot = expr->identifier_expr.slot;
+  bool bound = slot_ref(e, scope, expr->identifier_expr.depth, slot, lvalue,
+                        owner, sizeof(lvalue));
+  if (bound) {
+    emit_line(e, "t[%zu] = %s;", temp, lvalue);
+    if (scope == e->scope && slot < e->param_count) {
+      return temp;
+    }
+    emit_line(e, "if (!t[%zu]) {", temp);
+    e->indent++;
+  }
+  emitf(e->out, "%*st[%zu] = evaluate_identifier_expr(env, ", e->indent * 2,
+        "", temp);
+  emit_c_string(e->out, name, strlen(name));
+  emitf(e->out, ", " TOKEN_FMT ");\n",
+        TOKEN_ARG(tok, t, expr->identifier_expr.token));
+  emit_error_check(e, temp);
+  if (bound) {
+    e->indent--;
+    emit_line(e, "}");
+  }
+  return temp;
+}
+
+/**
+ * literals are allocated on every evaluation, ++ and -- update the bound
+ * object in place so a shared literal object would change its value
+ */
+static size_t emit_literal(struct transpiler *t, struct emitter *e,
+                           struct literal *literal) {
+  (void)t;
+  size_t temp = emit_temp(e);
+  switch (literal->literal_type) {
+  case LITERAL_INT:
+    emit_line(e, "t[%zu] = arc_int(%d);", temp,
+              literal->value.int_value);
+    break;
+  case LITERAL_FLOAT:
+    // hexadecimal floats round trip exactly
+    emit_line(e, "t[%zu] = arc_double(%a);", temp,
+              literal->value.float_value);
+    break;
+  case LITERAL_BOOL:
+    emit_line(e, "t[%zu] = gc_alloc(%s);", temp,
+              literal->value.bool_value ? "OBJECT_BOOL_TRUE"
+                                        : "OBJECT_BOOL_FALSE");
+    break;
+  case LITERAL_CHAR:
+    emit_line(e, "t[%zu] = arc_char(%d);", temp,
+              literal->value.char_value);
+    break;
+  case LITERAL_STRING: {
+    struct string_literal *string = literal->value.string_literal;
+    emitf(e->out, "%*st[%zu] = arc_string(", e->indent * 2, "",
+          temp);
+    emit_c_string(e->out, string->value, string->length);
+    emitf(e->out, ", %zu);\n", string->length);
+  }; break;
+  }
+  return temp;
+}
+
+static size_t emit_step(struct transpiler *t, struct emitter *e,
+                        struct token *op, struct expression *operand) {
+  char tok[32];
+  size_t temp = emit_temp(e);
+  if (!operand || operand->type != EXPR_IDENTIFIER) {
+    emit_line(e,
+              "t[%zu] = arc_error(" TOKEN_FMT
+              ", \"operation not permitted on non-identifier expressions\", "
+              "NULL);",
+              temp, TOKEN_ARG(tok, t, op));
+    emit_return(e, temp);
+    return temp;
+  }
+  char *name = operand->identifier_expr.identifier;
+  char lvalue[64];
+  char owner[64];
+  if (slot_ref(e, operand->identifier_expr.scope,
+               operand->identifier_expr.depth, operand->identifier_expr.slot,
+               lvalue, owner, sizeof(lvalue))) {
+    emitf(e->out, "%*st[%zu] = arc_step_slot(%s, &%s, env, ", e->indent * 2,
+          "", temp, owner, lvalue);
+  } else {
+    emitf(e->out, "%*st[%zu] = arc_step(env, ", e->indent * 2, "", temp);
+  }
+  emit_c_string(e->out, name, strlen(name));
+  emitf(e->out, ", " TOKEN_FMT ", %d);\n", TOKEN_ARG(tok, t, op),
+        op->type == INC ? 1 : -1);
+  emit_error_check(e, temp);
+  return temp;
+}
+
+static size_t emit_infix(struct transpiler *t, struct emitter *e,
+                         struct expression *expr) {
+  char tok[32];
+  size_t left = emit_expression(t, e, expr->infix_expr.left);
+  size_t right = emit_expression(t, e, expr->infix_expr.right);
+  struct token *op = expr->infix_expr.op;
+  const char *helper = "evaluate_infix_expr";
+  switch (op->type) {
+  case PLUS:
+    helper = "arc_add";
+    break;
+  case MINUS:
+    helper = "arc_sub";
+    break;
+  case ASTERISK:
+    helper = "arc_mul";
+    break;
+  case SLASH:
+    helper = "arc_div";
+    break;
+  case MOD:
+    helper = "arc_mod";
+    break;
+  case LT:
+    helper = "arc_lt";
+    break;
+  case GT:
+    helper = "arc_gt";
+    break;
+  case LT_EQ:
+    helper = "arc_lt_eq";
+    break;
+  case GT_EQ:
+    helper = "arc_gt_eq";
+    break;
+  case EQ_EQ:
+    helper = "arc_eq_eq";
+    break;
+  case NOT_EQ:
+    helper = "arc_not_eq";
+    break;
+  default:
+    break;
+  }
+  size_t temp = emit_temp(e);
+  emit_line(e, "t[%zu] = %s(" TOKEN_FMT ", t[%zu], t[%zu]);", temp,
+            helper, TOKEN_ARG(tok, t, op), left, right);
+  emit_error_check(e, temp);
+  return temp;
+}
+
+static const char *comparison_test(enum TOKEN_TYPE type) {
+  switch (type) {
+  case LT:
+    return "arc_test_lt";
+  case GT:
+    return "arc_test_gt";
+  case LT_EQ:
+    return "arc_test_lt_eq";
+  case GT_EQ:
+    return "arc_test_gt_eq";
+  case EQ_EQ:
+    return "arc_test_eq_eq";
+  case NOT_EQ:
+    return "arc_test_not_eq";
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * emit the condition of a conditional or loop and write the c expression
+ * testing it to test. a comparison is tested without making a bool object
+ */
+static void emit_condition(struct transpiler *t, struct emitter *e,
+                           struct expression *expr, char *test, size_t size) {
+  char tok[32];
+  const char *helper = NULL;
+  if (expr && expr->type == EXPR_INFIX) {
+    helper = comparison_test(expr->infix_expr.op->type);
+  }
+  if (!helper) {
+    size_t condition = emit_expression(t, e, expr);
+    snprintf(test, size, "is_truthy(t[%zu])", condition);
+    return;
+  }
+  size_t left = emit_expression(t, e, expr->infix_expr.left);
+  size_t right = emit_expression(t, e, expr->infix_expr.right);
+  size_t temp = emit_temp(e);
+  emit_line(e, "int c%zu = %s(" TOKEN_FMT ", t[%zu], t[%zu], &t[%zu]);",
+            temp, helper, TOKEN_ARG(tok, t, expr->infix_expr.op), left, right,
+            temp);
+  emit_line(e, "if (c%zu < 0) {", temp);
+  emit_line(e, "  return t[%zu];", temp);
+  emit_line(e, "}");
+  snprintf(test, size, "c%zu", temp);
+}
+
+/**
+ * a branch that returns does not assign the value, the code after the
+ * conditional is unreachable when both branches return
+ */
+static size_t emit_conditional(struct transpiler *t, struct emitter *e,
+                               struct expression *expr, bool used) {
+  char test[48];
+  emit_condition(t, e, expr->conditional.condition, test, sizeof(test));
+  size_t temp = used ? emit_temp(e) : 0;
+  emit_line(e, "if (%s) {", test);
+  e->indent++;
+  struct block_statement *consequence = expr->conditional.consequence;
+  size_t value =
+      consequence ? emit_statements(t, e, consequence->statements,
+                                    consequence->statement_count, used)
+                  : emit_statements(t, e, NULL, 0, used);
+  if (used && !e->returned) {
+    emit_line(e, "t[%zu] = t[%zu];", temp, value);
+  }
+  bool returned = e->returned;
+  e->returned = false;
+  e->indent--;
+  struct block_statement *alternative = expr->conditional.alternative;
+  if (alternative) {
+    emit_line(e, "} else {");
+    e->indent++;
+    value = emit_statements(t, e, alternative->statements,
+                            alternative->statement_count, used);
+    if (used && !e->returned) {
+      emit_line(e, "t[%zu] = t[%zu];", temp, value);
+    }
+    e->returned = returned && e->returned;
+    e->indent--;
+  } else if (used) {
+    emit_line(e, "} else {");
+    emit_line(e, "  t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+  }
+  emit_line(e, "}");
+  return temp;
+}
+
+/**
+ * the condition is emitted inside the c loop so it runs on every iteration,
+ * the back edge is a safe point. a return in the body only ends the block
+ * of the body, the loop can run zero times
+ */
+static size_t emit_loop(struct transpiler *t, struct emitter *e,
+                        struct expression *expr, bool used) {
+  if (expr->loop.init) {
+    emit_statement(t, e, expr->loop.init, false);
+  }
+  emit_line(e, "for (;;) {");
+  e->indent++;
+  if (expr->loop.condition) {
+    char test[48];
+    emit_condition(t, e, expr->loop.condition, test, sizeof(test));
+    emit_line(e, "if (!%s) {", test);
+    emit_line(e, "  break;");
+    emit_line(e, "}");
+  }
+  struct block_statement *body = expr->loop.body;
+  if (body) {
+    emit_statements(t, e, body->statements, body->statement_count, false);
+  }
+  if (!e->returned) {
+    if (expr->loop.update) {
+      emit_effect(t, e, expr->loop.update);
+    }
+    emit_line(e, "gc_safe_point();");
+  }
+  e->returned = false;
+  e->indent--;
+  emit_line(e, "}");
+  if (!used) {
+    return 0;
+  }
+  size_t temp = emit_temp(e);
+  emit_line(e, "t[%zu] = gc_alloc(OBJECT_SENTINEL);", temp);
+  return temp;
+}
+
+static size_t emit_function(struct transpiler *t, struct emitter *e,
+                            struct expression *expr) {
+  char tok[32];
+  struct function_literal *literal = &expr->function;
+  size_t index = t->function_count++;
+  char name[32];
+  snprintf(name, sizeof(name), "arc_fn_%zu", index);
+
+  emitf(t->declarations, "static struct function_proto *arc_proto_%zu;\n",
+        index);
+  if (literal->param_count > 0) {
+    emitf(t->declarations, "static const char *const arc_params_%zu[] = {",
+          index);
+    for (size_t i = 0; i < literal->param_count; i++) {
+      char *id = literal->parameters[i]->id;
+      emitf(t->declarations, "%s", i > 0 ? ", " : "");
+      emit_c_string(t->declarations, id, strlen(id));
+    }
+    emitf(t->declarations, "};\n");
+  }
+  if (!literal->scope) {
+    t->failed = true; // the resolver ran out of memory
+  }
+  struct block_statement *body = literal->body;
+  struct emitter inner = {.scope = literal->scope,
+                          .param_count = literal->param_count,
+                          .index = index};
+  if (literal->scope) {
+    emit_body(t, &inner, name, body ? body->statements : NULL,
+              body ? body->statement_count : 0);
+  }
+
+  size_t temp = emit_temp(e);
+  char params[48] = "NULL";
+  if (literal->param_count > 0) {
+    snprintf(params, sizeof(params), "arc_params_%zu", index);
+  }
+  emit_line(e,
+            "t[%zu] = arc_function(env, " TOKEN_FMT
+            ", &arc_proto_%zu, %s, %zu, %s);",
+            temp, TOKEN_ARG(tok, t, literal->token), index, params,
+            literal->param_count, name);
+  return temp;
+}
+
+/**
+ * a tail call of the running function with the same closure environment
+ * does not nest a c call, the body starts over. the arguments are bound to
+ * the parameters and the slots of the lets are unset again, or they are
+ * bound in a new call environment when closures refer to the names
+ */
+static void emit_tail_call(struct emitter *e, size_t callee, size_t *args,
+                           size_t temp) {
+  const char *closure = slots_in_array(e) ? "env" : "env->parent";
+  emit_line(e, "if (arc_is_self(t[%zu], arc_proto_%zu, %s)) {", callee,
+            e->index, closure);
+  e->indent++;
+  if (slots_in_array(e)) {
+    for (size_t i = 0; i < e->param_count; i++) {
+      emit_line(e, "t[%zu] = t[%zu];", i, args[i]);
+    }
+    for (size_t i = e->param_count; i < e->scope->count; i++) {
+      emit_line(e, "t[%zu] = NULL;", i);
+    }
+  } else {
+    char array[32] = "NULL";
+    if (e->param_count > 0) {
+      snprintf(array, sizeof(array), "a%zu", temp);
+    }
+    emit_line(e, "env = arc_call_env(&arc_scope_%zu, env->parent, %s, %zu);",
+              e->index, array, e->param_count);
+    emit_line(e, "if (!env) {");
+    emit_line(e, "  return gc_alloc(OBJECT_SENTINEL);");
+    emit_line(e, "}");
+    emit_line(e, "arc_reenter(env);");
+  }
+  emit_line(e, "gc_safe_point();");
+  emit_line(e, "goto arc_tail;");
+  e->indent--;
+  emit_line(e, "}");
+  e->tail = true;
+}
+
+static size_t emit_call(struct transpiler *t, struct emitter *e,
+                        struct expression *expr, bool tail) {
+  char tok[32];
+  size_t callee = emit_expression(t, e, expr->function_call.function);
+  size_t arg_count = expr->function_call.arg_count;
+  size_t *args = NULL;
+  if (arg_count > 0) {
+    args = malloc(sizeof(size_t) * arg_count);
+    if (!args) {
+      ERROR_LOG("error while allocating memory\n");
+      t->failed = true;
+      return callee;
+    }
+  }
+  for (size_t i = 0; i < arg_count; i++) {
+    args[i] = emit_expression(t, e, expr->function_call.arguments[i]);
+  }
+  size_t temp = emit_temp(e);
+  if (arg_count > 0) {
+    emitf(e->out, "%*sstruct obj_t *a%zu[] = {", e->indent * 2, "", temp);
+    for (size_t i = 0; i < arg_count; i++) {
+      emitf(e->out, "%st[%zu]", i > 0 ? ", " : "", args[i]);
+    }
+    emitf(e->out, "};\n");
+  }
+  if (tail) {
+    emit_tail_call(e, callee, args, temp);
+  }
+  if (arg_count > 0) {
+    emit_line(e,
+              "t[%zu] = arc_call(" TOKEN_FMT ", t[%zu], a%zu, %zu);",
+              temp, TOKEN_ARG(tok, t, expr->function_call.token), callee, temp,
+              arg_count);
+  } else {
+    emit_line(e, "t[%zu] = arc_call(" TOKEN_FMT ", t[%zu], NULL, 0);",
+              temp, TOKEN_ARG(tok, t, expr->function_call.token), callee);
+  }
+  emit_error_check(e, temp);
+  free(args);
+  return temp;
+}
@@ -9,7 +9,7 @@
 int read_file(file_info *finfo) {
   FILE *file = fopen(finfo->filename, "r");
   if (!file) {
-    ERROR_LOG("error while allocating memory");
+    ERROR_LOG("error while opening file");
     return -1;
   }
 
@@ -42,7 +42,8 @@ file_info *load_file(const char *filename) {
   finfo->filename = filename;
 
   int status = read_file(finfo);
-  if (!status) {
+  if (status) {
+    free(finfo);
     return NULL;
   }
 
@@ -120,6 +120,33 @@ void t_expr_repr(struct expression *expr, string_t *str) {
       string_t_ncat(str, "}", 1);
     }
   }; break;
+  case EXPR_LOOP: {
+    string_t_ncat(str, (char *)expr->loop.token->literal,
+                  expr->loop.token->literal_len);
+    string_t_ncat(str, "(", 1);
+    bool is_for = expr->loop.token->type == FOR;
+    if (expr->loop.init) {
+      t_stmt_repr(expr->loop.init, str);
+      if (expr->loop.init->type == STMT_EXPRESSION) {
+        string_t_ncat(str, ";", 1);
+      }
+    } else if (is_for) {
+      string_t_ncat(str, ";", 1);
+    }
+    if (expr->loop.condition) {
+      t_expr_repr(expr->loop.condition, str);
+    }
+    if (is_for) {
+      string_t_ncat(str, ";", 1);
+    }
+    if (expr->loop.update) {
+      t_expr_repr(expr->loop.update, str);
+    }
+    string_t_ncat(str, ")", 1);
+    string_t_ncat(str, "{", 1);
+    t_block_stmt_repr(expr->loop.body, str);
+    string_t_ncat(str, "}", 1);
+  }; break;
   case EXPR_FUNCTION: {
     string_t_cat(str, "fn");
     string_t_ncat(str, "(", 1);
@@ -151,26 +178,26 @@ void t_object_repr(struct obj_t *object, string_t *str) {
   if (!object) {
     return;
   }
-  switch (object->type) {
+  switch (object_t_type(object)) {
   case OBJECT_INT: {
-    size_t number_len = snprintf(NULL, 0, "%d", object->int_value);
+    size_t number_len = snprintf(NULL, 0, "%d", object_t_int(object));
     char buffer[number_len + 1];
-    snprintf(buffer, sizeof(buffer), "%d", object->int_value);
+    snprintf(buffer, sizeof(buffer), "%d", object_t_int(object));
     string_t_cat(str, "<integer>(");
     string_t_cat(str, buffer);
     string_t_cat(str, ")");
   }; break;
   case OBJECT_DOUBLE: {
-    size_t number_len = snprintf(NULL, 0, "%lf", object->double_value);
+    size_t number_len = snprintf(NULL, 0, "%lf", object_t_double(object));
     char buffer[number_len + 1];
-    snprintf(buffer, sizeof(buffer), "%f", object->double_value);
+    snprintf(buffer, sizeof(buffer), "%f", object_t_double(object));
     string_t_cat(str, "<float>(");
     string_t_cat(str, buffer);
     string_t_cat(str, ")");
   }; break;
   case OBJECT_BOOL: {
     string_t_cat(str, "<boolean>(");
-    if (object->bool_value) {
+    if (object_t_bool(object)) {
       string_t_cat(str, "true");
     } else {
       string_t_cat(str, "false");
@@ -189,7 +216,7 @@ void t_object_repr(struct obj_t *object, string_t *str) {
   }; break;
   case OBJECT_CHAR: {
     string_t_cat(str, "<char>(");
-    string_t_cat_char(str, object->rune_value);
+    string_t_cat_char(str, object_t_char(object));
     string_t_cat(str, ")");
   }; break;
   case OBJECT_RETURN: {
@@ -200,13 +227,14 @@ void t_object_repr(struct obj_t *object, string_t *str) {
   case OBJECT_FUNCTION: {
     string_t_cat(str, "<function>(");
     string_t_cat(str, "<parameters>(");
-    for (size_t i = 0; i < object->function_value.param_count; i++) {
-      string_t_cat(str, (char *)object->function_value.parameters[i]->id);
+    struct function_proto *proto = object->function_value.proto;
+    for (size_t i = 0; i < proto->param_count; i++) {
+      string_t_cat(str, (char *)proto->parameters[i]->id);
       string_t_cat(str, ",");
     }
     string_t_cat(str, ")");
     string_t_cat(str, "{");
-    t_block_stmt_repr(object->function_value.blk_stmts, str);
+    t_block_stmt_repr(proto->body, str);
     string_t_cat(str, "}");
     string_t_cat(str, ")");
   }; break;
@@ -0,0 +1,464 @@
+#include "vm.h"
+#include "compiler.h"
+#include "environment.h"
+#include "error_t.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object_t.h"
+#include "util_error.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define VM_INITIAL_STACK_SIZE 256
+#define VM_INITIAL_FRAME_COUNT 64
+
+/**
+ * vm_frame is an active function call, slots of the frame start at base
+ * in the value stack (the function object being called sits at base - 1)
+ */
+struct vm_frame {
+  struct chunk *chunk;
+  uint8_t *ip;
+  size_t base;
+  struct environment *env;
+};
+
+/**
+ * both stacks live on the heap and grow on demand, calls between functions
+ * do not recurse on the c stack
+ */
+struct vm {
+  struct obj_t **stack;
+  size_t stack_capacity;
+  size_t top; // height of the value stack at the last safe point
+  struct vm_frame *frames;
+  size_t frame_count;
+  size_t frame_capacity;
+};
+
+// clang-format off
+
+static struct obj_t *vm_execute(struct vm *, struct chunk *, struct environment *);
+static bool vm_reserve_stack(struct vm *, size_t size);
+static bool vm_push_frame(struct vm *, struct chunk *, size_t base, struct environment *);
+static void vm_visit_roots(void *vm);
+
+// clang-format on
+
+struct obj_t *vm_run_program(struct environment *env,
+                             struct program *program) {
+  struct chunk *chunk = compiler_compile_program(program);
+  if (!chunk) {
+    return NULL;
+  }
+  struct vm vm = {NULL, 0, 0, NULL, 0, 0};
+  gc_push_root_visitor(vm_visit_roots, &vm);
+  struct obj_t *result = vm_execute(&vm, chunk, env);
+  gc_pop_roots(1);
+  free(vm.stack);
+  free(vm.frames);
+  chunk_free(chunk);
+  return result;
+}
+
+/**
+ * the values below the top of the stack and the environments of the frames
+ * are roots, vm_execute stores the top before it reaches a safe point
+ */
+static void vm_visit_roots(void *data) {
+  struct vm *vm = data;
+  for (size_t i = 0; i < vm->top; i++) {
+    gc_visit(&vm->stack[i]);
+  }
+  for (size_t i = 0; i < vm->frame_count; i++) {
+    gc_visit_environment(vm->frames[i].env);
+  }
+}
+
+static bool vm_reserve_stack(struct vm *vm, size_t size) {
+  if (size <= vm->stack_capacity) {
+    return true;
+  }
+  size_t capacity = vm->stack_capacity ? vm->stack_capacity
+                                       : VM_INITIAL_STACK_SIZE;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  struct obj_t **stack = realloc(vm->stack, sizeof(struct obj_t *) * capacity);
+  if (!stack) {
+    ERROR_LOG("error while allocating memory\n");
+    return false;
+  }
+  vm->stack = stack;
+  vm->stack_capacity = capacity;
+  return true;
+}
+
+static bool vm_push_frame(struct vm *vm, struct chunk *chunk, size_t base,
+                          struct environment *env) {
+  if (vm->frame_count >= vm->frame_capacity) {
+    size_t capacity = vm->frame_capacity ? vm->frame_capacity * 2
+                                         : VM_INITIAL_FRAME_COUNT;
+    struct vm_frame *frames =
+        realloc(vm->frames, sizeof(struct vm_frame) * capacity);
+    if (!frames) {
+      ERROR_LOG("error while allocating memory\n");
+      return false;
+    }
+    vm->frames = frames;
+    vm->frame_capacity = capacity;
+  }
+  if (!vm_reserve_stack(vm, base + chunk->slot_count + chunk->max_stack)) {
+    return false;
+  }
+  struct vm_frame *frame = &vm->frames[vm->frame_count++];
+  frame->chunk = chunk;
+  frame->ip = chunk->code;
+  frame->base = base;
+  frame->env = env;
+  return true;
+}
+
+struct obj_t *vm_error(struct token *token, const char *message,
+                       const char *help) {
+  struct obj_t *err = gc_alloc(OBJECT_ERROR);
+  if (err) {
+    error_t_format_err(err->err_value, token, message, help);
+  }
+  return err;
+}
+
+/**
+ * new value for the target of ++ (delta 1) or -- (delta -1)
+ */
+struct obj_t *vm_step(struct token *token, struct obj_t *value, int delta) {
+  if (object_t_is_int(value)) {
+    return gc_int(object_t_int(value) + delta);
+  } else if (object_t_type(value) == OBJECT_DOUBLE) {
+    return gc_double(object_t_double(value) + delta);
+  }
+  return vm_error(token, "operation not permitted on non numerical identifiers",
+                  "operation only permitted on integer or floating point "
+                  "identifiers (variables)");
+}
+
+struct obj_t *vm_raise(struct token *token, enum RAISE_KIND kind) {
+  switch (kind) {
+  case RAISE_UNKNOWN_PREFIX:
+    return vm_error(token, "prefix operator not found",
+                    "!, -, ++, and -- are the only prefix operators permitted");
+  case RAISE_NON_IDENTIFIER:
+    return vm_error(token,
+                    "operation not permitted on non-identifier expressions",
+                    NULL);
+  }
+  return gc_alloc(OBJECT_SENTINEL);
+}
+
+// clang-format off
+
+#define READ_BYTE() (*ip++)
+#define READ_U16() (ip += 2, (uint16_t)(ip[-2] | (ip[-1] << 8)))
+#define TOKEN(idx) (frame->chunk->tokens[(idx)])
+#define NAME(idx) (frame->chunk->names[(idx)])
+
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK(distance) (sp[-1 - (distance)])
+
+// store the cached registers back into the frame / reload them from it
+#define SAVE_FRAME() (frame->ip = ip)
+#define LOAD_FRAME()                                                           \
+  do {                                                                         \
+    frame = &vm->frames[vm->frame_count - 1];                                  \
+    ip = frame->ip;                                                            \
+    slots = vm->stack + frame->base;                                           \
+  } while (0)
+
+#define THROW(error)                                                           \
+  do {                                                                         \
+    result = (error);                                                          \
+    goto done;                                                                 \
+  } while (0)
+
+// the stack below sp is what the gc visits (vm_visit_roots)
+#define SAFE_POINT()                                                           \
+  do {                                                                         \
+    vm->top = sp - vm->stack;                                                  \
+    gc_safe_point();                                                           \
+  } while (0)
+
+/**
+ * int (op) int is handled inline, everything else goes through the
+ * operator semantics shared with the tree walker
+ */
+#define BINARY_OP(int_expr)                                                    \
+  do {                                                                         \
+    struct token *token = TOKEN(READ_U16());                                   \
+    struct obj_t *right = POP();                                               \
+    struct obj_t *left = POP();                                                \
+    struct obj_t *value;                                                       \
+    if (object_t_is_int(left) && object_t_is_int(right)) {                     \
+      value = (int_expr);                                                      \
+    } else {                                                                   \
+      value = evaluate_infix_expr(token, left, right);                         \
+      if (has_error(value)) {                                                  \
+        THROW(value);                                                          \
+      }                                                                        \
+    }                                                                          \
+    PUSH(value);                                                               \
+  } while (0)
+
+#define INT_RESULT(op) int_result(object_t_int(left) op object_t_int(right))
+#define BOOL_RESULT(op)                                                        \
+  (object_t_int(left) op object_t_int(right) ? gc_alloc(OBJECT_BOOL_TRUE)      \
+                                             : gc_alloc(OBJECT_BOOL_FALSE))
+
+// clang-format on
+
+static inline struct obj_t *int_result(int value) {
+  return gc_int(value);
+}
+
+static struct obj_t *vm_execute(struct vm *vm, struct chunk *chunk,
+                                struct environment *env) {
+  if (!vm_push_frame(vm, chunk, 0, env)) {
+    return gc_alloc(OBJECT_SENTINEL);
+  }
+
+  struct obj_t *result = NULL;
+  struct vm_frame *frame;
+  uint8_t *ip;
+  struct obj_t **slots;
+  struct obj_t **sp = vm->stack;
+  LOAD_FRAME();
+
+  for (;;) {
+    switch ((enum OPCODE)READ_BYTE()) {
+    case OP_CONSTANT: {
+      PUSH(frame->chunk->constants[READ_U16()]);
+    }; break;
+    case OP_SENTINEL: {
+      PUSH(gc_alloc(OBJECT_SENTINEL));
+    }; break;
+    case OP_TRUE: {
+      PUSH(gc_alloc(OBJECT_BOOL_TRUE));
+    }; break;
+    case OP_FALSE: {
+      PUSH(gc_alloc(OBJECT_BOOL_FALSE));
+    }; break;
+    case OP_POP: {
+      sp--;
+    }; break;
+    case OP_DUP: {
+      struct obj_t *top = PEEK(0);
+      PUSH(top);
+    }; break;
+
+    case OP_GET_NAME: {
+      char *name = NAME(READ_U16());
+      struct token *token = TOKEN(READ_U16());
+      struct obj_t *value = env_look_up(frame->env, name);
+      if (!value) {
+        THROW(vm_error(token, "identifier not found", NULL));
+      }
+      PUSH(value);
+    }; break;
+    case OP_DEFINE_NAME: {
+      env_define(frame->env, NAME(READ_U16()), PEEK(0));
+    }; break;
+    case OP_SET_NAME: {
+      env_set(frame->env, NAME(READ_U16()), PEEK(0));
+    }; break;
+    case OP_GET_LOCAL: {
+      uint8_t slot = READ_BYTE();
+      char *name = NAME(READ_U16());
+      struct token *token = TOKEN(READ_U16());
+      struct obj_t *value = slots[slot];
+      if (!value) {
+        // the let that binds the slot has not run (yet), use the outer scope
+        value = env_look_up(frame->env, name);
+        if (!value) {
+          THROW(vm_error(token, "identifier not found", NULL));
+        }
+      }
+      PUSH(value);
+    }; break;
+    case OP_SET_LOCAL: {
+      slots[READ_BYTE()] = PEEK(0);
+    }; break;
+
+    case OP_ADD: {
+      BINARY_OP(INT_RESULT(+));
+    }; break;
+    case OP_SUB: {
+      BINARY_OP(INT_RESULT(-));
+    }; break;
+    case OP_MUL: {
+      BINARY_OP(INT_RESULT(*));
+    }; break;
+    case OP_LT: {
+      BINARY_OP(BOOL_RESULT(<));
+    }; break;
+    case OP_GT: {
+      BINARY_OP(BOOL_RESULT(>));
+    }; break;
+    case OP_LT_EQ: {
+      BINARY_OP(BOOL_RESULT(<=));
+    }; break;
+    case OP_GT_EQ: {
+      BINARY_OP(BOOL_RESULT(>=));
+    }; break;
+    case OP_EQ_EQ: {
+      BINARY_OP(BOOL_RESULT(==));
+    }; break;
+    case OP_NOT_EQ: {
+      BINARY_OP(BOOL_RESULT(!=));
+    }; break;
+    case OP_INFIX: {
+      struct token *token = TOKEN(READ_U16());
+      struct obj_t *right = POP();
+      struct obj_t *left = POP();
+      struct obj_t *value = evaluate_infix_expr(token, left, right);
+      if (has_error(value)) {
+        THROW(value);
+      }
+      PUSH(value);
+    }; break;
+
+    case OP_NOT: {
+      struct token *token = TOKEN(READ_U16());
+      PEEK(0) = evaluate_prefix_bang_operator_expr(token, PEEK(0));
+    }; break;
+    case OP_NEGATE: {
+      struct token *token = TOKEN(READ_U16());
+      struct obj_t *value = evaluate_prefix_minus_operator_expr(token, PEEK(0));
+      if (has_error(value)) {
+        THROW(value);
+      }
+      PEEK(0) = value;
+    }; break;
+    case OP_INC:
+    case OP_DEC: {
+      int delta = ip[-1] == OP_INC ? 1 : -1;
+      struct obj_t *value = vm_step(TOKEN(READ_U16()), PEEK(0), delta);
+      if (has_error(value)) {
+        THROW(value);
+      }
+      PEEK(0) = value;
+    }; break;
+    case OP_RAISE: {
+      struct token *token = TOKEN(READ_U16());
+      THROW(vm_raise(token, READ_BYTE()));
+    }; break;
+
+    case OP_JUMP: {
+      uint16_t offset = READ_U16();
+      ip += offset;
+    }; break;
+    case OP_JUMP_IF_FALSE: {
+      uint16_t offset = READ_U16();
+      if (!is_truthy(POP())) {
+        ip += offset;
+      }
+    }; break;
+    case OP_LOOP: {
+      uint16_t offset = READ_U16();
+      ip -= offset;
+      SAFE_POINT();
+    }; break;
+
+    case OP_CLOSURE: {
+      struct chunk *function = frame->chunk->functions[READ_U16()];
+      struct obj_t *obj = gc_alloc(OBJECT_FUNCTION);
+      if (!obj) {
+        THROW(gc_alloc(OBJECT_SENTINEL));
+      }
+      if (!function->proto) {
+        function->proto =
+            function_proto_init(function->parameters, function->param_count,
+                                function->param_capacity, function->body, NULL);
+        if (!function->proto) {
+          THROW(gc_alloc(OBJECT_SENTINEL));
+        }
+        function->proto->chunk = function;
+      }
+      obj->function_value.env = frame->env;
+      obj->function_value.proto = function->proto;
+      PUSH(obj);
+    }; break;
+    case OP_CALL: {
+      uint8_t arg_count = READ_BYTE();
+      struct token *token = TOKEN(READ_U16());
+      struct obj_t *callee = PEEK(arg_count);
+      if (object_t_type(callee) != OBJECT_FUNCTION) {
+        THROW(vm_error(token, "invalid function call",
+                       "only functions can be called"));
+      }
+      struct function_proto *proto = callee->function_value.proto;
+      struct chunk *function = proto->chunk;
+      if (!function) {
+        // created by another engine, compile it the first time it is called
+        function = compiler_compile_function(
+            proto->parameters, proto->param_count, proto->param_capacity,
+            proto->body);
+        if (!function) {
+          THROW(vm_error(token, "invalid function call",
+                         "function body cannot be compiled to bytecode"));
+        }
+        proto->chunk = function;
+      }
+      if (arg_count < function->param_count) {
+        THROW(vm_error(token, "invalid function call",
+                       "not enough arguments for the function parameters"));
+      }
+
+      size_t base = sp - vm->stack - arg_count;
+      struct environment *call_env = callee->function_value.env;
+      if (function->uses_env) {
+        call_env = env_init();
+        if (!call_env) {
+          THROW(gc_alloc(OBJECT_SENTINEL));
+        }
+        call_env->parent = callee->function_value.env;
+        struct obj_t **args = sp - arg_count;
+        for (size_t i = 0; i < function->param_count; i++) {
+          env_define(call_env, function->parameters[i]->id, args[i]);
+        }
+        sp -= arg_count;
+      } else {
+        // arguments already sit in the parameter slots, drop the extra ones
+        sp -= arg_count - function->param_count;
+      }
+
+      SAVE_FRAME();
+      size_t top = sp - vm->stack;
+      if (!vm_push_frame(vm, function, base, call_env)) {
+        THROW(gc_alloc(OBJECT_SENTINEL));
+      }
+      sp = vm->stack + top;
+      LOAD_FRAME();
+      for (size_t i = function->param_count; i < function->slot_count; i++) {
+        PUSH(NULL);
+      }
+      SAFE_POINT();
+    }; break;
+    case OP_RETURN: {
+      struct obj_t *value = POP();
+      if (vm->frame_count == 1) {
+        result = value;
+        goto done;
+      }
+      sp = vm->stack + frame->base - 1;
+      vm->frame_count--;
+      LOAD_FRAME();
+      PUSH(value);
+    }; break;
+    }
+  }
+
+done:
+  vm->frame_count = 0;
+  return result ? result : gc_alloc(OBJECT_SENTINEL);
+}
@@ -0,0 +1,1012 @@
+#include "evaluator_test.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "jit.h"
+#include "lexer.h"
+#include "object_t.h"
+#include "parser.h"
+#include "slab.h"
+#include "test_util.h"
+#include "transpiler.h"
+#include "util_repr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct eval_case {
+  const char *input;
+  const char *expected; // repr of the result, "<error>" for error objects
+};
+
+/**
+ * every case is evaluated by each of these engines
+ */
+static const enum EVAL_ENGINE engines[] = {
+    ENGINE_TREE_WALKER,
+    ENGINE_BYTECODE_VM,
+    ENGINE_REGISTER_VM,
+    ENGINE_CLOSURE,
+    ENGINE_STACK,
+};
+
+void evaluator_run_all_tests() {
+  RUN_TEST(test_eval_arithmetic);
+  RUN_TEST(test_eval_comparisons);
+  RUN_TEST(test_eval_prefix_and_postfix);
+  RUN_TEST(test_eval_let_statements);
+  RUN_TEST(test_eval_conditionals);
+  RUN_TEST(test_eval_functions);
+  RUN_TEST(test_eval_closures);
+  RUN_TEST(test_eval_recursion);
+  RUN_TEST(test_eval_hot_functions);
+  RUN_TEST(test_eval_deep_hot_functions);
+  RUN_TEST(test_eval_quickening);
+  RUN_TEST(test_eval_fused_nodes);
+  RUN_TEST(test_eval_tail_calls);
+  RUN_TEST(test_eval_deep_recursion);
+  RUN_TEST(test_eval_loops);
+  RUN_TEST(test_eval_resolved_names);
+  RUN_TEST(test_eval_call_frames);
+  RUN_TEST(test_eval_escaping_closures);
+  RUN_TEST(test_eval_function_prototypes);
+  RUN_TEST(test_eval_call_site_caches);
+  RUN_TEST(test_eval_argument_passing);
+  RUN_TEST(test_eval_returns);
+  RUN_TEST(test_eval_literal_constants);
+  RUN_TEST(test_eval_immediates);
+  RUN_TEST(test_eval_infix_temporaries);
+  RUN_TEST(test_eval_collections);
+  RUN_TEST(test_eval_collections_during_evaluation);
+  RUN_TEST(test_eval_object_slab);
+  RUN_TEST(test_eval_errors);
+  RUN_TEST(test_eval_emitted_c);
+  evaluator_set_engine(ENGINE_TREE_WALKER);
+}
+
+static void assert_repr(struct obj_t *result, const char *input,
+                        const char *expected, size_t engine) {
+  ASSERT(result != NULL);
+  string_t *str = init_string_t(8);
+  if (object_t_type(result) == OBJECT_ERROR) {
+    string_t_cat(str, "<error>");
+  } else {
+    t_object_repr(result, str);
+  }
+  if (len_string_t(str) != strlen(expected) ||
+      string_t_ncmp(str, (char *)expected, strlen(expected))) {
+    fprintf(stderr, "engine #%zu: %s\nexpected: %s\ngot: ", engine, input,
+            expected);
+    repr_string_t(str);
+  }
+  ASSERT(len_string_t(str) == strlen(expected));
+  ASSERT(!string_t_ncmp(str, (char *)expected, strlen(expected)));
+  free_string_t(str);
+}
+
+/**
+ * looks at what evaluating a program left in its nodes (quickened and fused
+ * nodes, caches of call sites) before the program is freed
+ */
+typedef void (*program_check)(struct program *program);
+
+/**
+ * evaluate input on engine to expected, then run check (which can be NULL)
+ * on the evaluated program
+ */
+static void assert_checked_on(enum EVAL_ENGINE engine, const char *input,
+                              const char *expected, program_check check) {
+  evaluator_set_engine(engine);
+
+  struct lexer *l = lexer_init(input, strlen(input));
+  ASSERT(l != NULL);
+  struct parser *p = parser_init(l);
+  ASSERT(p != NULL);
+  struct program *program = parser_parse_program(p);
+  ASSERT(program != NULL);
+  ASSERT(!parser_has_errors(p));
+
+  struct environment *env = env_init();
+  ASSERT(env != NULL);
+  struct obj_t *result = evaluate_program(env, program);
+  assert_repr(result, input, expected, engine);
+  if (check) {
+    check(program);
+  }
+
+  ast_program_free(program);
+  parser_free(p);
+}
+
+static void assert_evaluates_on(enum EVAL_ENGINE engine, const char *input,
+                                const char *expected) {
+  assert_checked_on(engine, input, expected, NULL);
+}
+
+/**
+ * statement i of the body of the function bound by the let statement at
+ * index let of program
+ */
+static struct statement *body_statement(struct program *program, size_t let,
+                                        size_t i) {
+  ASSERT(let < program->statement_count);
+  struct statement *stmt = program->statements[let];
+  ASSERT(stmt->type == STMT_LET);
+  ASSERT(stmt->let_stmt.value->type == EXPR_FUNCTION);
+  struct block_statement *body = stmt->let_stmt.value->function.body;
+  ASSERT(i < body->statement_count);
+  return body->statements[i];
+}
+
+static struct expression *body_expression(struct program *program, size_t let,
+                                          size_t i) {
+  struct statement *stmt = body_statement(program, let, i);
+  ASSERT(stmt->type == STMT_EXPRESSION);
+  return stmt->expr_stmt.expr;
+}
+
+/**
+ * parse input into a program without errors, the parser is kept in *parser
+ * as long as the program is (functions defined by it refer to its ast)
+ */
+static struct program *parse_input(const char *input, struct parser **parser) {
+  struct lexer *l = lexer_init(input, strlen(input));
+  ASSERT(l != NULL);
+  *parser = parser_init(l);
+  ASSERT(*parser != NULL);
+  struct program *program = parser_parse_program(*parser);
+  ASSERT(program != NULL);
+  ASSERT(!parser_has_errors(*parser));
+  return program;
+}
+
+/**
+ * objects allocated while input is evaluated to expected by the tree walker,
+ * with the jit off so that every call is made by the walker
+ */
+static size_t allocations_of(const char *input, const char *expected) {
+  bool jit = jit_is_enabled();
+  jit_set_enabled(false);
+  size_t allocated = gc_get_stats()->allocated;
+  assert_evaluates_on(ENGINE_TREE_WALKER, input, expected);
+  allocated = gc_get_stats()->allocated - allocated;
+  jit_set_enabled(jit);
+  return allocated;
+}
+
+/**
+ * format is a program with a %d loop bound, evaluated once with small and
+ * once with large iterations. every iteration past small allocates exactly
+ * per_iteration more objects (0 for a loop that allocates nothing)
+ */
+static void assert_allocations_per_iteration(const char *format,
+                                             const char *expected, int small,
+                                             int large, size_t per_iteration) {
+  char input[512];
+  snprintf(input, sizeof(input), format, small);
+  size_t few = allocations_of(input, expected);
+  snprintf(input, sizeof(input), format, large);
+  size_t many = allocations_of(input, expected);
+  if (many != few + (size_t)(large - small) * per_iteration) {
+    fprintf(stderr, "%s\n%d iterations: %zu, %d iterations: %zu objects\n",
+            format, small, few, large, many);
+  }
+  ASSERT(many == few + (size_t)(large - small) * per_iteration);
+}
+
+static void assert_evaluates_to(const char *input, const char *expected) {
+  for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+    assert_evaluates_on(engines[i], input, expected);
+  }
+}
+
+/**
+ * evaluate inputs one after the other in the same environment with a gc
+ * cycle after each, like the repl does. the last input evaluates to expected
+ */
+static void assert_session_evaluates_to(const char *const *inputs,
+                                        size_t count, const char *expected) {
+  for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+    evaluator_set_engine(engines[i]);
+
+    struct environment *env = env_init();
+    ASSERT(env != NULL);
+    // functions defined by an input keep its ast, it is freed at the end
+    struct program *programs[count];
+    struct parser *parsers[count];
+    struct obj_t *result = NULL;
+    for (size_t j = 0; j < count; j++) {
+      programs[j] = parse_input(inputs[j], &parsers[j]);
+      result = evaluate_program(env, programs[j]);
+      ASSERT(result != NULL);
+      if (j + 1 < count) {
+        gc_collect(env);
+      }
+    }
+    assert_repr(result, inputs[count - 1], expected, i);
+    gc_collect(env);
+
+    for (size_t j = 0; j < count; j++) {
+      ast_program_free(programs[j]);
+      parser_free(parsers[j]);
+    }
+  }
+}
+
+#define ASSERT_SESSION(inputs, expected)                                       \
+  assert_session_evaluates_to(inputs, sizeof(inputs) / sizeof(inputs[0]),     \
+                              expected)
+
+static void assert_cases(const struct eval_case *cases, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    printf("Running test #%zu: %s\n", i, cases[i].input);
+    assert_evaluates_to(cases[i].input, cases[i].expected);
+  }
+}
+
+#define ASSERT_CASES(cases) assert_cases(cases, sizeof(cases) / sizeof(cases[0]))
+
+void test_eval_arithmetic() {
+  const struct eval_case cases[] = {
+      {"5;", "<integer>(5)"},
+      {"1 + 2 * 3;", "<integer>(7)"},
+      {"10 - 4 - 3;", "<integer>(3)"},
+      {"(1 + 2) * 3;", "<integer>(9)"},
+      {"7 / 2;", "<integer>(3)"},
+      {"7 % 4;", "<integer>(3)"},
+      {"1 / 0;", "<sentinel value>(null)"},
+      // the quotient of INT_MIN / -1 is not an int, like x / 0
+      {"let m := -2147483647 - 1; m / -1;", "<sentinel value>(null)"},
+      {"let m := -2147483647 - 1; m % -1;", "<sentinel value>(null)"},
+      {"let m := -2147483647; (m - 1) / -1;", "<sentinel value>(null)"},
+      {"let m := -2147483647 - 1; m / 1 == m;", "<boolean>(true)"},
+      {"let f := fn(a, b) { a / b }; let s := 0; for (let i := 1; i < 200; "
+       "i++) { let s := s + f(i, 3); } f(-2147483647 - 1, -1);",
+       "<sentinel value>(null)"},
+      {"let f := fn(a, b) { a % b }; let s := 0; for (let i := 1; i < 200; "
+       "i++) { let s := s + f(i, 7); } f(-2147483647 - 1, -1);",
+       "<sentinel value>(null)"},
+      {"1.5 * 2.0;", "<float>(3.000000)"},
+      {"1.5 - 2.5;", "<float>(-1.000000)"},
+      {"\"arc\";", "<string>(arc)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_comparisons() {
+  const struct eval_case cases[] = {
+      {"1 < 2;", "<boolean>(true)"},
+      {"2 <= 1;", "<boolean>(false)"},
+      {"3 == 3;", "<boolean>(true)"},
+      {"2 != 2;", "<boolean>(false)"},
+      {"2 != 3;", "<boolean>(true)"},
+      {"1.5 > 0.5;", "<boolean>(true)"},
+      {"true == false;", "<boolean>(false)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_prefix_and_postfix() {
+  const struct eval_case cases[] = {
+      {"!true;", "<boolean>(false)"},
+      {"!!true;", "<boolean>(true)"},
+      {"!5;", "<boolean>(false)"},
+      {"-5 + 2;", "<integer>(-3)"},
+      {"-1.5;", "<float>(-1.500000)"},
+      {"let a := 1; a++;", "<integer>(1)"},
+      {"let a := 1; a++; a;", "<integer>(2)"},
+      {"let a := 1; --a; a;", "<integer>(0)"},
+      {"let x := 1.5; x++; x;", "<float>(2.500000)"},
+      {"let x := 1.5; x++;", "<float>(1.500000)"},
+      {"let x := 1.5; x--; --x; x;", "<float>(-0.500000)"},
+      {"let f := fn(x) { x--; x }; f(0.25);", "<float>(-0.750000)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_let_statements() {
+  const struct eval_case cases[] = {
+      {"let a := 5;", "<integer>(5)"},
+      {"let a := 5; let b := a * 2; b;", "<integer>(10)"},
+      {"let a := 5; let a := a + 1; a;", "<integer>(6)"},
+      // a let that did not run leaves the outer binding visible
+      {"let x := 1; let f := fn(a) { if (a > 1) { let x := 2; }; x * 10 + a; "
+       "}; f(0) + f(5);",
+       "<integer>(35)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_conditionals() {
+  const struct eval_case cases[] = {
+      {"if (1 < 2) { 10 } else { 20 };", "<integer>(10)"},
+      {"if (1 > 2) { 10 } else { 20 };", "<integer>(20)"},
+      {"if (false) { 10 };", "<sentinel value>(null)"},
+      {"let f := fn(c) { if (c) { 1 } else { 2 }; }; f(false);", "<integer>(2)"},
+      {"return 5; 10;", "<integer>(5)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_functions() {
+  const struct eval_case cases[] = {
+      {"let add := fn(a, b) { return a + b; }; add(2, 3);", "<integer>(5)"},
+      {"let f := fn(x) { x * 2 }; f(4);", "<integer>(8)"},
+      {"let r := fn(x) { x; }(7); r;", "<integer>(7)"},
+      {"let f := fn(n) { let m := n * 2; m + 1 }; f(5);", "<integer>(11)"},
+      {"let f := fn(n) { if (n > 0) { return 1; } return 0; }; f(5);",
+       "<integer>(1)"},
+      {"let sq := fn(x) { x * x }; let f := fn(a) { sq(a) + 1 }; f(3);",
+       "<integer>(10)"},
+      {"let g := 3; let f := fn(a) { a + g }; f(1);", "<integer>(4)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_closures() {
+  const struct eval_case cases[] = {
+      {"let adder := fn(x) { return fn(y) { x + y }; }; let add2 := adder(2); "
+       "add2(5);",
+       "<integer>(7)"},
+      {"let twice := fn(f, x) { f(f(x)) }; twice(fn(x) { x * 3 }, 2);",
+       "<integer>(18)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_recursion() {
+  const struct eval_case cases[] = {
+      {"let fib := fn(n) { if (n < 2) { return n; } return fib(n - 1) + "
+       "fib(n - 2); }; fib(15);",
+       "<integer>(610)"},
+      {"let sum := fn(n, acc) { if (n == 0) { return acc; } return sum(n - "
+       "1, acc + n); }; sum(100, 0);",
+       "<integer>(5050)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+/**
+ * functions called often enough to be compiled by the jit, including the
+ * cases where a guard sends the call back to the interpreter
+ */
+void test_eval_hot_functions() {
+  const struct eval_case cases[] = {
+      {"let fib := fn(n) { if (n < 2) { return n; } return fib(n - 1) + "
+       "fib(n - 2); }; fib(20);",
+       "<integer>(6765)"},
+      {"let sum := fn(x, n) { if (n < 1) { return x; }; sum(x + 0.5, n - 1); "
+       "}; sum(0.0, 200);",
+       "<float>(100.000000)"},
+      {"let acc := fn(n, t) { if (n == 0) { return t; }; let u := t + n * 2 "
+       "- n % 3; acc(n - 1, u); }; acc(200, 0) + acc(300, 1);",
+       "<integer>(130000)"},
+      // division by zero fails a guard once div is compiled
+      {"let div := fn(a, b) { a / b }; let loop := fn(i) { if (i < 1) { "
+       "return div(1, 1); }; div(7, 2); loop(i - 1) }; loop(100); div(1, 0);",
+       "<sentinel value>(null)"},
+      // sum is compiled for (double, int), an int x fails the type guard
+      {"let sum := fn(x, n) { if (n < 1) { return x; }; sum(x + 0.5, n - 1); "
+       "}; sum(0.0, 200); sum(0, 200);",
+       "<error>"},
+  };
+  ASSERT_CASES(cases);
+}
+
+/**
+ * self calls of compiled functions deeper than the c stack allows, on the
+ * engines that call into the jit. tail calls loop in the native code, other
+ * self calls go back to the interpreter once they use up JIT_MAX_STACK
+ */
+void test_eval_deep_hot_functions() {
+  const enum EVAL_ENGINE jit_engines[] = {ENGINE_TREE_WALKER, ENGINE_CLOSURE,
+                                          ENGINE_STACK};
+  const char *loop = "let loop := fn(n, acc) { if (n == 0) { acc } else { "
+                     "loop(n - 1, acc + 2) }; }; loop(1000000, 0);";
+  const char *count = "let count := fn(n) { if (n == 0) { return 0; }; "
+                      "return 1 + count(n - 1); }; count(30000) + count(20);";
+  ASSERT(jit_is_enabled());
+  for (size_t i = 0; i < sizeof(jit_engines) / sizeof(jit_engines[0]); i++) {
+    assert_evaluates_on(jit_engines[i], loop, "<integer>(2000000)");
+    assert_evaluates_on(jit_engines[i], count, "<integer>(30020)");
+  }
+}
+
+static void check_quickened(struct program *program) {
+  struct expression *mul = body_expression(program, 0, 0);
+  ASSERT(mul->type == EXPR_INFIX);
+  ASSERT(mul->infix_expr.quick != NULL);
+  ASSERT(mul->infix_expr.quick_type == OBJECT_INT);
+  ASSERT(mul->infix_expr.quick_misses == 0);
+}
+
+static void check_despecialized(struct program *program) {
+  struct expression *mul = body_expression(program, 0, 0);
+  ASSERT(mul->type == EXPR_INFIX);
+  ASSERT(mul->infix_expr.quick == NULL);
+  ASSERT(mul->infix_expr.quick_misses == 1);
+}
+
+void test_eval_quickening() {
+  const struct eval_case cases[] = {
+      // the same nodes see ints, then doubles, then a type mismatch
+      {"let f := fn(a, b) { a * b + a }; f(1, 2); f(3, 4); f(5, 6); "
+       "f(0.5, 0.25) + f(1.5, 0.5) + f(2.5, 0.5);",
+       "<float>(6.625000)"},
+      {"let f := fn(a, b) { a + b }; f(1, 2); f(3, 4); f(5, 6); f(1, 0.5);",
+       "<error>"},
+      {"let f := fn(a, b) { a / b }; f(6, 3); f(8, 2); f(9, 3); f(1, 0);",
+       "<sentinel value>(null)"},
+      {"let f := fn(a, b) { a == b }; f(true, true); f(false, true); "
+       "f('a', 'a'); f('a', 'b'); f(1, 1);",
+       "<boolean>(true)"},
+  };
+  ASSERT_CASES(cases);
+
+  // the tree walker leaves the handler on the node, a miss takes it off
+  assert_checked_on(ENGINE_TREE_WALKER,
+                    "let f := fn(a, b) { a * b }; f(1, 2); f(3, 4); f(5, 6);",
+                    "<integer>(30)", check_quickened);
+  assert_checked_on(ENGINE_TREE_WALKER,
+                    "let f := fn(a, b) { a * b }; f(1, 2); f(3, 4); f(5, 6); "
+                    "f(0.5, 2.0);",
+                    "<float>(1.000000)", check_despecialized);
+}
+
+static void check_fused_infixes(struct program *program) {
+  struct expression *sum = program->statements[1]->let_stmt.value;
+  ASSERT(sum->fused == FUSED_NAME_NAME);
+  // b - 1 < a: only the operand of the comparison has a fusable shape
+  struct expression *less = program->statements[2]->expr_stmt.expr;
+  ASSERT(less->fused == FUSED_NONE);
+  ASSERT(less->infix_expr.left->fused == FUSED_NAME_LITERAL);
+}
+
+static void check_fused_call(struct program *program) {
+  ASSERT(body_statement(program, 0, 0)->fused == FUSED_RETURN_NAME);
+  ASSERT(program->statements[2]->expr_stmt.expr->fused == FUSED_CALL_NAMES);
+}
+
+void test_eval_fused_nodes() {
+  const struct eval_case cases[] = {
+      {"let a := 'x'; let b := 2.5; let f := fn(c, d) { return c; }; "
+       "if (a == 'x') { f(b, a) * 2.0 } else { 0.0 };",
+       "<float>(5.000000)"},
+      {"let a := 1; let b := a + a; b - 1 < a;", "<boolean>(false)"},
+      {"let a := 1; a + b;", "<error>"},
+      {"let f := fn(a, b) { a }; let x := 1; f(x);", "<error>"},
+  };
+  ASSERT_CASES(cases);
+
+  assert_checked_on(ENGINE_TREE_WALKER,
+                    "let a := 1; let b := a + a; b - 1 < a;",
+                    "<boolean>(false)", check_fused_infixes);
+  assert_checked_on(ENGINE_TREE_WALKER,
+                    "let f := fn(c, d) { return c; }; let x := 1; f(x, x);",
+                    "<integer>(1)", check_fused_call);
+}
+
+void test_eval_tail_calls() {
+  const struct eval_case cases[] = {
+      {"let count := fn(n, acc) { if (n == 0) { return acc; }; return "
+       "count(n - 1, acc + 1); }; count(3000, 0);",
+       "<integer>(3000)"},
+      {"let even := fn(n) { if (n == 0) { return true; }; return odd(n - 1); "
+       "}; let odd := fn(n) { if (n == 0) { return false; }; return "
+       "even(n - 1); }; even(2001);",
+       "<boolean>(false)"},
+      // the arguments of a tail call make tail calls of their own
+      {"let id := fn(x) { return x; }; let f := fn(n) { if (n == 0) { return "
+       "0; }; return f(id(n - 1)); }; f(100) + id(7);",
+       "<integer>(7)"},
+      // g captures the scope of the first call, it must not be reused
+      {"let mk := fn(n, f) { if (n == 0) { return f; }; let g := fn() { n }; "
+       "if (n == 3) { return mk(n - 1, g); }; return mk(n - 1, f); }; "
+       "let h := mk(3, 0); h();",
+       "<integer>(3)"},
+      {"let f := fn(n) { return g(n); }; let g := fn(a, b) { a }; f(1);",
+       "<error>"},
+  };
+  ASSERT_CASES(cases);
+
+  // deeper than the c stack allows, with the jit on: count is compiled and
+  // loops in native code, even and odd are never compiled
+  ASSERT(jit_is_enabled());
+  assert_evaluates_on(ENGINE_TREE_WALKER,
+                      "let count := fn(n, acc) { if (n == 0) { return acc; "
+                      "}; return count(n - 1, acc + 1); }; count(1000000, 0);",
+                      "<integer>(1000000)");
+  assert_evaluates_on(ENGINE_TREE_WALKER,
+                      "let even := fn(n) { if (n == 0) { return true; }; "
+                      "return odd(n - 1); }; let odd := fn(n) { if (n == 0) { "
+                      "return false; }; return even(n - 1); }; even(1000001);",
+                      "<boolean>(false)");
+}
+
+/**
+ * the stack engine keeps its calls on the heap, recursion is not limited by
+ * the c stack even when the jit compiles the recursive function
+ */
+void test_eval_deep_recursion() {
+  ASSERT(jit_is_enabled());
+  assert_evaluates_on(ENGINE_STACK,
+                      "let count := fn(n) { if (n == 0) { return 0; }; return "
+                      "1 + count(n - 1); }; count(1000000);",
+                      "<integer>(1000000)");
+}
+
+void test_eval_loops() {
+  const struct eval_case cases[] = {
+      {"let s := 0; let i := 0; while (i < 5) { let s := s + i; i++; } s;",
+       "<integer>(10)"},
+      {"let s := 0; for (let i := 1; i <= 4; i++) { let s := s * 10 + i; }; "
+       "s;",
+       "<integer>(1234)"},
+      {"while (false) { 1 }", "<sentinel value>(null)"},
+      {"let i := 10; for (i--; i > 5; i--) {} i;", "<integer>(5)"},
+      {"let c := 0; for (let i := 0; i < 3; i++) { for (let j := 0; j < i; "
+       "j++) { let c := c + 1; } } c;",
+       "<integer>(3)"},
+      {"let f := fn(n) { for (let i := 0; true; i++) { if (i * i >= n) { "
+       "return i; }; } }; f(50);",
+       "<integer>(8)"},
+      // the let in the body is bound from the second iteration on
+      {"let f := fn(n) { let out := 0; let i := 0; while (i < n) { if (i > 0) "
+       "{ let out := out + last; }; let last := i * 10; i++; } out }; f(4);",
+       "<integer>(30)"},
+      {"let f := fn(n) { let g := fn(x) { x + n }; let s := 0; for (let i := "
+       "0; i < n; i++) { let s := g(s); } s }; f(3);",
+       "<integer>(9)"},
+      // a for loop without a condition only ends with a return
+      {"let f := fn(n) { let i := 0; for (;;) { i++; if (i >= n) { return i; "
+       "}; } }; f(7);",
+       "<integer>(7)"},
+      {"let f := fn(n) { let s := 0; for (let i := 0;; i++) { if (i == n) { "
+       "return s; }; let s := s + i; } }; f(5);",
+       "<integer>(10)"},
+      {"let n := 4; let s := 0; for (; n > 0;) { let s := s + n; n--; } s;",
+       "<integer>(10)"},
+      {"while (x) { 1 }", "<error>"},
+      {"let i := 0; while (i < 3) { i++; y; }", "<error>"},
+  };
+  ASSERT_CASES(cases);
+
+  // ints and doubles are immediates, an iteration allocates nothing
+  assert_allocations_per_iteration(
+      "let c := 0; for (let i := 0; i < %d; i++) { let c := i % 7; } c < 7;",
+      "<boolean>(true)", 10, 1000, 0);
+  assert_allocations_per_iteration(
+      "let n := %d; let c := 0; while (n > 0) { n--; let c := c + 1; if (c > "
+      "5) { let c := 0; }; } c < 6;",
+      "<boolean>(true)", 10, 1000, 0);
+  assert_allocations_per_iteration(
+      "let f := fn(n) { let x := 0.0; for (let i := 0; i < n; i++) { let x := "
+      "x + 0.5; } x }; f(%d) > 1.0;",
+      "<boolean>(true)", 10, 1000, 0);
+}
+
+void test_eval_resolved_names() {
+  const struct eval_case cases[] = {
+      {"let f := fn(a) { let g := fn(b) { let h := fn(c) { a * 100 + b * 10 "
+       "+ c }; h }; g }; let g := f(1); let h := g(2); h(3);",
+       "<integer>(123)"},
+      // slots of lets that did not run yet fall back to the outer name
+      {"let x := 1; let f := fn(c) { if (c) { let x := 2; }; x }; f(false);",
+       "<integer>(1)"},
+      {"let x := 1; let f := fn(c) { if (c) { let x := 2; }; x }; f(true);",
+       "<integer>(2)"},
+      {"let x := 1; let f := fn() { let y := x; let x := 5; y + x }; f();",
+       "<integer>(6)"},
+      {"let n := 7; let f := fn(n) { let g := fn() { n }; g() }; f(3) + n;",
+       "<integer>(10)"},
+      {"let fib := fn(n) { if (n < 2) { return n; }; fib(n - 1) + fib(n - 2) "
+       "}; fib(15);",
+       "<integer>(610)"},
+      {"let f := fn(n) { if (n == 0) { return 0; }; let m := n - 1; g(m) }; "
+       "let g := fn(k) { let j := k; f(j) }; f(5);",
+       "<integer>(0)"},
+      {"let f := fn() { let a := 1; a++; a }; f() + f();", "<integer>(4)"},
+      {"let f := fn() { z }; f();", "<error>"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_call_frames() {
+  const struct eval_case cases[] = {
+      // deep enough to spill over into a second chunk of frames
+      {"let sum := fn(n) { if (n == 0) { return 0; }; let m := n - 1; n + "
+       "sum(m) }; sum(3000) + sum(3000);",
+       "<integer>(9003000)"},
+      {"let even := fn(n) { if (n == 0) { return true; }; odd(n - 1) }; let "
+       "odd := fn(n) { if (n == 0) { return false; }; even(n - 1) }; "
+       "even(1001);",
+       "<boolean>(false)"},
+      {"let f := fn(n) { let a := n * 2; let g := fn() { a }; g }; let h := "
+       "fn(n) { let k := f(n); k() + n }; h(4);",
+       "<integer>(12)"},
+      {"let f := fn(n) { if (n > 2) { return missing; }; f(n + 1) }; f(0);",
+       "<error>"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_escaping_closures() {
+  const struct eval_case cases[] = {
+      // g refers to nothing of mk, the call of mk runs on a frame
+      {"let mk := fn(n) { let unused := n * 3; let g := fn(x) { x + 1 }; g }; "
+       "let q := mk(5); let r := mk(6); q(1) + r(2);",
+       "<integer>(5)"},
+      // only the scope of add is captured, mid is skipped by inner
+      {"let add := fn(a) { let mid := fn(b) { let inner := fn(c) { a + c }; "
+       "inner }; mid }; let m := add(10); let i := m(99); i(5);",
+       "<integer>(15)"},
+      {"let add := fn(a) { let mid := fn(b) { let inner := fn(c) { a + b + c "
+       "}; inner }; mid }; let m := add(10); let i := m(100); i(5);",
+       "<integer>(115)"},
+      {"let e := fn() { let x := 1; let f := fn(c) { if (c) { let x := 2; }; "
+       "x }; f(false) }; e();",
+       "<integer>(1)"},
+      {"let c := fn() { let n := 0; let inc := fn() { n++; n }; inc(); inc() "
+       "}; c();",
+       "<integer>(2)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_function_prototypes() {
+  const struct eval_case cases[] = {
+      // closures of one literal share its prototype, not their environment
+      {"let mk := fn(n) { let g := fn(a) { a + n }; g }; let s := 0; for (let "
+       "i := 0; i < 5; i++) { let h := mk(i); let s := s + h(10); } s;",
+       "<integer>(60)"},
+      {"let mk := fn() { let g := fn(a) { a }; g }; let x := mk(); let y := "
+       "mk(); let x := 1; let y := 2; x + y;",
+       "<integer>(3)"},
+      {"let twice := fn(f, x) { f(f(x)) }; let add := fn(n) { let g := fn(x) "
+       "{ x + n }; g }; twice(add(3), 1) + twice(add(5), 1);",
+       "<integer>(18)"},
+      {"let mk := fn(n) { let g := fn(a, b) { a + b + n }; g }; let h := "
+       "mk(1); h(1);",
+       "<error>"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_call_site_caches() {
+  const struct eval_case cases[] = {
+      // the call site in the loop sees the rebinding of f
+      {"let f := fn(x) { x + 1 }; let s := 0; for (let i := 0; i < 4; i++) { "
+       "let s := s + f(i); if (i == 1) { let f := fn(x) { x * 10 }; }; } s;",
+       "<integer>(53)"},
+      {"let g := fn() { 1 }; let call := fn() { g() }; let a := call(); let g "
+       ":= fn() { 2 }; a * 10 + call();",
+       "<integer>(12)"},
+      {"let call := fn() { h() }; let h := fn() { 3 }; let a := call(); let "
+       "k := 0; let b := call(); a + b + k;",
+       "<integer>(6)"},
+      {"let call := fn() { h() }; let h := fn() { 3 }; call(); let h := 4; "
+       "call();",
+       "<error>"},
+  };
+  ASSERT_CASES(cases);
+
+  // the call site of g in call, checked between the inputs of a session
+  evaluator_set_engine(ENGINE_TREE_WALKER);
+  struct environment *env = env_init();
+  ASSERT(env != NULL);
+  struct parser *parsers[4];
+  struct program *defs = parse_input(
+      "let g := fn() { 1 }; let call := fn() { g() }; call();", &parsers[0]);
+  ASSERT(evaluate_program(env, defs) != NULL);
+  struct expression *site = body_expression(defs, 1, 0);
+  ASSERT(site->type == EXPR_FUNCTION_CALL);
+  struct entry *entry = site->function_call.cached_entry;
+  ASSERT(entry != NULL);
+  ASSERT(site->function_call.cached_shape == env_shape);
+  ASSERT(entry->value == env_look_up(env, "g"));
+
+  // rebinding g updates the cached entry in place, the cache still hits
+  struct program *rebind = parse_input("let g := fn() { 2 };", &parsers[1]);
+  ASSERT(evaluate_program(env, rebind) != NULL);
+  ASSERT(site->function_call.cached_shape == env_shape);
+  ASSERT(site->function_call.cached_entry == entry);
+  ASSERT(entry->value == env_look_up(env, "g"));
+
+  // a new global changes the shape, the next call misses and caches again
+  struct program *define = parse_input("let k := 0;", &parsers[2]);
+  ASSERT(evaluate_program(env, define) != NULL);
+  ASSERT(site->function_call.cached_shape != env_shape);
+  struct program *again = parse_input("call();", &parsers[3]);
+  assert_repr(evaluate_program(env, again), "call();", "<integer>(2)",
+              ENGINE_TREE_WALKER);
+  ASSERT(site->function_call.cached_shape == env_shape);
+  ASSERT(site->function_call.cached_entry == entry);
+
+  struct program *programs[] = {defs, rebind, define, again};
+  for (size_t i = 0; i < 4; i++) {
+    ast_program_free(programs[i]);
+    parser_free(parsers[i]);
+  }
+}
+
+void test_eval_argument_passing() {
+  const struct eval_case cases[] = {
+      {"let f := fn() { 7 }; f();", "<integer>(7)"},
+      {"let f := fn(a, b, c, d) { a * 1000 + b * 100 + c * 10 + d }; f(1, 2, "
+       "3, 4);",
+       "<integer>(1234)"},
+      // wider calls take their arguments from the argument stack, nested
+      // calls among them take theirs above
+      {"let f := fn(a, b, c, d, e) { a - b - c - d - e }; f(100, f(50, 1, 1, "
+       "1, 1), 2, 3, 4);",
+       "<integer>(45)"},
+      {"let f := fn(a, b, c, d, e, g, h, i, j, k) { a + k }; f(1, 2, 3, 4, 5, "
+       "6, 7, 8, 9, 10);",
+       "<integer>(11)"},
+      {"let f := fn(n, a, b, c, d) { if (n == 0) { return a + b + c + d; }; "
+       "let r := f(n - 1, a, b, c, d); r + 1 }; f(1200, 1, 2, 3, 4);",
+       "<integer>(1210)"},
+      {"let f := fn(a, b, c, d, e) { a }; f(1, 2, 3, 4);", "<error>"},
+      {"let f := fn(a, b, c, d, e) { a }; f(1, 2, 3, 4, x);", "<error>"},
+  };
+  ASSERT_CASES(cases);
+
+  // neither the inline arguments nor the argument stack allocate, 10 and
+  // 1000 iterations make the same allocations
+  assert_allocations_per_iteration(
+      "let f := fn(a, b) { a }; let g := fn(a, b, c, d, e) { e }; for (let i "
+      ":= 0; i < %d; i++) { f(i, i); g(i, 1, 2, 3, i); } g(1, 2, 3, 4, 5);",
+      "<integer>(5)", 10, 1000, 0);
+}
+
+void test_eval_returns() {
+  const struct eval_case cases[] = {
+      {"let f := fn(x) { if (x > 0) { return x * 2; }; 0 }; f(3) + f(-1) + "
+       "f(4);",
+       "<integer>(14)"},
+      // nested returns take their values out one at a time
+      {"let g := fn(x) { return x + 1; }; let f := fn(x) { let a := g(x); "
+       "return g(a) * 10; }; f(1);",
+       "<integer>(30)"},
+      {"let f := fn() { let x := if (true) { return 5; }; 7 }; f();",
+       "<integer>(5)"},
+      {"let f := fn() { for (let i := 0; true; i++) { if (i == 3) { return "
+       "i; }; } }; f() + f();",
+       "<integer>(6)"},
+  };
+  ASSERT_CASES(cases);
+
+  // a return carries its value in the marker, no box is allocated for it
+  assert_allocations_per_iteration(
+      "let f := fn(x) { if (x > 0) { return x; }; return 0; }; for (let i := "
+      "0; i < %d; i++) { f(i); f(-1); } f(3);",
+      "<integer>(3)", 10, 1000, 0);
+}
+
+void test_eval_literal_constants() {
+  const struct eval_case cases[] = {
+      // ++ rebinds names bound to the value of a literal, the literal keeps
+      // its value for the next evaluation
+      {"let f := fn() { let a := 1; a++; a }; f() + f();", "<integer>(4)"},
+      {"let s := 0; for (let i := 0; i < 3; i++) { let x := 10; x--; --x; "
+       "let s := s + x; } s;",
+       "<integer>(24)"},
+      {"let a := 5; let b := a; a++; b;", "<integer>(5)"},
+      {"let f := fn() { let d := 1.5; ++d; d }; f(); f();",
+       "<float>(2.500000)"},
+      {"let f := fn() { \"abc\" }; let a := f(); let b := f(); a;",
+       "<string>(abc)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_immediates() {
+  const struct eval_case cases[] = {
+      {"let a := 1022; a++; a++; a;", "<integer>(1024)"},
+      {"let a := -127; a--; --a; a;", "<integer>(-129)"},
+      {"let f := fn(n) { n * 2 }; f(10) + f(600);", "<integer>(1220)"},
+      {"-(3 - 5) * 512;", "<integer>(1024)"},
+      {"2147483647;", "<integer>(2147483647)"},
+      {"-2147483647 - 1;", "<integer>(-2147483648)"},
+      // an immediate is never updated in place
+      {"let a := 3 + 4; let b := a; a++; b;", "<integer>(7)"},
+      {"let a := 3 + 4; let b := 7; ++a; b + a;", "<integer>(15)"},
+      {"let d := 0.5; let e := d; d++; e + d;", "<float>(2.000000)"},
+      {"let t := 1 < 2; t == true;", "<boolean>(true)"},
+      {"'a' == 'a';", "<boolean>(true)"},
+      // doubles without an immediate form are objects
+      {"-0.0;", "<float>(-0.000000)"},
+      {"let big := 10000000000000000000000000000000000000000.0; big * big > "
+       "big;",
+       "<boolean>(true)"},
+      {"let big := 10000000000000000000000000000000000000000.0; 1.0 / big / "
+       "big * big * big;",
+       "<float>(1.000000)"},
+      {"let big := 10000000000000000000000000000000000000000.0; let d := 0.0 "
+       "- big * big; d++; d < 0.0;",
+       "<boolean>(true)"},
+  };
+  ASSERT_CASES(cases);
+}
+
+void test_eval_infix_temporaries() {
+  const struct eval_case cases[] = {
+      {"let a := 1000; let b := 3; a * b + a * b - b;", "<integer>(5997)"},
+      {"(1000 * 2) + (3000 * 2);", "<integer>(8000)"},
+      {"2000 - (1000 * 2 - 5) * 3;", "<integer>(-3985)"},
+      {"(1500 * 2) % 7 + 1;", "<integer>(5)"},
+      {"(1.5 * 2.0) + (0.5 * 3.0) / 2.0;", "<float>(3.750000)"},
+      {"let x := 600 * 2; let y := x * 2 + 1; x + y;", "<integer>(3601)"},
+      {"let f := fn(n) { n * n + n * n }; f(100) + f(100);",
+       "<integer>(40000)"},
+  };
+  ASSERT_CASES(cases);
+
+  // a * b is too large for an immediate and needs an object of its own, the
+  // two sums above it reuse it
+  assert_allocations_per_iteration(
+      "let f := fn(a, b) { a * b + a + b }; let big := "
+      "10000000000000000000000000000000000000000.0; for (let i := 0; i < %d; "
+      "i++) { f(big, big); } f(big, big) > big;",
+      "<boolean>(true)", 10, 20, 1);
+}
+
+void test_eval_collections() {
+  // values bound by earlier inputs survive the minor collections after them
+  const char *const promoted[] = {
+      "let s := \"arc\";",
+      "let n := 5000; let big := n * 3;",
+      "let mk := fn(x) { let g := fn() { x }; g };",
+      "let h := mk(big + 1);",
+      "s;",
+  };
+  ASSERT_SESSION(promoted, "<string>(arc)");
+
+  // enough closures to fill the nursery and start a major collection
+  const char *const major[] = {
+      "let mk := fn(x) { let g := fn() { x }; g }; let n := 0;",
+      "for (let i := 0; i < 3000; i++) { let g := mk(i * 1000); "
+      "let n := n + 1; };",
+      "let h := mk(n * 7); let d := 2.5;",
+      "for (let i := 0; i < 3000; i++) { let g := mk(i * 1000); };",
+      "h() + g() / 1000 + n;",
+  };
+  ASSERT_SESSION(major, "<integer>(26999)");
+
+  // the closures bound while the second input is marked incrementally
+  const char *const incremental[] = {
+      "let mk := fn(x) { let g := fn() { x }; g }; let n := 0;",
+      "for (let i := 0; i < 3000; i++) { let g := mk(i * 1000); "
+      "let n := n + 1; };",
+      "let k := 0; for (let i := 0; i < 3000; i++) { let h := mk(i * 7); "
+      "let k := k + h(); };",
+      "g() / 1000 + h() + k + n;",
+  };
+  size_t majors = gc_get_stats()->major_collections;
+  size_t increments = gc_get_stats()->increments;
+  gc_set_step_budget(1);
+  ASSERT_SESSION(incremental, "<integer>(31516492)");
+  ASSERT(gc_get_stats()->increments > increments);
+  gc_set_step_budget(0); // in a single pause
+  ASSERT_SESSION(incremental, "<integer>(31516492)");
+  gc_set_step_budget(GC_STEP_BUDGET);
+  ASSERT(gc_get_stats()->major_collections > majors);
+}
+
+void test_eval_collections_during_evaluation() {
+  // each call of work fills most of the nursery, operands and arguments
+  // evaluated before it are held by the engines while it collects
+  const struct eval_case cases[] = {
+      {"let work := fn(n) { let s := 0; for (let i := 0; i < n; i++) { "
+       "let s := s + i + 2000; }; s }; let pair := fn(a, b) { a - b }; "
+       "work(3000) - work(2000) + pair(work(2500) * 2, work(3000));",
+       "<integer>(10248500)"},
+      {"let mk := fn(x) { let g := fn() { x }; g }; let sum := fn(n) { "
+       "let f := mk(n * 1000); let s := 0; for (let i := 0; i < n; i++) { "
+       "let s := s + mk(i + 5000)(); }; s + f() }; sum(3000) + sum(2000);",
+       "<integer>(36497500)"},
+      {"let count := fn(n) { if (n == 0) { return 0; }; let big := n * 1000; "
+       "1 + count(n - 1) + big - n * 1000 }; count(2500) + count(2500);",
+       "<integer>(5000)"},
+  };
+  size_t minors = gc_get_stats()->minor_collections;
+  ASSERT_CASES(cases);
+  ASSERT(gc_get_stats()->minor_collections > minors);
+}
+
+void test_eval_object_slab() {
+  // the slots of the objects swept after a session are reused by the next
+  // one, running it again does not take more chunks. chunks are swept
+  // lazily, the sweep left over is finished before they are counted
+  const char *const churn[] = {
+      "let mk := fn(x) { let g := fn() { x }; g }; let n := 0;",
+      "for (let i := 0; i < 3000; i++) { let g := mk(i * 1000); "
+      "let n := n + 1; };",
+      "g() / 1000 + n;",
+  };
+  ASSERT_SESSION(churn, "<integer>(5999)");
+  slab_finish_sweep(&object_slab);
+  size_t chunks = object_slab.chunk_count;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_SESSION(churn, "<integer>(5999)");
+    slab_finish_sweep(&object_slab);
+  }
+  ASSERT(object_slab.chunk_count <= chunks + chunks / 4);
+}
+
+void test_eval_errors() {
+  const struct eval_case cases[] = {
+      {"x;", "<error>"},
+      {"1 + true;", "<error>"},
+      {"let a := 5; a(1);", "<error>"},
+      {"let f := fn(x) { y }; f(1);", "<error>"},
+      {"let a := true; a++;", "<error>"},
+  };
+  ASSERT_CASES(cases);
+}
+
+/**
+ * compile input to c with the transpiler, build it against bin/libarc.a and
+ * run it, the program prints expected
+ */
+static void assert_compiled_prints(const char *input, const char *expected) {
+  printf("Running compiled: %s\n", input);
+  char arc[] = "/tmp/arc_emit_XXXXXX";
+  int fd = mkstemp(arc);
+  ASSERT(fd >= 0);
+  ASSERT(write(fd, input, strlen(input)) == (ssize_t)strlen(input));
+  close(fd);
+  char c[64];
+  char program[64];
+  snprintf(c, sizeof(c), "%s.c", arc);
+  snprintf(program, sizeof(program), "%s.out", arc);
+
+  FILE *out = fopen(c, "w");
+  ASSERT(out != NULL);
+  ASSERT(transpile_file(arc, out));
+  fclose(out);
+  char command[256];
+  snprintf(command, sizeof(command),
+           TEST_CC " -O2 -Iinclude %s bin/libarc.a -o %s", c, program);
+  ASSERT(system(command) == 0);
+
+  FILE *run = popen(program, "r");
+  ASSERT(run != NULL);
+  char printed[256] = {0};
+  size_t length = fread(printed, 1, sizeof(printed) - 1, run);
+  int status = pclose(run);
+  if (strncmp(printed, expected, strlen(expected)) != 0) {
+    fprintf(stderr, "expected %s, the program printed %.*s\n", expected,
+            (int)length, printed);
+  }
+  ASSERT(status == 0);
+  ASSERT(strncmp(printed, expected, strlen(expected)) == 0);
+  remove(arc);
+  remove(c);
+  remove(program);
+}
+
+void test_eval_emitted_c() {
+  // a tail call of the function itself loops instead of nesting c calls,
+  // also when closures keep the environments of its calls
+  assert_compiled_prints("let loop := fn(n) { if (n == 0) { return 0; }; "
+                         "return loop(n - 1); }; loop(200000);",
+                         "<integer>(0)");
+  assert_compiled_prints("let f := fn(n, s) { if (n == 0) { return s; }; "
+                         "let k := fn() { s }; return f(n - 1, k() + 1); }; "
+                         "f(200000, 0);",
+                         "<integer>(200000)");
+  assert_compiled_prints("let fib := fn(n) { if (n < 2) { return n; }; "
+                         "return fib(n - 1) + fib(n - 2); }; fib(20);",
+                         "<integer>(6765)");
+  // slots of the function and of the enclosing ones, a let that did not
+  // run yet falls back to the global
+  assert_compiled_prints(
+      "let x := 100; let mk := fn(a) { let count := 0; let inc := fn(d) { "
+      "count++; let r := x; let x := d; return count + a + r + x; }; inc }; "
+      "let f := mk(10); f(1); f(2);",
+      "<integer>(114)");
+  assert_compiled_prints("let f := fn(x) { let y := x * 2.5; y++; "
+                         "return y / 2.0; }; f(3.0);",
+                         "<float>(4.250000)");
+}
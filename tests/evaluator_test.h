@@ -0,0 +1,39 @@
+#ifndef EVALUATOR_TEST_H
+#define EVALUATOR_TEST_H
+
+#include "evaluator.h"
+
+void evaluator_run_all_tests();
+
+void test_eval_arithmetic();
+void test_eval_comparisons();
+void test_eval_prefix_and_postfix();
+void test_eval_let_statements();
+void test_eval_conditionals();
+void test_eval_functions();
+void test_eval_closures();
+void test_eval_recursion();
+void test_eval_hot_functions();
+void test_eval_deep_hot_functions();
+void test_eval_quickening();
+void test_eval_fused_nodes();
+void test_eval_tail_calls();
+void test_eval_deep_recursion();
+void test_eval_loops();
+void test_eval_resolved_names();
+void test_eval_call_frames();
+void test_eval_escaping_closures();
+void test_eval_function_prototypes();
+void test_eval_call_site_caches();
+void test_eval_argument_passing();
+void test_eval_returns();
+void test_eval_literal_constants();
+void test_eval_immediates();
+void test_eval_infix_temporaries();
+void test_eval_collections();
+void test_eval_collections_during_evaluation();
+void test_eval_object_slab();
+void test_eval_errors();
+void test_eval_emitted_c();
+
+#endif // !EVALUATOR_TEST_H
@@ -22,6 +22,7 @@ void parser_run_all_tests() {
   function_statement_test();
   function_call_expression_test();
   function_test_boolean_expressions();
+  loop_expression_test();
 }
 
 #define LET_STATEMENT_TESTS 10
@@ -538,3 +539,62 @@ void function_test_boolean_expressions() {
     free_string_t(str);
   }
 }
+
+#define LOOP_EXPRESSION_TESTS 7
+void loop_expression_test() {
+  const struct test_comp tests[] = {
+      {"while (i < 3) { i++; }", "while((i<3)){(i++)}", 1},
+      {"for (let i := 0; i < 3; i++) { i; }", "for(let i := 0;(i<3);(i++)){i}",
+       1},
+      {"for (i--; i > 0; i--) {}", "for((i--);(i>0);(i--)){}", 1},
+      // every clause of a for loop can be left out
+      {"for (;;) { f(); }", "for(;;){(f())}", 1},
+      {"for (let i := 0;; i++) {}", "for(let i := 0;;(i++)){}", 1},
+      {"for (; i < 3;) {}", "for(;(i<3);){}", 1},
+      {"for (;; i++) { i; }", "for(;;(i++)){i}", 1},
+  };
+
+  for (int i = 0; i < LOOP_EXPRESSION_TESTS; i++) {
+    printf("Running test #%d: %s\n", i, tests[i].input);
+
+    struct lexer *l = lexer_init(tests[i].input, strlen(tests[i].input));
+    if (!l) {
+      printf("Error initializing lexer\n");
+      continue;
+    }
+
+    struct parser *p = parser_init(l);
+    if (!p) {
+      printf("Error initializing parser\n");
+      lexer_free(l);
+      continue;
+    }
+
+    struct program *program = parser_parse_program(p);
+    if (!program) {
+      printf("Error parsing program\n");
+      parser_free(p);
+      continue;
+    }
+
+    if (parser_has_errors(p)) {
+      parser_print_errors(p);
+    }
+
+    string_t *str = init_string_t(8);
+    t_stmt_repr(program->statements[0], str);
+
+    repr_string_t(str);
+
+    assert(!parser_has_errors(p));
+
+    assert(program->statement_count == tests[i].statement_count);
+
+    assert(len_string_t(str) == strlen(tests[i].expected));
+    assert(!string_t_cmp(str, (char *)tests[i].expected));
+
+    ast_program_free(program);
+    parser_free(p);
+    free_string_t(str);
+  }
+}
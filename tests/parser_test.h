@@ -15,5 +15,6 @@ void function_expression_test();
 void function_statement_test();
 void function_call_expression_test();
 void function_test_boolean_expressions();
+void loop_expression_test();
 
 #endif // !PARSER_TEST_H
@@ -1,3 +1,4 @@
+#include "evaluator_test.h"
 #include "lexer_test.h"
 #include "parser_test.h"
 #include <stdio.h>
@@ -11,5 +12,9 @@ int main() {
   printf("Running parser tests...\n");
   parser_run_all_tests();
   printf("Done.\n");
+
+  printf("Running evaluator tests...\n");
+  evaluator_run_all_tests();
+  printf("Done.\n");
   return EXIT_SUCCESS;
 }